@@ -0,0 +1,101 @@
+#include "AlertBoard.hpp"
+#include "Trace.hpp"
+
+AlertBoard::AlertBoard(Context* context, UIElement* root, Font* font, unsigned poolSize)
+                :Object(context),
+                numVisible_(0),
+                nextSerial_(0),
+                numElementsCreated_(0),
+                numShown_(0),
+                numExpired_(0),
+                numEvicted_(0)
+                {
+    // Newest alerts stack up from the bottom left corner
+    if (root)
+    {
+        container_ = root->CreateChild<UIElement>("Alerts");
+        container_->SetAlignment(HA_LEFT, VA_BOTTOM);
+        container_->SetLayout(LM_VERTICAL, 4, IntRect(8, 8, 8, 8));
+        ++numElementsCreated_;
+    }
+
+    poolSize = Max(poolSize, 1u);
+    slots_.Resize(poolSize);
+    for (unsigned i = 0; i < poolSize; ++i)
+    {
+        Slot& slot = slots_[i];
+        if (container_)
+        {
+            slot.window_ = container_->CreateChild<Window>();
+            slot.window_->SetStyleAuto();
+            slot.window_->SetLayout(LM_HORIZONTAL, 0, IntRect(6, 6, 6, 6));
+            slot.window_->SetVisible(false);
+            slot.text_ = slot.window_->CreateChild<Text>();
+            slot.text_->SetFont(font, 14);
+            numElementsCreated_ += 2;
+        }
+
+        slot.timer_ = TimerWheel::INVALID_TIMER;
+        slot.shownSerial_ = 0;
+        free_.Push(poolSize - 1 - i);
+    }
+}
+
+AlertBoard::~AlertBoard() {
+    if (container_)
+        container_->Remove();
+}
+
+void AlertBoard::Show(const String& text, float lifeTime) {
+    unsigned index = AcquireSlot();
+    Slot& slot = slots_[index];
+    if (slot.window_)
+    {
+        slot.text_->SetText(text);
+        slot.window_->SetVisible(true);
+    }
+    slot.shownSerial_ = ++nextSerial_;
+    slot.timer_ = wheel_.Schedule(lifeTime, index);
+    ++numVisible_;
+    ++numShown_;
+}
+
+void AlertBoard::Update(float timeStep) {
+    TraceScope trace("AlertBoard::Update");
+    wheel_.Advance(timeStep, [this](unsigned index) {
+        slots_[index].timer_ = TimerWheel::INVALID_TIMER;
+        Hide(index);
+        ++numExpired_;
+    });
+}
+
+unsigned AlertBoard::AcquireSlot() {
+    if (!free_.Empty())
+    {
+        unsigned index = free_.Back();
+        free_.Pop();
+        return index;
+    }
+
+    // Pool is full, take over the alert that has been up the longest
+    unsigned oldest = 0;
+    for (unsigned i = 1; i < slots_.Size(); ++i)
+    {
+        if (slots_[i].shownSerial_ < slots_[oldest].shownSerial_)
+            oldest = i;
+    }
+    wheel_.Cancel(slots_[oldest].timer_);
+    slots_[oldest].timer_ = TimerWheel::INVALID_TIMER;
+    if (slots_[oldest].window_)
+        slots_[oldest].window_->SetVisible(false);
+    --numVisible_;
+    ++numEvicted_;
+    return oldest;
+}
+
+void AlertBoard::Hide(unsigned index) {
+    if (slots_[index].window_)
+        slots_[index].window_->SetVisible(false);
+    free_.Push(index);
+    --numVisible_;
+}
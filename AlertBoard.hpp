@@ -0,0 +1,78 @@
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/UI/Font.h>
+#include <Urho3D/UI/Text.h>
+#include <Urho3D/UI/UIElement.h>
+#include <Urho3D/UI/Window.h>
+
+#include "TimerWheel.hpp"
+
+using namespace Urho3D;
+
+/**
+* On-screen alerts with a lifetime. Each alert is a Window with a Text in it,
+* taken from a fixed pool that is created once, so showing an alert never
+* creates UI elements. Expiry is driven by a TimerWheel, so frames where no
+* alert is due cost nothing beyond advancing the wheel.
+*
+* When every pooled window is in use the one shown longest ago is recycled
+* for the new alert, which keeps a flood of alerts bounded on screen.
+*
+* Without a root there is nothing to draw, as on a dedicated server: the
+* board keeps the same slots and timers but creates no UI elements.
+*/
+class AlertBoard : public Object {
+
+    URHO3D_OBJECT(AlertBoard, Object);
+
+public:
+    /// root and font may be null for a board without windows.
+    AlertBoard(Context* context, UIElement* root, Font* font, unsigned poolSize = 16);
+
+    /// Takes the windows off the root again.
+    ~AlertBoard();
+
+    void Show(const String& text, float lifeTime);
+
+    void Update(float timeStep);
+
+    unsigned GetNumVisible() const { return numVisible_; }
+
+    unsigned GetPoolSize() const { return slots_.Size(); }
+
+    /// UI elements created since construction, only the pool unless something is wrong.
+    unsigned GetNumElementsCreated() const { return numElementsCreated_; }
+
+    unsigned GetNumShown() const { return numShown_; }
+
+    unsigned GetNumExpired() const { return numExpired_; }
+
+    /// Alerts that were replaced before their lifetime ran out because the pool was full.
+    unsigned GetNumEvicted() const { return numEvicted_; }
+
+private:
+    struct Slot {
+        SharedPtr<Window> window_;
+        SharedPtr<Text> text_;
+        TimerWheel::TimerHandle timer_;
+        /// Order in which slots were shown, to find the oldest.
+        unsigned long long shownSerial_;
+    };
+
+    unsigned AcquireSlot();
+
+    void Hide(unsigned index);
+
+    SharedPtr<UIElement> container_;
+    Vector<Slot> slots_;
+    PODVector<unsigned> free_;
+    TimerWheel wheel_;
+
+    unsigned numVisible_;
+    unsigned long long nextSerial_;
+    unsigned numElementsCreated_;
+    unsigned numShown_;
+    unsigned numExpired_;
+    unsigned numEvicted_;
+};
@@ -0,0 +1,137 @@
+#include "AllocationTracker.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+/// In front of every block, a multiple of 16 bytes so the block keeps malloc's alignment.
+struct alignas(16) AllocationHeader {
+    size_t size_;
+    unsigned tag_;
+};
+
+// Zero initialized before any constructor runs, so allocations made during static initialization count too
+std::atomic<unsigned long long> allocations[MAX_ALLOC_TAGS];
+std::atomic<unsigned long long> bytes[MAX_ALLOC_TAGS];
+std::atomic<long long> liveBytes[MAX_ALLOC_TAGS];
+std::atomic<long long> peakBytes[MAX_ALLOC_TAGS];
+
+thread_local AllocationTag currentTag = ALLOC_ENGINE;
+
+const char* TAG_NAMES[MAX_ALLOC_TAGS] = {"engine", "world", "missiles", "alerts", "ui", "streaming", "particles"};
+
+#ifdef TRACK_ALLOCATIONS
+void* TrackedAllocate(size_t size) {
+    auto* header = static_cast<AllocationHeader*>(std::malloc(sizeof(AllocationHeader) + size));
+    if (!header)
+        return nullptr;
+
+    AllocationTag tag = currentTag;
+    header->size_ = size;
+    header->tag_ = tag;
+    allocations[tag].fetch_add(1, std::memory_order_relaxed);
+    bytes[tag].fetch_add(size, std::memory_order_relaxed);
+    long long live = liveBytes[tag].fetch_add((long long)size, std::memory_order_relaxed) + (long long)size;
+    long long peak = peakBytes[tag].load(std::memory_order_relaxed);
+    while (live > peak && !peakBytes[tag].compare_exchange_weak(peak, live, std::memory_order_relaxed))
+        ;
+    return header + 1;
+}
+
+void TrackedFree(void* pointer) {
+    if (!pointer)
+        return;
+
+    AllocationHeader* header = static_cast<AllocationHeader*>(pointer) - 1;
+    liveBytes[header->tag_].fetch_sub((long long)header->size_, std::memory_order_relaxed);
+    std::free(header);
+}
+#endif
+
+}
+
+bool AllocationTracker::IsEnabled() {
+#ifdef TRACK_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+}
+
+AllocationCounters AllocationTracker::GetCounters(AllocationTag tag) {
+    AllocationCounters counters;
+    counters.allocations_ = allocations[tag].load(std::memory_order_relaxed);
+    counters.bytes_ = bytes[tag].load(std::memory_order_relaxed);
+    counters.liveBytes_ = liveBytes[tag].load(std::memory_order_relaxed);
+    counters.peakBytes_ = peakBytes[tag].load(std::memory_order_relaxed);
+    return counters;
+}
+
+AllocationTag AllocationTracker::GetCurrentTag() {
+    return currentTag;
+}
+
+void AllocationTracker::SetCurrentTag(AllocationTag tag) {
+    currentTag = tag;
+}
+
+void AllocationTracker::ResetPeaks() {
+    for (unsigned i = 0; i < MAX_ALLOC_TAGS; ++i)
+        peakBytes[i].store(liveBytes[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+const char* AllocationTracker::GetTagName(AllocationTag tag) {
+    return TAG_NAMES[tag];
+}
+
+#ifdef TRACK_ALLOCATIONS
+// Replacing these replaces them for the whole program, Urho3D included. The aligned overloads are left
+// alone, they allocate with aligned_alloc and free their own blocks, so they are simply not counted.
+void* operator new(size_t size) {
+    void* pointer = TrackedAllocate(size);
+    if (!pointer)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void* operator new[](size_t size) {
+    void* pointer = TrackedAllocate(size);
+    if (!pointer)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return TrackedAllocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return TrackedAllocate(size);
+}
+
+void operator delete(void* pointer) noexcept {
+    TrackedFree(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    TrackedFree(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    TrackedFree(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+    TrackedFree(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+    TrackedFree(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+    TrackedFree(pointer);
+}
+#endif
@@ -0,0 +1,84 @@
+#pragma once
+
+/// Subsystem an allocation is counted against, by the thread's current AllocationScope.
+enum AllocationTag {
+    /// Anything outside a scope: the engine's own update and rendering, job workers, startup.
+    ALLOC_ENGINE = 0,
+    ALLOC_WORLD,
+    ALLOC_MISSILES,
+    ALLOC_ALERTS,
+    ALLOC_UI,
+    ALLOC_STREAMING,
+    ALLOC_PARTICLES,
+    MAX_ALLOC_TAGS
+};
+
+/// Running totals for one tag. Memory is counted against the tag it was allocated under, also when freed.
+struct AllocationCounters {
+    unsigned long long allocations_ = 0;
+    unsigned long long bytes_ = 0;
+    long long liveBytes_ = 0;
+    /// Most live bytes since the last ResetPeaks.
+    long long peakBytes_ = 0;
+};
+
+/**
+* Counts every heap allocation made through operator new, which this game
+* replaces, by the tag of the AllocationScope the allocating thread is in.
+* Each block carries a small header with its size and tag so frees are
+* counted too, which gives live and peak bytes per subsystem. Counting is a
+* few relaxed atomic adds per allocation.
+*
+* operator new is only replaced in builds that define TRACK_ALLOCATIONS.
+* Without it the program, Urho3D included, keeps the standard allocator and
+* every counter stays zero.
+*/
+class AllocationTracker {
+public:
+    /// Whether this build counts allocations at all.
+    static bool IsEnabled();
+
+    static AllocationCounters GetCounters(AllocationTag tag);
+
+    static AllocationTag GetCurrentTag();
+
+    /// Start peak tracking over from the current live bytes, e.g. after a warmup.
+    static void ResetPeaks();
+
+    /// Lower case name for reports and the overlay.
+    static const char* GetTagName(AllocationTag tag);
+
+private:
+    friend class AllocationScope;
+
+    static void SetCurrentTag(AllocationTag tag);
+};
+
+/**
+* Counts the calling thread's allocations against tag until the scope ends.
+* Scopes nest, the previous tag is restored. Set switches tag in place, for a
+* function that runs one subsystem after another.
+*/
+class AllocationScope {
+public:
+    explicit AllocationScope(AllocationTag tag)
+                :previous_(AllocationTracker::GetCurrentTag())
+                {
+        AllocationTracker::SetCurrentTag(tag);
+    }
+
+    ~AllocationScope() {
+        AllocationTracker::SetCurrentTag(previous_);
+    }
+
+    void Set(AllocationTag tag) {
+        AllocationTracker::SetCurrentTag(tag);
+    }
+
+    AllocationScope(const AllocationScope&) = delete;
+
+    AllocationScope& operator =(const AllocationScope&) = delete;
+
+private:
+    AllocationTag previous_;
+};
@@ -0,0 +1,402 @@
+#include "Benchmark.hpp"
+#include "World.hpp"
+#include "Microbenchmarks.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+
+#include <Urho3D/Core/StringUtils.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+unsigned long long GetResidentMemory() {
+#ifdef __linux__
+    std::ifstream statm("/proc/self/statm");
+    unsigned long long size = 0, resident = 0;
+    if (statm >> size >> resident)
+        return resident * (unsigned long long)sysconf(_SC_PAGESIZE);
+#endif
+    return 0;
+}
+
+BenchmarkSettings BenchmarkSettings::Parse(const Vector<String>& arguments) {
+    BenchmarkSettings settings;
+    for (unsigned i = 0; i < arguments.Size(); ++i)
+    {
+        String argument = arguments[i].ToLower();
+        bool hasValue = i + 1 < arguments.Size() && !arguments[i + 1].StartsWith("-");
+
+        if (argument == "-benchmark")
+        {
+            settings.enabled_ = true;
+            if (hasValue)
+                settings.scenario_ = arguments[++i].CString();
+        }
+        else if (argument == "-frames" && hasValue)
+            settings.frames_ = ToUInt(arguments[++i]);
+        else if (argument == "-warmup" && hasValue)
+            settings.warmupFrames_ = ToUInt(arguments[++i]);
+        else if (argument == "-timestep" && hasValue)
+            settings.timeStep_ = ToFloat(arguments[++i]);
+        else if (argument == "-output" && hasValue)
+            settings.output_ = arguments[++i].CString();
+        else if (argument == "-windowed")
+            settings.headless_ = false;
+    }
+    return settings;
+}
+
+
+
+///////////////// Report ///////////////////////
+
+void BenchmarkReport::AddSample(const std::string& series, double value) {
+    series_[series].push_back(value);
+}
+
+void BenchmarkReport::SetMetric(const std::string& name, double value) {
+    metrics_[name] = value;
+}
+
+void BenchmarkReport::AddEvent(const std::string& text) {
+    events_.push_back(text);
+}
+
+BenchmarkReport::Summary BenchmarkReport::Summarise(std::vector<double> samples) {
+    Summary summary;
+    if (samples.empty())
+        return summary;
+
+    std::sort(samples.begin(), samples.end());
+    // Nearest-rank percentile
+    auto percentile = [&samples](double p) {
+        auto rank = (size_t)std::ceil(p * samples.size());
+        return samples[std::min(samples.size() - 1, rank ? rank - 1 : 0)];
+    };
+
+    summary.count_ = samples.size();
+    summary.min_ = samples.front();
+    summary.max_ = samples.back();
+    summary.p50_ = percentile(0.50);
+    summary.p95_ = percentile(0.95);
+    summary.p99_ = percentile(0.99);
+    summary.mean_ = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+    return summary;
+}
+
+bool BenchmarkReport::Write(const std::string& basePath) const {
+    std::ofstream json(basePath + ".json");
+    std::ofstream csv(basePath + ".csv");
+    if (!json || !csv)
+        return false;
+
+    csv << "name,count,min,p50,p95,p99,max,mean\n";
+    json << "{\n  \"series\": {";
+    bool first = true;
+    for (const auto& series : series_)
+    {
+        Summary s = Summarise(series.second);
+        csv << series.first << ',' << s.count_ << ',' << s.min_ << ',' << s.p50_ << ',' << s.p95_ << ','
+            << s.p99_ << ',' << s.max_ << ',' << s.mean_ << '\n';
+        json << (first ? "\n" : ",\n") << "    \"" << series.first << "\": {\"count\": " << s.count_
+             << ", \"min\": " << s.min_ << ", \"p50\": " << s.p50_ << ", \"p95\": " << s.p95_
+             << ", \"p99\": " << s.p99_ << ", \"max\": " << s.max_ << ", \"mean\": " << s.mean_ << "}";
+        first = false;
+    }
+
+    json << "\n  },\n  \"metrics\": {";
+    first = true;
+    for (const auto& metric : metrics_)
+    {
+        csv << metric.first << ",1," << metric.second << ",,,,,\n";
+        json << (first ? "\n" : ",\n") << "    \"" << metric.first << "\": " << metric.second;
+        first = false;
+    }
+
+    json << "\n  },\n  \"events\": [";
+    first = true;
+    for (const auto& event : events_)
+    {
+        std::string escaped;
+        for (char c : event)
+        {
+            if (c == '"' || c == '\\')
+                escaped.push_back('\\');
+            escaped.push_back(c);
+        }
+        json << (first ? "\n" : ",\n") << "    \"" << escaped << "\"";
+        first = false;
+    }
+    json << "\n  ]\n}\n";
+    return true;
+}
+
+
+
+///////////////// Frame benchmark ///////////////////////
+
+Benchmark::Benchmark(Context* context, World& world, const BenchmarkSettings& settings)
+        :Object(context),
+        world_(world),
+        settings_(settings)
+        {
+}
+
+void Benchmark::start() {
+    if (!settings_.DrivesWorld())
+    {
+        if (!RunMicrobenchmark(context_, settings_.scenario_, settings_, report_))
+            URHO3D_LOGERRORF("Unknown benchmark scenario '%s'", settings_.scenario_.c_str());
+        Finish();
+        return;
+    }
+
+    if (settings_.scenario_ == "replay" && !world_.IsReplaying())
+    {
+        URHO3D_LOGERROR("Benchmark 'replay' needs an input log, pass -replay PATH");
+        GetSubsystem<Engine>()->Exit();
+        return;
+    }
+
+    auto* engine = GetSubsystem<Engine>();
+    // Run as fast as possible, the scripted timestep keeps the simulation identical between runs
+    engine->SetMaxFps(0);
+    ScheduleTimeStep();
+    // A replay runs as long as its log, the report is written once World has fed all of it back
+    if (settings_.scenario_ == "replay")
+        world_.SetExitAfterReplay(false);
+
+    SubscribeToEvent(E_BEGINFRAME, URHO3D_HANDLER(Benchmark, HandleBeginFrame));
+    SubscribeToEvent(E_ENDFRAME, URHO3D_HANDLER(Benchmark, HandleEndFrame));
+
+    URHO3D_LOGINFOF("Benchmark '%s': %u frames after %u warmup frames, headless=%d",
+                    settings_.scenario_.c_str(), settings_.frames_, settings_.warmupFrames_, settings_.headless_);
+}
+
+void Benchmark::HandleBeginFrame(StringHash eventType, VariantMap& eventData) {
+    // Frames spent waiting for the preloader are not part of the run
+    frameStarted_ = world_.IsReady();
+    if (!frameStarted_)
+        return;
+
+    // Peaks from loading and warmup are not part of the run either
+    if (frame_ == settings_.warmupFrames_)
+        AllocationTracker::ResetPeaks();
+    for (unsigned i = 0; i < MAX_ALLOC_TAGS; ++i)
+        frameAllocations_[i] = AllocationTracker::GetCounters((AllocationTag)i);
+
+    frameTimer_.Reset();
+    DriveScript();
+}
+
+void Benchmark::HandleEndFrame(StringHash eventType, VariantMap& eventData) {
+    if (!frameStarted_)
+    {
+        ScheduleTimeStep();
+        return;
+    }
+
+    double frameMs = frameTimer_.GetUSec(false) / 1000.0;
+
+    if (frame_ == 0)
+    {
+        report_.SetMetric("startup.world_ms", world_.GetStartupMs());
+        report_.SetMetric("startup.first_frame_ms", frameMs);
+        report_.SetMetric("startup.preload", world_.GetOptions().preload_ ? 1 : 0);
+    }
+
+    if (frame_ >= settings_.warmupFrames_)
+    {
+        const WorldFrameTimings& timings = world_.GetFrameTimings();
+        report_.AddSample("frame_ms", frameMs);
+        report_.AddSample("world.camera_us", timings.cameraUs_);
+        report_.AddSample("world.missiles_us", timings.missilesUs_);
+        report_.AddSample("world.alerts_us", timings.alertsUs_);
+        report_.AddSample("world.preview_us", timings.previewUs_);
+        report_.AddSample("world.streaming_us", timings.streamingUs_);
+        report_.AddSample("world.sim_steps", world_.GetFixedTimestep().GetStepsThisFrame());
+        if (AllocationTracker::IsEnabled())
+        {
+            unsigned long long frameAllocations = 0;
+            for (unsigned i = 0; i < MAX_ALLOC_TAGS; ++i)
+            {
+                AllocationCounters counters = AllocationTracker::GetCounters((AllocationTag)i);
+                std::string prefix = std::string("alloc.") + AllocationTracker::GetTagName((AllocationTag)i);
+                report_.AddSample(prefix + ".per_frame", (double)(counters.allocations_ - frameAllocations_[i].allocations_));
+                report_.AddSample(prefix + ".bytes_per_frame", (double)(counters.bytes_ - frameAllocations_[i].bytes_));
+                frameAllocations += counters.allocations_ - frameAllocations_[i].allocations_;
+            }
+            report_.AddSample("alloc.per_frame", (double)frameAllocations);
+        }
+        if (QualityGovernor* governor = world_.GetQualityGovernor())
+            report_.AddSample("quality.level", governor->GetLevel());
+        report_.AddSample("world.missiles_live", world_.GetNumMissiles());
+        report_.AddSample("world.missile_hits", world_.GetNumMissileHits());
+        report_.AddSample("preview.renders", world_.GetPreviewRendersThisFrame());
+        if (auto* renderer = GetSubsystem<Renderer>())
+        {
+            report_.AddSample("renderer.views", renderer->GetNumViews());
+            report_.AddSample("renderer.occluders", renderer->GetNumOccluders());
+        }
+        if (InstancedPopulation* occluders = world_.GetRegistry().Get(world_.GetEntities().boxes_[1]))
+        {
+            report_.AddSample("occlusion.boxes_drawn", occluders->GetNumOccludersDrawn());
+            report_.AddSample("occlusion.triangles", occluders->GetNumOccluderTrianglesDrawn());
+        }
+        if (ChunkStreamer* streamer = world_.GetStreamer())
+        {
+            report_.AddSample("streaming.attach_us", streamer->GetAttachUs());
+            report_.AddSample("streaming.attached_per_frame", streamer->GetAttachedThisFrame());
+            report_.AddSample("streaming.unloaded_per_frame", streamer->GetUnloadedThisFrame());
+            report_.AddSample("streaming.chunks_loaded", streamer->GetNumAttached());
+            report_.AddSample("streaming.chunks_pending", streamer->GetNumPending());
+        }
+        if (settings_.scenario_ == "alerts")
+        {
+            AlertBoard* alerts = world_.GetAlertBoard();
+            report_.AddSample("alerts.visible", alerts->GetNumVisible());
+            report_.AddSample("alerts.elements_created", alerts->GetNumElementsCreated());
+            report_.AddSample("ui.elements", GetSubsystem<UI>()->GetRoot()->GetNumChildren(true));
+        }
+        // A hitch is a frame that would miss two vsyncs at 60 Hz
+        if (frameMs > 33.3)
+            ++hitches_;
+        // Reading /proc is not free, twice a second of simulated time is plenty
+        if (frame_ % 30 == 0)
+            report_.AddSample("memory.resident_mb", GetResidentMemory() / (1024.0 * 1024.0));
+    }
+
+    ++frame_;
+    bool finished = settings_.scenario_ == "replay" ? world_.IsReplayFinished() :
+                    frame_ >= settings_.warmupFrames_ + settings_.frames_;
+    if (finished)
+    {
+        Finish();
+        return;
+    }
+
+    ScheduleTimeStep();
+}
+
+void Benchmark::ScheduleTimeStep() {
+    // Override whatever the frame limiter measured so the next frame simulates the scripted step
+    if (!world_.IsReplaying())
+        GetSubsystem<Engine>()->SetNextTimeStep(settings_.timeStep_);
+}
+
+void Benchmark::DriveScript() {
+    // The input log drives a replay
+    if (settings_.scenario_ == "replay")
+        return;
+
+    scriptTime_ += settings_.timeStep_;
+
+    if (settings_.scenario_ == "streaming")
+    {
+        // Fly straight out over the streamed world, fast enough to cross a chunk every second
+        const float SPEED = 80.0f;
+        Vector3 position(scriptTime_ * SPEED, 15.0f, 20.0f * std::sin(scriptTime_ * 0.3f));
+        Node* cameraNode = world_.GetCameraNode();
+        cameraNode->SetPosition(position);
+        cameraNode->LookAt(position + Vector3(1.0f, -0.15f, 0.0f));
+        if (frame_ % 20 == 0)
+            world_.FireMissile();
+        return;
+    }
+
+    if (settings_.scenario_ == "alerts")
+    {
+        // Press G as the player would, many times a frame, through World's key handler
+        const unsigned ALERTS_PER_FRAME = 50;
+        VariantMap& keyData = GetEventDataMap();
+        keyData[KeyDown::P_KEY] = KEY_G;
+        keyData[KeyDown::P_SCANCODE] = SCANCODE_G;
+        keyData[KeyDown::P_BUTTONS] = 0;
+        keyData[KeyDown::P_QUALIFIERS] = 0;
+        keyData[KeyDown::P_REPEAT] = false;
+        for (unsigned i = 0; i < ALERTS_PER_FRAME; ++i)
+            SendEvent(E_KEYDOWN, keyData);
+    }
+
+    // Fly a figure of eight over the field, looking slightly down along the direction of travel
+    const float RADIUS = 35.0f;
+    const float SPEED = 0.25f;
+    float t = scriptTime_ * SPEED;
+    Vector3 position(RADIUS * std::cos(t), 10.0f, RADIUS * 0.5f * std::sin(2 * t));
+    Vector3 ahead(RADIUS * std::cos(t + 0.1f), 8.0f, RADIUS * 0.5f * std::sin(2 * (t + 0.1f)));
+
+    Node* cameraNode = world_.GetCameraNode();
+    cameraNode->SetPosition(position);
+    cameraNode->LookAt(ahead);
+
+    // Fire a burst of three missiles every tenth frame for two seconds, then hold fire for one
+    const unsigned FIRE_PERIOD = 180;
+    unsigned phase = frame_ % FIRE_PERIOD;
+    if (phase < 120 && phase % 10 == 0)
+    {
+        for (int i = 0; i < 3; ++i)
+            world_.FireMissile();
+    }
+}
+
+void Benchmark::Finish() {
+    UnsubscribeFromAllEvents();
+
+    report_.SetMetric("frames", settings_.frames_);
+    report_.SetMetric("timestep", settings_.timeStep_);
+    report_.SetMetric("headless", settings_.headless_ ? 1 : 0);
+    if (settings_.DrivesWorld())
+    {
+        report_.SetMetric("frame.hitches", hitches_);
+        report_.SetMetric("sim.tick_rate", world_.GetFixedTimestep().GetTickRate());
+        report_.SetMetric("sim.ticks", (double)world_.GetFixedTimestep().GetTick());
+        report_.SetMetric("sim.dropped_ms", world_.GetFixedTimestep().GetDroppedTime() * 1000.0);
+        for (unsigned i = 0; i < MAX_ALLOC_TAGS && AllocationTracker::IsEnabled(); ++i)
+        {
+            AllocationCounters counters = AllocationTracker::GetCounters((AllocationTag)i);
+            report_.SetMetric(std::string("alloc.") + AllocationTracker::GetTagName((AllocationTag)i) + ".peak_bytes",
+                              (double)counters.peakBytes_);
+        }
+        report_.SetMetric("arena.peak_bytes", world_.GetFrameArena().GetPeak());
+        report_.SetMetric("arena.blocks_allocated", world_.GetFrameArena().GetNumBlocksAllocated());
+    }
+    if (QualityGovernor* governor = world_.GetQualityGovernor())
+    {
+        // Every decision goes into the report so the governor can be audited
+        for (const QualityDecision& decision : governor->GetDecisions())
+        {
+            report_.AddEvent(ToString("frame %u: quality %s -> %s, mean frame %.2f ms, target %.2f ms", decision.frame_,
+                                      QualityGovernor::GetLevelSettings(decision.from_).name_,
+                                      QualityGovernor::GetLevelSettings(decision.to_).name_, decision.meanFrameMs_,
+                                      governor->GetTargetFrameMs()).CString());
+        }
+        report_.SetMetric("quality.changes", governor->GetDecisions().Size());
+        report_.SetMetric("quality.final_level", governor->GetLevel());
+    }
+    if (settings_.scenario_ == "replay")
+    {
+        report_.SetMetric("replay.frames", frame_);
+        report_.SetMetric("replay.state_hash", world_.GetStateHash());
+        report_.SetMetric("replay.match", world_.IsReplayMatch() ? 1 : 0);
+    }
+    if (settings_.scenario_ == "alerts")
+    {
+        AlertBoard* alerts = world_.GetAlertBoard();
+        report_.SetMetric("alerts.shown", alerts->GetNumShown());
+        report_.SetMetric("alerts.expired", alerts->GetNumExpired());
+        report_.SetMetric("alerts.evicted", alerts->GetNumEvicted());
+        report_.SetMetric("alerts.pool_size", alerts->GetPoolSize());
+        report_.SetMetric("alerts.elements_created", alerts->GetNumElementsCreated());
+    }
+
+    if (report_.Write(settings_.output_))
+        URHO3D_LOGINFOF("Benchmark report written to %s.json and %s.csv", settings_.output_.c_str(), settings_.output_.c_str());
+    else
+        URHO3D_LOGERRORF("Could not write benchmark report to %s", settings_.output_.c_str());
+
+    GetSubsystem<Engine>()->Exit();
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Engine/Engine.h>
+#include <Urho3D/Graphics/Renderer.h>
+#include <Urho3D/IO/Log.h>
+
+#include "AllocationTracker.hpp"
+
+using namespace Urho3D;
+
+struct World;
+
+/// Resident set size of this process in bytes, or 0 where it cannot be queried.
+unsigned long long GetResidentMemory();
+
+/**
+* Options for a benchmark run, parsed from the command line:
+*
+*   -benchmark [scenario]   run a benchmark instead of the interactive game (default scenario "frames")
+*   -frames N               number of recorded frames, the replay scenario runs its whole input log
+*   -warmup N               frames to run before recording starts
+*   -timestep S             fixed simulation timestep fed to the engine every frame, a replay uses the recorded ones
+*   -output PATH            report path without extension, PATH.json and PATH.csv are written
+*   -windowed               keep the renderer, by default benchmarks run headless
+*/
+struct BenchmarkSettings {
+
+    static BenchmarkSettings Parse(const Vector<String>& arguments);
+
+    bool enabled_ = false;
+    bool headless_ = true;
+    std::string scenario_ = "frames";
+    unsigned frames_ = 2000;
+    unsigned warmupFrames_ = 60;
+    float timeStep_ = 1.0f / 60.0f;
+    std::string output_ = "benchmark";
+
+    /// Scenarios that run the real World frame by frame rather than a microbenchmark.
+    bool DrivesWorld() const {
+        return scenario_ == "frames" || scenario_ == "streaming" || scenario_ == "alerts" || scenario_ == "replay";
+    }
+};
+
+/**
+* Collects samples and scalar metrics and writes them out as JSON and CSV.
+* Each sample series is summarised as min/p50/p95/p99/max/mean.
+*/
+class BenchmarkReport {
+public:
+    void AddSample(const std::string& series, double value);
+
+    void SetMetric(const std::string& name, double value);
+
+    void AddEvent(const std::string& text);
+
+    bool Write(const std::string& basePath) const;
+
+private:
+    struct Summary {
+        size_t count_ = 0;
+        double min_ = 0, p50_ = 0, p95_ = 0, p99_ = 0, max_ = 0, mean_ = 0;
+    };
+
+    static Summary Summarise(std::vector<double> samples);
+
+    std::map<std::string, std::vector<double>> series_;
+    std::map<std::string, double> metrics_;
+    std::vector<std::string> events_;
+};
+
+/**
+* Drives World through a scripted camera path and missile fire pattern for a
+* fixed number of frames and reports frame time and per-subsystem update cost.
+* Every frame is fed the same timestep so runs are comparable between builds.
+*/
+class Benchmark : public Object {
+
+    URHO3D_OBJECT(Benchmark, Object);
+
+public:
+    Benchmark(Context* context, World& world, const BenchmarkSettings& settings);
+
+    void start();
+
+private:
+    void HandleBeginFrame(StringHash eventType, VariantMap& eventData);
+
+    void HandleEndFrame(StringHash eventType, VariantMap& eventData);
+
+    void DriveScript();
+
+    /// Feed the engine the scripted timestep, unless World is feeding it recorded ones.
+    void ScheduleTimeStep();
+
+    void Finish();
+
+    World& world_;
+    BenchmarkSettings settings_;
+    BenchmarkReport report_;
+
+    HiresTimer frameTimer_;
+    unsigned frame_ = 0;
+    bool frameStarted_ = false;
+    float scriptTime_ = 0;
+    unsigned hitches_ = 0;
+    /// Allocation counters when the frame began.
+    AllocationCounters frameAllocations_[MAX_ALLOC_TAGS];
+};
@@ -0,0 +1,313 @@
+#include "ChunkStreamer.hpp"
+#include "InstancedPopulation.hpp"
+#include "PoissonScatter.hpp"
+#include "Trace.hpp"
+
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Graphics/StaticModel.h>
+#include <Urho3D/Resource/ResourceCache.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+unsigned HashChunk(const IntVector2& coord, unsigned seed) {
+    unsigned hash = seed ^ 0x2545f491u;
+    hash = (hash ^ (unsigned)coord.x_) * 0x9e3779b1u;
+    hash = (hash ^ (unsigned)coord.y_) * 0x85ebca77u;
+    return hash ^ (hash >> 15);
+}
+
+void GenerateChunkWork(const WorkItem* item, unsigned threadIndex) {
+    TraceScope trace("ChunkStreamer::Generate");
+    ChunkStreamer::GenerateChunk(*static_cast<ChunkData*>(item->aux_));
+}
+
+}
+
+ChunkStreamer::ChunkStreamer(Context* context, Scene* scene, SpatialHash* collisionGrid)
+                :Object(context),
+                scene_(scene),
+                collisionGrid_(collisionGrid),
+                chunkSize_(64.0f),
+                loadRadius_(5.0f),
+                unloadMargin_(1.5f),
+                attachBudgetUs_(2000),
+                maxInFlight_(8),
+                seed_(1),
+                mushroomDensity_(1.0f),
+                numAttached_(0),
+                attachedThisFrame_(0),
+                unloadedThisFrame_(0),
+                attachUs_(0)
+                {
+    workQueue_ = GetSubsystem<WorkQueue>();
+
+    auto* cache = GetSubsystem<ResourceCache>();
+    groundModel_ = cache->GetResource<Model>("Models/Plane.mdl");
+    groundMaterial_ = cache->GetResource<Material>("Materials/StoneTiled.xml");
+    mushroomModel_ = cache->GetResource<Model>("Models/Mushroom.mdl");
+    mushroomMaterial_ = cache->GetResource<Material>("Materials/Mushroom.xml");
+    boxModel_ = cache->GetResource<Model>("Models/Box.mdl");
+    boxMaterial_ = cache->GetResource<Material>("Materials/Stone.xml");
+}
+
+ChunkStreamer::~ChunkStreamer() {
+    // Work items hold raw pointers into chunk data, make sure no worker is still writing to it
+    for (auto i = chunks_.Begin(); i != chunks_.End(); ++i)
+    {
+        Chunk& chunk = i->second_;
+        if (chunk.state_ == CHUNK_GENERATING && !workQueue_->RemoveWorkItem(chunk.item_))
+            abandoned_.Push(chunk);
+    }
+    for (const Chunk& chunk : abandoned_)
+    {
+        while (!chunk.item_->completed_)
+            Time::Sleep(0);
+    }
+}
+
+void ChunkStreamer::GenerateChunk(ChunkData& data) {
+    // Each chunk is scattered on its own, so objects either side of a chunk edge are not kept apart
+    PoissonScatter scatter;
+    scatter.SetArea(Rect(0.0f, 0.0f, data.size_, data.size_));
+    scatter.SetSeed(HashChunk(data.coord_, data.seed_));
+    unsigned boxes = scatter.AddCategory(data.boxCategory_);
+    unsigned mushrooms = scatter.AddCategory(data.mushroomCategory_);
+    // Already on a worker thread, the tiles run here
+    scatter.Generate();
+
+    const PODVector<ScatterPlacement>& mushroomPlacements = scatter.GetPlacements(mushrooms);
+    data.mushrooms_.Resize(mushroomPlacements.Size());
+    for (unsigned i = 0; i < mushroomPlacements.Size(); ++i)
+    {
+        ChunkPlacement& mushroom = data.mushrooms_[i];
+        mushroom.position_ = mushroomPlacements[i].position_;
+        mushroom.yaw_ = mushroomPlacements[i].yaw_;
+        mushroom.scale_ = mushroomPlacements[i].scale_;
+    }
+
+    const PODVector<ScatterPlacement>& boxPlacements = scatter.GetPlacements(boxes);
+    data.boxes_.Resize(boxPlacements.Size());
+    for (unsigned i = 0; i < boxPlacements.Size(); ++i)
+    {
+        ChunkPlacement& box = data.boxes_[i];
+        box.scale_ = boxPlacements[i].scale_;
+        box.position_ = Vector3(boxPlacements[i].position_.x_, box.scale_ * 0.5f, boxPlacements[i].position_.z_);
+        box.yaw_ = 0.0f;
+    }
+}
+
+void ChunkStreamer::Update(const Vector3& focus, FrameArena& arena) {
+    TraceScope trace("ChunkStreamer::Update");
+    attachedThisFrame_ = 0;
+    unloadedThisFrame_ = 0;
+    attachUs_ = 0;
+
+    for (unsigned i = abandoned_.Size(); i-- > 0;)
+    {
+        if (abandoned_[i].item_->completed_)
+            abandoned_.Erase(i);
+    }
+
+    // Unload what fell out of range and note which chunks finished generating
+    unsigned inFlight = 0;
+    float unloadRadius = loadRadius_ + unloadMargin_;
+    for (auto i = chunks_.Begin(); i != chunks_.End();)
+    {
+        Chunk& chunk = i->second_;
+        if (GetChunkDistance(i->first_, focus) > unloadRadius)
+        {
+            UnloadChunk(chunk);
+            i = chunks_.Erase(i);
+            continue;
+        }
+
+        if (chunk.state_ == CHUNK_GENERATING)
+        {
+            if (chunk.item_->completed_)
+                chunk.state_ = CHUNK_GENERATED;
+            else
+                ++inFlight;
+        }
+        ++i;
+    }
+
+    // Queue missing chunks nearest first, keeping only a few in flight so priorities follow the focus
+    IntVector2 center = GetChunkCoord(focus);
+    int reach = CeilToInt(loadRadius_);
+    auto* candidates = arena.Allocate<Candidate>((2 * reach + 1) * (2 * reach + 1));
+    unsigned numCandidates = 0;
+    for (int z = center.y_ - reach; z <= center.y_ + reach; ++z)
+    {
+        for (int x = center.x_ - reach; x <= center.x_ + reach; ++x)
+        {
+            IntVector2 coord(x, z);
+            float distance = GetChunkDistance(coord, focus);
+            if (distance <= loadRadius_ && !chunks_.Contains(coord))
+                candidates[numCandidates++] = {coord, distance, nullptr};
+        }
+    }
+    auto byDistance = [](const Candidate& lhs, const Candidate& rhs) { return lhs.distance_ < rhs.distance_; };
+    std::sort(candidates, candidates + numCandidates, byDistance);
+    for (unsigned i = 0; i < numCandidates && inFlight < maxInFlight_; ++i, ++inFlight)
+        QueueChunk(candidates[i].coord_, focus);
+
+    // Attach generated chunks nearest first until the budget is spent. At least one goes in every
+    // frame, so a chunk bigger than the budget cannot stall streaming.
+    candidates = arena.Allocate<Candidate>(chunks_.Size());
+    numCandidates = 0;
+    for (auto i = chunks_.Begin(); i != chunks_.End(); ++i)
+    {
+        if (i->second_.state_ == CHUNK_GENERATED)
+            candidates[numCandidates++] = {i->first_, GetChunkDistance(i->first_, focus), &i->second_};
+    }
+    std::sort(candidates, candidates + numCandidates, byDistance);
+
+    HiresTimer timer;
+    for (unsigned i = 0; i < numCandidates; ++i)
+    {
+        if (attachedThisFrame_ > 0 && timer.GetUSec(false) >= attachBudgetUs_)
+            break;
+        AttachChunk(*candidates[i].chunk_);
+        ++attachedThisFrame_;
+    }
+    attachUs_ = timer.GetUSec(false);
+}
+
+IntVector2 ChunkStreamer::GetChunkCoord(const Vector3& position) const {
+    return IntVector2(FloorToInt(position.x_ / chunkSize_), FloorToInt(position.z_ / chunkSize_));
+}
+
+float ChunkStreamer::GetChunkDistance(const IntVector2& coord, const Vector3& focus) const {
+    float dx = (coord.x_ + 0.5f) - focus.x_ / chunkSize_;
+    float dz = (coord.y_ + 0.5f) - focus.z_ / chunkSize_;
+    return std::sqrt(dx * dx + dz * dz);
+}
+
+void ChunkStreamer::QueueChunk(const IntVector2& coord, const Vector3& focus) {
+    Chunk& chunk = chunks_[coord];
+    chunk.state_ = CHUNK_GENERATING;
+    chunk.data_ = std::make_shared<ChunkData>();
+    chunk.data_->coord_ = coord;
+    chunk.data_->size_ = chunkSize_;
+    chunk.data_->seed_ = seed_;
+    chunk.data_->boxCategory_ = boxCategory_;
+    chunk.data_->mushroomCategory_ = mushroomCategory_;
+
+    // Own item rather than a pooled one, the queue recycles pooled items while we still look at them
+    chunk.item_ = new WorkItem();
+    chunk.item_->workFunction_ = GenerateChunkWork;
+    chunk.item_->aux_ = chunk.data_.get();
+    chunk.item_->priority_ = (unsigned)Max(0, 100000 - RoundToInt(GetChunkDistance(coord, focus) * 100.0f));
+    chunk.item_->sendEvent_ = false;
+    workQueue_->AddWorkItem(chunk.item_);
+}
+
+void ChunkStreamer::SetCategories(const ScatterCategory& boxes, const ScatterCategory& mushrooms) {
+    boxCategory_ = boxes;
+    mushroomCategory_ = mushrooms;
+
+    // The next Update queues them again, nearest first
+    for (auto i = chunks_.Begin(); i != chunks_.End(); ++i)
+        UnloadChunk(i->second_);
+    chunks_.Clear();
+}
+
+void ChunkStreamer::SetMushroomDensity(float density) {
+    mushroomDensity_ = density;
+    for (auto i = chunks_.Begin(); i != chunks_.End(); ++i)
+    {
+        // The mushrooms are the chunk node's first population
+        if (i->second_.state_ == CHUNK_ATTACHED)
+            i->second_.node_->GetComponent<InstancedPopulation>()->SetDensity(density);
+    }
+}
+
+void ChunkStreamer::AttachChunk(Chunk& chunk) {
+    TraceScope trace("ChunkStreamer::Attach");
+    const ChunkData& data = *chunk.data_;
+    Vector3 origin(data.coord_.x_ * data.size_, 0.0f, data.coord_.y_ * data.size_);
+
+    // Temporary, so streamed chunks are never saved with the scene
+    chunk.node_ = scene_->CreateChild("Chunk", LOCAL, 0, true);
+    chunk.node_->SetPosition(origin);
+
+    Node* groundNode = chunk.node_->CreateChild("Ground", LOCAL);
+    groundNode->SetPosition(Vector3(data.size_ * 0.5f, 0.0f, data.size_ * 0.5f));
+    groundNode->SetScale(Vector3(data.size_, 1.0f, data.size_));
+    auto* ground = groundNode->CreateComponent<StaticModel>();
+    ground->SetModel(groundModel_);
+    ground->SetMaterial(groundMaterial_);
+
+    auto* mushrooms = chunk.node_->CreateComponent<InstancedPopulation>();
+    mushrooms->SetModel(mushroomModel_);
+    mushrooms->SetMaterial(mushroomMaterial_);
+    mushrooms->SetCastShadows(true);
+    mushrooms->SetDensity(mushroomDensity_);
+    mushrooms->Reserve(data.mushrooms_.Size());
+    for (const ChunkPlacement& mushroom : data.mushrooms_)
+        mushrooms->AddInstance(mushroom.position_, Quaternion(0.0f, mushroom.yaw_, 0.0f), Vector3::ONE * mushroom.scale_);
+
+    // Same split as the fixed field: big boxes occlude, small ones do not
+    InstancedPopulation* boxGroups[2];
+    for (unsigned i = 0; i < 2; ++i)
+    {
+        boxGroups[i] = chunk.node_->CreateComponent<InstancedPopulation>();
+        boxGroups[i]->SetModel(boxModel_);
+        boxGroups[i]->SetMaterial(boxMaterial_);
+        boxGroups[i]->SetCastShadows(true);
+        boxGroups[i]->SetOccluder(i == 1);
+    }
+
+    float half = data.size_ * 0.5f;
+    chunk.staticIds_.Clear();
+    if (collisionGrid_)
+    {
+        Vector3 groundCenter = origin + Vector3(half, 0.0f, half);
+        chunk.staticIds_.Push(collisionGrid_->InsertStatic(BoundingBox(groundCenter - Vector3(half, 0.01f, half),
+                                                                       groundCenter + Vector3(half, 0.0f, half))));
+    }
+    for (const ChunkPlacement& box : data.boxes_)
+    {
+        boxGroups[box.scale_ >= 3.0f ? 1 : 0]->AddInstance(box.position_, Quaternion::IDENTITY, Vector3::ONE * box.scale_);
+        if (collisionGrid_)
+        {
+            Vector3 center = origin + box.position_;
+            Vector3 extent = Vector3::ONE * box.scale_ * 0.5f;
+            chunk.staticIds_.Push(collisionGrid_->InsertStatic(BoundingBox(center - extent, center + extent)));
+        }
+    }
+
+    // Placements are in the scene now, the generated data is no longer needed
+    chunk.data_.reset();
+    chunk.item_.Reset();
+    chunk.state_ = CHUNK_ATTACHED;
+    ++numAttached_;
+}
+
+void ChunkStreamer::UnloadChunk(Chunk& chunk) {
+    switch (chunk.state_)
+    {
+    case CHUNK_GENERATING:
+        // A worker may be running it, in which case the data has to outlive the work item
+        if (!workQueue_->RemoveWorkItem(chunk.item_))
+            abandoned_.Push(chunk);
+        break;
+
+    case CHUNK_ATTACHED:
+        chunk.node_->Remove();
+        if (collisionGrid_)
+        {
+            for (unsigned id : chunk.staticIds_)
+                collisionGrid_->RemoveStatic(id);
+        }
+        --numAttached_;
+        ++unloadedThisFrame_;
+        break;
+
+    default:
+        break;
+    }
+}
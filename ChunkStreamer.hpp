@@ -0,0 +1,157 @@
+#pragma once
+
+#include <memory>
+
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/Graphics/Material.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/Math/Vector2.h>
+#include <Urho3D/Math/Vector3.h>
+#include <Urho3D/Scene/Node.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "FrameArena.hpp"
+#include "PoissonScatter.hpp"
+#include "SpatialHash.hpp"
+
+using namespace Urho3D;
+
+/// One object placed in a chunk, relative to the chunk's corner.
+struct ChunkPlacement {
+    Vector3 position_;
+    float yaw_;
+    float scale_;
+};
+
+/// Everything generated for a chunk off the main thread, before any scene objects exist.
+struct ChunkData {
+    IntVector2 coord_;
+    float size_;
+    unsigned seed_;
+    ScatterCategory boxCategory_;
+    ScatterCategory mushroomCategory_;
+    PODVector<ChunkPlacement> mushrooms_;
+    PODVector<ChunkPlacement> boxes_;
+};
+
+/**
+* Streams a square grid of chunks around a position, usually the camera.
+*
+* Chunks inside the load radius are generated on the WorkQueue's worker
+* threads: placement of the mushrooms and boxes is decided there, seeded by
+* the chunk coordinate so a chunk looks the same every time it comes back.
+* Generated chunks are turned into scene nodes on the main thread, nearest
+* first, only until the per-frame attach budget runs out, so crossing into
+* new ground never costs one long frame. Chunks beyond the unload radius are
+* removed along with their collision boxes.
+*/
+class ChunkStreamer : public Object {
+
+    URHO3D_OBJECT(ChunkStreamer, Object);
+
+public:
+    ChunkStreamer(Context* context, Scene* scene, SpatialHash* collisionGrid);
+    ~ChunkStreamer() override;
+
+    /// Queue, attach and unload chunks for the given focus position. Scratch lists come from arena.
+    void Update(const Vector3& focus, FrameArena& arena);
+
+    /// Chunks within this many chunk lengths of the focus are loaded.
+    void SetLoadRadius(float chunks) { loadRadius_ = chunks; }
+
+    /// Time per frame that may be spent creating chunk nodes, in microseconds.
+    void SetAttachBudget(unsigned microseconds) { attachBudgetUs_ = microseconds; }
+
+    void SetChunkSize(float size) { chunkSize_ = size; }
+
+    float GetChunkSize() const { return chunkSize_; }
+
+    void SetSeed(unsigned seed) { seed_ = seed; }
+
+    /// Scatter the boxes and mushrooms of chunks like the field, usually WorldConfig's categories. Chunks
+    /// already queued or loaded are dropped and come back scattered with the new categories.
+    void SetCategories(const ScatterCategory& boxes, const ScatterCategory& mushrooms);
+
+    /// Fraction of mushrooms drawn, in loaded chunks and those loaded later.
+    void SetMushroomDensity(float density);
+
+    unsigned GetNumAttached() const { return numAttached_; }
+
+    unsigned GetNumPending() const { return chunks_.Size() - numAttached_; }
+
+    /// Chunks attached and unloaded during the last Update.
+    unsigned GetAttachedThisFrame() const { return attachedThisFrame_; }
+
+    unsigned GetUnloadedThisFrame() const { return unloadedThisFrame_; }
+
+    /// Time spent attaching during the last Update, in microseconds.
+    long long GetAttachUs() const { return attachUs_; }
+
+    /// Fill a chunk with placements. Runs on worker threads, must only touch data.
+    static void GenerateChunk(ChunkData& data);
+
+private:
+    enum ChunkState {
+        CHUNK_GENERATING,
+        CHUNK_GENERATED,
+        CHUNK_ATTACHED
+    };
+
+    struct Chunk {
+        ChunkState state_;
+        SharedPtr<WorkItem> item_;
+        std::shared_ptr<ChunkData> data_;
+        SharedPtr<Node> node_;
+        /// Ids of this chunk's boxes in the collision grid.
+        PODVector<unsigned> staticIds_;
+    };
+
+    struct Candidate {
+        IntVector2 coord_;
+        float distance_;
+        Chunk* chunk_;
+    };
+
+    IntVector2 GetChunkCoord(const Vector3& position) const;
+
+    float GetChunkDistance(const IntVector2& coord, const Vector3& focus) const;
+
+    void QueueChunk(const IntVector2& coord, const Vector3& focus);
+
+    void AttachChunk(Chunk& chunk);
+
+    void UnloadChunk(Chunk& chunk);
+
+    WeakPtr<Scene> scene_;
+    SpatialHash* collisionGrid_;
+    WeakPtr<WorkQueue> workQueue_;
+
+    HashMap<IntVector2, Chunk> chunks_;
+    /// Dropped chunks whose work item was already running; kept until the worker is done with their data.
+    Vector<Chunk> abandoned_;
+
+    SharedPtr<Model> groundModel_;
+    SharedPtr<Material> groundMaterial_;
+    SharedPtr<Model> mushroomModel_;
+    SharedPtr<Material> mushroomMaterial_;
+    SharedPtr<Model> boxModel_;
+    SharedPtr<Material> boxMaterial_;
+
+    float chunkSize_;
+    float loadRadius_;
+    /// Extra distance, in chunks, before a loaded chunk is dropped, so chunks on the edge do not flicker.
+    float unloadMargin_;
+    unsigned attachBudgetUs_;
+    unsigned maxInFlight_;
+    ScatterCategory boxCategory_;
+    ScatterCategory mushroomCategory_;
+    unsigned seed_;
+    float mushroomDensity_;
+
+    unsigned numAttached_;
+    unsigned attachedThisFrame_;
+    unsigned unloadedThisFrame_;
+    long long attachUs_;
+};
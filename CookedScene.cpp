@@ -0,0 +1,498 @@
+#include "CookedScene.hpp"
+#include "InstancedPopulation.hpp"
+
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Graphics/Material.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/Graphics/StaticModel.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/IO/VectorBuffer.h>
+#include <Urho3D/Resource/ResourceCache.h>
+
+#include <cstring>
+#include <fstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char COOKED_MAGIC[4] = {'C', 'K', 'S', 'C'};
+
+struct CookedHeader {
+    char magic_[4];
+    unsigned version_;
+    unsigned numScenes_;
+    unsigned scenesOffset_;
+    unsigned numNodes_;
+    unsigned nodesOffset_;
+    unsigned numComponents_;
+    unsigned componentsOffset_;
+    unsigned blobOffset_;
+    unsigned blobSize_;
+    unsigned numStrings_;
+    unsigned stringsOffset_;
+};
+
+struct CookedSceneRecord {
+    unsigned firstNode_;
+    unsigned numNodes_;
+};
+
+struct CookedNodeRecord {
+    /// Index of the parent within the same scene, -1 for the scene itself.
+    int parent_;
+    unsigned id_;
+    unsigned name_;
+    unsigned enabled_;
+    float position_[3];
+    float rotation_[4];
+    float scale_[3];
+    unsigned firstComponent_;
+    unsigned numComponents_;
+};
+
+enum CookedComponentKind {
+    COOKED_GENERIC = 0,
+    COOKED_STATIC_MODEL,
+    COOKED_POPULATION
+};
+
+struct CookedComponentRecord {
+    unsigned type_;
+    unsigned id_;
+    unsigned kind_;
+    unsigned enabled_;
+    unsigned blobOffset_;
+    unsigned blobSize_;
+};
+
+/// Blob layout of the drawable kinds, followed by the material name indices and then the instances.
+struct CookedDrawableRecord {
+    unsigned model_;
+    unsigned numMaterials_;
+    unsigned castShadows_;
+    unsigned occluder_;
+    unsigned occludee_;
+    float drawDistance_;
+    float shadowDistance_;
+    float lodBias_;
+    unsigned viewMask_;
+    unsigned lightMask_;
+    unsigned shadowMask_;
+    unsigned zoneMask_;
+    float cellSize_;
+    unsigned numInstances_;
+};
+
+/// Whether count records of recordSize bytes from offset lie within size, 4-byte aligned. In 64 bits, so nothing wraps.
+bool FitsIn(unsigned size, unsigned offset, unsigned count, unsigned recordSize) {
+    return !(offset & 3) && (unsigned long long)offset + (unsigned long long)count * recordSize <= size;
+}
+
+class CookWriter {
+public:
+    void AddScene(Scene* scene) {
+        CookedSceneRecord record;
+        record.firstNode_ = nodes_.Size();
+        AddNode(scene, -1, record.firstNode_);
+        record.numNodes_ = nodes_.Size() - record.firstNode_;
+        scenes_.Push(record);
+    }
+
+    bool Write(const String& fileName) {
+        CookedHeader header;
+        memcpy(header.magic_, COOKED_MAGIC, sizeof(COOKED_MAGIC));
+        header.version_ = CookedScene::VERSION;
+        header.numScenes_ = scenes_.Size();
+        header.scenesOffset_ = sizeof(CookedHeader);
+        header.numNodes_ = nodes_.Size();
+        header.nodesOffset_ = header.scenesOffset_ + scenes_.Size() * sizeof(CookedSceneRecord);
+        header.numComponents_ = components_.Size();
+        header.componentsOffset_ = header.nodesOffset_ + nodes_.Size() * sizeof(CookedNodeRecord);
+        header.blobOffset_ = header.componentsOffset_ + components_.Size() * sizeof(CookedComponentRecord);
+        header.blobSize_ = blob_.GetSize();
+        header.numStrings_ = strings_.Size();
+        header.stringsOffset_ = header.blobOffset_ + header.blobSize_;
+
+        // String offsets are relative to the start of the string data that follows the offset table
+        PODVector<unsigned> stringOffsets;
+        VectorBuffer stringData;
+        for (const String& string : strings_)
+        {
+            stringOffsets.Push(stringData.GetSize());
+            stringData.Write(string.CString(), string.Length() + 1);
+        }
+
+        std::ofstream file(fileName.CString(), std::ios::binary);
+        if (!file)
+            return false;
+        WriteSection(file, &header, sizeof(header));
+        WriteSection(file, scenes_.Buffer(), scenes_.Size() * sizeof(CookedSceneRecord));
+        WriteSection(file, nodes_.Buffer(), nodes_.Size() * sizeof(CookedNodeRecord));
+        WriteSection(file, components_.Buffer(), components_.Size() * sizeof(CookedComponentRecord));
+        WriteSection(file, blob_.GetData(), blob_.GetSize());
+        WriteSection(file, stringOffsets.Buffer(), stringOffsets.Size() * sizeof(unsigned));
+        WriteSection(file, stringData.GetData(), stringData.GetSize());
+        return file.good();
+    }
+
+private:
+    static void WriteSection(std::ofstream& file, const void* data, unsigned size) {
+        if (size)
+            file.write(static_cast<const char*>(data), size);
+    }
+
+    unsigned AddString(const String& string) {
+        auto i = stringIndices_.Find(string);
+        if (i != stringIndices_.End())
+            return i->second_;
+        unsigned index = strings_.Size();
+        strings_.Push(string);
+        stringIndices_[string] = index;
+        return index;
+    }
+
+    void AddNode(Node* node, int parent, unsigned sceneFirstNode) {
+        unsigned index = nodes_.Size();
+        nodes_.Resize(index + 1);
+        {
+            CookedNodeRecord& record = nodes_[index];
+            record.parent_ = parent;
+            record.id_ = node->GetID();
+            record.name_ = AddString(node->GetName());
+            record.enabled_ = node->IsEnabledSelf() ? 1 : 0;
+            memcpy(record.position_, node->GetPosition().Data(), sizeof(record.position_));
+            memcpy(record.rotation_, node->GetRotation().Data(), sizeof(record.rotation_));
+            memcpy(record.scale_, node->GetScale().Data(), sizeof(record.scale_));
+            record.firstComponent_ = components_.Size();
+        }
+
+        for (Component* component : node->GetComponents())
+        {
+            if (!component->IsTemporary())
+                AddComponent(component);
+        }
+        nodes_[index].numComponents_ = components_.Size() - nodes_[index].firstComponent_;
+
+        for (Node* child : node->GetChildren())
+        {
+            if (!child->IsTemporary())
+                AddNode(child, index - sceneFirstNode, sceneFirstNode);
+        }
+    }
+
+    void AddComponent(Component* component) {
+        CookedComponentRecord record;
+        record.type_ = component->GetType().Value();
+        record.id_ = component->GetID();
+        record.enabled_ = component->IsEnabled() ? 1 : 0;
+        record.blobOffset_ = blob_.GetSize();
+
+        // Exact type checks, subclasses may carry state the plain records do not know about
+        StringHash type = component->GetType();
+        if (type == InstancedPopulation::GetTypeStatic())
+        {
+            record.kind_ = COOKED_POPULATION;
+            AddDrawable(static_cast<StaticModel*>(component));
+        }
+        else if (type == StaticModel::GetTypeStatic())
+        {
+            record.kind_ = COOKED_STATIC_MODEL;
+            AddDrawable(static_cast<StaticModel*>(component));
+        }
+        else
+        {
+            record.kind_ = COOKED_GENERIC;
+            component->Animatable::Save(blob_);
+        }
+
+        record.blobSize_ = blob_.GetSize() - record.blobOffset_;
+        // Keep every blob entry 4-byte aligned so records can be read in place
+        while (blob_.GetSize() & 3)
+            blob_.WriteUByte(0);
+        components_.Push(record);
+    }
+
+    void AddDrawable(StaticModel* model) {
+        auto* population = model->GetType() == InstancedPopulation::GetTypeStatic() ? static_cast<InstancedPopulation*>(model) : nullptr;
+
+        CookedDrawableRecord record;
+        record.model_ = AddString(model->GetModel() ? model->GetModel()->GetName() : String::EMPTY);
+        record.numMaterials_ = model->GetNumGeometries();
+        record.castShadows_ = model->GetCastShadows() ? 1 : 0;
+        record.occluder_ = model->IsOccluder() ? 1 : 0;
+        record.occludee_ = model->IsOccludee() ? 1 : 0;
+        record.drawDistance_ = model->GetDrawDistance();
+        record.shadowDistance_ = model->GetShadowDistance();
+        record.lodBias_ = model->GetLodBias();
+        record.viewMask_ = model->GetViewMask();
+        record.lightMask_ = model->GetLightMask();
+        record.shadowMask_ = model->GetShadowMask();
+        record.zoneMask_ = model->GetZoneMask();
+        record.cellSize_ = population ? population->GetCellSize() : 0.0f;
+        record.numInstances_ = population ? population->GetNumInstances() : 0;
+        blob_.Write(&record, sizeof(record));
+
+        for (unsigned i = 0; i < record.numMaterials_; ++i)
+        {
+            Material* material = model->GetMaterial(i);
+            blob_.WriteUInt(AddString(material ? material->GetName() : String::EMPTY));
+        }
+        if (record.numInstances_)
+            blob_.Write(population->GetInstanceTransforms().Buffer(), record.numInstances_ * sizeof(Matrix3x4));
+    }
+
+    PODVector<CookedSceneRecord> scenes_;
+    PODVector<CookedNodeRecord> nodes_;
+    PODVector<CookedComponentRecord> components_;
+    VectorBuffer blob_;
+    Vector<String> strings_;
+    HashMap<String, unsigned> stringIndices_;
+};
+
+}
+
+CookedScene::CookedScene()
+                :data_(nullptr),
+                size_(0),
+                mapped_(false)
+                {
+}
+
+CookedScene::~CookedScene() {
+    Close();
+}
+
+bool CookedScene::Cook(const PODVector<Scene*>& scenes, const String& fileName) {
+    CookWriter writer;
+    for (Scene* scene : scenes)
+        writer.AddScene(scene);
+    return writer.Write(fileName);
+}
+
+bool CookedScene::Open(const String& fileName) {
+    Close();
+
+#ifndef _WIN32
+    int fd = open(fileName.CString(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+    {
+        void* mapping = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED)
+        {
+            data_ = static_cast<const unsigned char*>(mapping);
+            size_ = (unsigned)info.st_size;
+            mapped_ = true;
+        }
+    }
+    close(fd);
+#else
+    std::ifstream file(fileName.CString(), std::ios::binary | std::ios::ate);
+    if (file)
+    {
+        size_ = (unsigned)file.tellg();
+        auto* buffer = new unsigned char[size_];
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(buffer), size_);
+        data_ = buffer;
+    }
+#endif
+    if (!data_)
+        return false;
+
+    const auto* header = GetRecords<CookedHeader>(0);
+    if (size_ < sizeof(CookedHeader) || memcmp(header->magic_, COOKED_MAGIC, sizeof(COOKED_MAGIC)) ||
+        header->version_ != VERSION)
+    {
+        URHO3D_LOGERRORF("%s is not a version %u cooked scene", fileName.CString(), VERSION);
+        Close();
+        return false;
+    }
+    // Instantiate reads records and indices as they are, so a truncated or stale file has to be turned away here
+    if (!Validate())
+    {
+        URHO3D_LOGERRORF("Cooked scene %s is truncated or corrupt", fileName.CString());
+        Close();
+        return false;
+    }
+    return true;
+}
+
+bool CookedScene::Validate() const {
+    const auto* header = GetRecords<CookedHeader>(0);
+    if (!FitsIn(size_, header->scenesOffset_, header->numScenes_, sizeof(CookedSceneRecord)) ||
+        !FitsIn(size_, header->nodesOffset_, header->numNodes_, sizeof(CookedNodeRecord)) ||
+        !FitsIn(size_, header->componentsOffset_, header->numComponents_, sizeof(CookedComponentRecord)) ||
+        !FitsIn(size_, header->blobOffset_, header->blobSize_, 1) ||
+        !FitsIn(size_, header->stringsOffset_, header->numStrings_, sizeof(unsigned)))
+        return false;
+
+    // Every string starts within the string data, which ends in a terminator
+    unsigned stringDataOffset = header->stringsOffset_ + header->numStrings_ * sizeof(unsigned);
+    unsigned stringDataSize = size_ - stringDataOffset;
+    if (header->numStrings_ && (!stringDataSize || data_[size_ - 1] != 0))
+        return false;
+    const unsigned* offsets = GetRecords<unsigned>(header->stringsOffset_);
+    for (unsigned i = 0; i < header->numStrings_; ++i)
+    {
+        if (offsets[i] >= stringDataSize)
+            return false;
+    }
+
+    const auto* scenes = GetRecords<CookedSceneRecord>(header->scenesOffset_);
+    for (unsigned i = 0; i < header->numScenes_; ++i)
+    {
+        if ((unsigned long long)scenes[i].firstNode_ + scenes[i].numNodes_ > header->numNodes_)
+            return false;
+        // Parents are indices within the scene and come before their children, the scene node has none
+        const CookedNodeRecord* nodes = GetRecords<CookedNodeRecord>(header->nodesOffset_) + scenes[i].firstNode_;
+        for (unsigned j = 0; j < scenes[i].numNodes_; ++j)
+        {
+            const CookedNodeRecord& node = nodes[j];
+            if ((j == 0) != (node.parent_ < 0) || (node.parent_ >= 0 && (unsigned)node.parent_ >= j) ||
+                node.name_ >= header->numStrings_ ||
+                (unsigned long long)node.firstComponent_ + node.numComponents_ > header->numComponents_)
+                return false;
+        }
+    }
+
+    const auto* components = GetRecords<CookedComponentRecord>(header->componentsOffset_);
+    for (unsigned i = 0; i < header->numComponents_; ++i)
+    {
+        const CookedComponentRecord& component = components[i];
+        if ((unsigned long long)component.blobOffset_ + component.blobSize_ > header->blobSize_)
+            return false;
+        if (component.kind_ == COOKED_GENERIC)
+            continue;
+        if (component.kind_ != COOKED_STATIC_MODEL && component.kind_ != COOKED_POPULATION)
+            return false;
+
+        // The drawable record, its material names and its instances all lie within the blob entry
+        if ((component.blobOffset_ & 3) || component.blobSize_ < sizeof(CookedDrawableRecord))
+            return false;
+        const unsigned char* blob = data_ + header->blobOffset_ + component.blobOffset_;
+        const auto* drawable = reinterpret_cast<const CookedDrawableRecord*>(blob);
+        unsigned long long needed = sizeof(CookedDrawableRecord) + (unsigned long long)drawable->numMaterials_ * sizeof(unsigned);
+        if (component.kind_ == COOKED_POPULATION)
+            needed += (unsigned long long)drawable->numInstances_ * sizeof(Matrix3x4);
+        if (needed > component.blobSize_ || drawable->model_ >= header->numStrings_)
+            return false;
+        const auto* materials = reinterpret_cast<const unsigned*>(drawable + 1);
+        for (unsigned j = 0; j < drawable->numMaterials_; ++j)
+        {
+            if (materials[j] >= header->numStrings_)
+                return false;
+        }
+    }
+    return true;
+}
+
+void CookedScene::Close() {
+    if (!data_)
+        return;
+#ifndef _WIN32
+    if (mapped_)
+        munmap(const_cast<unsigned char*>(data_), size_);
+    else
+#endif
+        delete[] data_;
+    data_ = nullptr;
+    size_ = 0;
+    mapped_ = false;
+}
+
+unsigned CookedScene::GetNumScenes() const {
+    return data_ ? GetRecords<CookedHeader>(0)->numScenes_ : 0;
+}
+
+const char* CookedScene::GetString(unsigned index) const {
+    const auto* header = GetRecords<CookedHeader>(0);
+    const unsigned* offsets = GetRecords<unsigned>(header->stringsOffset_);
+    return reinterpret_cast<const char*>(data_ + header->stringsOffset_ + header->numStrings_ * sizeof(unsigned) + offsets[index]);
+}
+
+bool CookedScene::Instantiate(unsigned index, Scene* scene) const {
+    // Every record was checked against the file in Open
+    if (index >= GetNumScenes())
+        return false;
+
+    const auto* header = GetRecords<CookedHeader>(0);
+    const CookedSceneRecord& sceneRecord = GetRecords<CookedSceneRecord>(header->scenesOffset_)[index];
+    const CookedNodeRecord* nodeRecords = GetRecords<CookedNodeRecord>(header->nodesOffset_) + sceneRecord.firstNode_;
+    const CookedComponentRecord* componentRecords = GetRecords<CookedComponentRecord>(header->componentsOffset_);
+    auto* cache = scene->GetSubsystem<ResourceCache>();
+
+    // Parents always come before their children, so one pass creates the whole hierarchy
+    PODVector<Node*> nodes(sceneRecord.numNodes_);
+    for (unsigned i = 0; i < sceneRecord.numNodes_; ++i)
+    {
+        const CookedNodeRecord& record = nodeRecords[i];
+        Node* node = scene;
+        if (record.parent_ >= 0)
+        {
+            CreateMode mode = record.id_ < FIRST_LOCAL_ID ? REPLICATED : LOCAL;
+            node = nodes[record.parent_]->CreateChild(GetString(record.name_), mode, record.id_);
+            node->SetTransform(Vector3(record.position_), Quaternion(record.rotation_), Vector3(record.scale_));
+        }
+        nodes[i] = node;
+
+        for (unsigned j = 0; j < record.numComponents_; ++j)
+        {
+            const CookedComponentRecord& componentRecord = componentRecords[record.firstComponent_ + j];
+            CreateMode mode = componentRecord.id_ < FIRST_LOCAL_ID ? REPLICATED : LOCAL;
+            Component* component = node->CreateComponent(StringHash(componentRecord.type_), mode, componentRecord.id_);
+            if (!component)
+                return false;
+
+            const unsigned char* blob = data_ + header->blobOffset_ + componentRecord.blobOffset_;
+            if (componentRecord.kind_ == COOKED_GENERIC)
+            {
+                MemoryBuffer buffer(blob, componentRecord.blobSize_);
+                if (!component->Load(buffer))
+                    return false;
+                component->ApplyAttributes();
+            }
+            else
+            {
+                const auto* drawable = reinterpret_cast<const CookedDrawableRecord*>(blob);
+                const auto* materials = reinterpret_cast<const unsigned*>(drawable + 1);
+                auto* model = static_cast<StaticModel*>(component);
+                model->SetModel(cache->GetResource<Model>(GetString(drawable->model_)));
+                for (unsigned k = 0; k < drawable->numMaterials_; ++k)
+                    model->SetMaterial(k, cache->GetResource<Material>(GetString(materials[k])));
+                model->SetCastShadows(drawable->castShadows_ != 0);
+                model->SetOccluder(drawable->occluder_ != 0);
+                model->SetOccludee(drawable->occludee_ != 0);
+                model->SetDrawDistance(drawable->drawDistance_);
+                model->SetShadowDistance(drawable->shadowDistance_);
+                model->SetLodBias(drawable->lodBias_);
+                model->SetViewMask(drawable->viewMask_);
+                model->SetLightMask(drawable->lightMask_);
+                model->SetShadowMask(drawable->shadowMask_);
+                model->SetZoneMask(drawable->zoneMask_);
+
+                if (componentRecord.kind_ == COOKED_POPULATION)
+                {
+                    auto* population = static_cast<InstancedPopulation*>(component);
+                    population->SetCellSize(drawable->cellSize_);
+                    // Straight from the mapping into the population, no per-instance work
+                    population->SetInstances(reinterpret_cast<const Matrix3x4*>(materials + drawable->numMaterials_),
+                                             drawable->numInstances_);
+                }
+            }
+            component->SetEnabled(componentRecord.enabled_ != 0);
+        }
+
+        node->SetEnabled(record.enabled_ != 0);
+    }
+    return true;
+}
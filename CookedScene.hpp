@@ -0,0 +1,65 @@
+#pragma once
+
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Scene/Scene.h>
+
+using namespace Urho3D;
+
+/**
+* Flat binary snapshot of built scenes that can be memory-mapped and turned
+* back into nodes and components without going through attribute parsing.
+*
+* The file is a header followed by fixed size records, all offsets from the
+* start of the file and 4-byte aligned:
+*
+*   scene table    first node and node count per scene
+*   nodes          parent index, id, name, enabled, transform, component range
+*   components     type hash, id, kind, blob range
+*   blob           per component payload
+*   strings        offset table, then null terminated names
+*
+* StaticModel and InstancedPopulation, which make up most of a scene, are
+* cooked to plain records: resource names, flags and, for populations, the
+* raw instance transforms which are copied straight out of the mapping.
+* Other components fall back to Urho3D's binary attribute layout in the blob.
+* Temporary nodes and components are not cooked.
+*/
+class CookedScene {
+public:
+    CookedScene();
+    ~CookedScene();
+
+    /// Write scenes to one cooked file, in order.
+    static bool Cook(const PODVector<Scene*>& scenes, const String& fileName);
+
+    /// Map a cooked file. Fails on a missing file, wrong magic or version, or any table, record or index that
+    /// does not fit the file.
+    bool Open(const String& fileName);
+
+    void Close();
+
+    /// Create the nodes and components of one cooked scene under an empty scene.
+    bool Instantiate(unsigned index, Scene* scene) const;
+
+    unsigned GetNumScenes() const;
+
+    unsigned GetSize() const { return size_; }
+
+    static const unsigned VERSION = 1;
+
+private:
+    /// Check every table range, record index and blob entry of the mapped file.
+    bool Validate() const;
+
+    const char* GetString(unsigned index) const;
+
+    template <class T> const T* GetRecords(unsigned offset) const {
+        return reinterpret_cast<const T*>(data_ + offset);
+    }
+
+    const unsigned char* data_;
+    unsigned size_;
+    /// True when data_ is a mapping rather than a heap copy.
+    bool mapped_;
+};
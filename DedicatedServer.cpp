@@ -0,0 +1,353 @@
+#include "DedicatedServer.hpp"
+#include "NetworkThread.hpp"
+#include "PoissonScatter.hpp"
+#include "Trace.hpp"
+
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Core/StringUtils.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Engine/Engine.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Math/Random.h>
+
+#include <cstdio>
+
+namespace {
+
+/// Clients on the ring stand this far outside the edge of the field, where the boxes end.
+const float CLIENT_RING_MARGIN = 5.0f;
+const float CLIENT_HEIGHT = 2.0f;
+/// Aimed slightly down, so most missiles end on a box or the ground within the field.
+const float CLIENT_PITCH = 3.0f;
+/// How far either side of the middle the aim sweeps, in degrees.
+const float CLIENT_SWEEP = 30.0f;
+const float HIT_ALERT_LIFETIME = 3.0f;
+/// The simulated clients' cameras.
+const float CLIENT_FOV = 60.0f;
+const float CLIENT_ASPECT_RATIO = 16.0f / 9.0f;
+
+}
+
+ServerOptions ServerOptions::Parse(const Vector<String>& arguments) {
+    ServerOptions options;
+    for (unsigned i = 0; i < arguments.Size(); ++i)
+    {
+        String argument = arguments[i].ToLower();
+        bool hasValue = i + 1 < arguments.Size() && !arguments[i + 1].StartsWith("-");
+
+        if (argument == "-server")
+            options.enabled_ = true;
+        else if (argument == "-clients" && hasValue)
+            options.numClients_ = ToUInt(arguments[++i]);
+        else if (argument == "-clientfirerate" && hasValue)
+            options.clientFireRate_ = ToFloat(arguments[++i]);
+        else if (argument == "-clientarea" && hasValue)
+            options.clientArea_ = ToFloat(arguments[++i]);
+        else if (argument == "-interest")
+            options.interest_ = true;
+        else if (argument == "-interestradius" && hasValue)
+            options.interestRadius_ = ToFloat(arguments[++i]);
+        else if (argument == "-clientbudget" && hasValue)
+            options.clientBudget_ = ToUInt(arguments[++i]);
+    }
+    return options;
+}
+
+DedicatedServer::DedicatedServer(Context* context)
+                :Object(context),
+                replication_(MissilePool::MISSILE_SPEED)
+                {
+}
+
+DedicatedServer::~DedicatedServer() {
+    if (!worldOptions_.trace_.Empty())
+    {
+        Trace::SetEnabled(false);
+        if (Trace::WriteChromeTrace(worldOptions_.trace_))
+            URHO3D_LOGINFOF("Trace written to %s", worldOptions_.trace_.CString());
+        else
+            URHO3D_LOGERRORF("Could not write trace to %s", worldOptions_.trace_.CString());
+    }
+}
+
+void DedicatedServer::Start(const WorldOptions& worldOptions, const ServerOptions& options) {
+    worldOptions_ = worldOptions;
+    options_ = options;
+
+    if (!worldOptions_.trace_.Empty())
+    {
+        Trace::SetThreadName("Main");
+        Trace::SetEnabled(true);
+    }
+    TraceScope trace("DedicatedServer::Start");
+
+    // The field World would build from the same config, read once
+    if (!worldOptions_.worldConfig_.Empty())
+        config_.Load(context_, worldOptions_.worldConfig_);
+
+    unsigned numWorkers = worldOptions_.threads_ ? worldOptions_.threads_ - 1 : JobSystem::GetDefaultNumWorkers();
+    jobSystem_ = std::make_unique<JobSystem>(numWorkers);
+    // Nothing is drawn, so no missile gets a node
+    missiles_ = std::make_unique<MissileSimulation>(nullptr);
+    alertBoard_ = new AlertBoard(context_, nullptr, nullptr);
+
+    SetRandomSeed(worldOptions_.seed_);
+    BuildCollisionGrid();
+
+    fixedStep_.SetTickRate(worldOptions_.tickRate_);
+    fixedStep_.SetMaxSteps(worldOptions_.maxCatchUpSteps_);
+
+    if (options_.interest_)
+    {
+        InterestSettings settings;
+        settings.radius_ = options_.interestRadius_;
+        settings.budgetBytes_ = options_.clientBudget_;
+        interest_ = std::make_unique<InterestManager>(MissilePool::MISSILE_SPEED, settings);
+    }
+
+    // Around the field, or on a jittered grid over the client area facing every which way.
+    // Each fires on its own phase so the commands do not all land on one tick
+    unsigned numClients = Max(options_.numClients_, 1u);
+    float firePeriod = 1.0f / Max(options_.clientFireRate_, M_EPSILON);
+    float ringRadius = GetClientRingRadius();
+    auto columns = (unsigned)CeilToInt(Sqrt((float)numClients));
+    float spacing = options_.clientArea_ / columns;
+    clients_.Resize(numClients);
+    for (unsigned i = 0; i < numClients; ++i)
+    {
+        SimulatedClient& client = clients_[i];
+        if (options_.clientArea_ > 0.0f)
+        {
+            float x = -options_.clientArea_ * 0.5f + ((i % columns) + Random(1.0f)) * spacing;
+            float z = -options_.clientArea_ * 0.5f + ((i / columns) + Random(1.0f)) * spacing;
+            client.position_ = Vector3(x, CLIENT_HEIGHT, z);
+            client.yaw_ = Random(360.0f);
+        }
+        else
+        {
+            float angle = 360.0f * i / numClients;
+            client.position_ = Vector3(Sin(angle) * ringRadius, CLIENT_HEIGHT, Cos(angle) * ringRadius);
+            client.yaw_ = angle + 180.0f;
+        }
+        client.aimYaw_ = client.yaw_;
+        client.fireTimer_ = firePeriod * i / numClients;
+        transport_.AddClient();
+        replication_.AddClient();
+        if (interest_)
+            interest_->AddClient();
+    }
+
+    URHO3D_LOGINFOF("Dedicated server running at %.0f Hz with %u simulated clients firing %.1f missiles per second each",
+                    fixedStep_.GetTickRate(), numClients, options_.clientFireRate_);
+}
+
+void DedicatedServer::SubscribeToEvents() {
+    // No vsync without a window, so keep the frame loop from spinning far faster than the tick
+    auto* engine = GetSubsystem<Engine>();
+    engine->SetMaxFps(CeilToInt(fixedStep_.GetTickRate()));
+    engine->SetMaxInactiveFps(CeilToInt(fixedStep_.GetTickRate()));
+
+    SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(DedicatedServer, HandleUpdate));
+}
+
+void DedicatedServer::BuildCollisionGrid() {
+    // Grown so missiles fired outward from the ring or the client area still land on something
+    BoundingBox ground = World::GetGroundBounds(config_);
+    float reach = options_.clientArea_ * 0.5f + GetClientRingRadius();
+    ground.Merge(Vector3(-reach, 0.0f, -reach));
+    ground.Merge(Vector3(reach, 0.0f, reach));
+
+    // The boxes World scatters for the same seed
+    PoissonScatter scatter;
+    World::ScatterField(scatter, config_, worldOptions_.seed_, jobSystem_.get());
+    const PODVector<ScatterPlacement>& placements = scatter.GetPlacements(FIELD_BOXES);
+    PODVector<BoundingBox> boxes(placements.Size());
+    for (unsigned i = 0; i < placements.Size(); ++i)
+        boxes[i] = World::GetFieldBoxBounds(placements[i]);
+
+    missiles_->BuildCollisionGrid(ground, boxes);
+}
+
+float DedicatedServer::GetClientRingRadius() const {
+    return config_.fieldSize_ * 0.5f + CLIENT_RING_MARGIN;
+}
+
+void DedicatedServer::HandleUpdate(StringHash eventType, VariantMap& eventData) {
+    using namespace Update;
+    float timeStep = eventData[P_TIMESTEP].GetFloat();
+
+    unsigned steps = fixedStep_.Advance(timeStep);
+    for (unsigned i = 0; i < steps; ++i)
+    {
+        Tick();
+        ++logTicks_;
+        logTickUs_ += timings_.tickUs_;
+        logClientsUs_ += timings_.clientsUs_;
+    }
+
+    logTime_ += timeStep;
+    if (logTime_ >= 1.0f && logTicks_)
+    {
+        unsigned long long bytesToClients = transport_.GetNumBytesToClients();
+        double serverUs = (double)(logTickUs_ - logClientsUs_) / logTicks_;
+        URHO3D_LOGINFOF("%u ticks in %.2f s, server %.3f ms per tick (%.2f us per client), clients %.3f ms, "
+                        "%u missiles, %.1f kbit/s per client",
+                        logTicks_, logTime_, serverUs / 1000.0, serverUs / clients_.Size(),
+                        (double)logClientsUs_ / logTicks_ / 1000.0, missiles_->GetPool().GetNumMissiles(),
+                        (bytesToClients - logBytesToClients_) * 8.0 / 1000.0 / logTime_ / clients_.Size());
+        logBytesToClients_ = bytesToClients;
+        logTicks_ = 0;
+        logTime_ = 0.0f;
+        logTickUs_ = 0;
+        logClientsUs_ = 0;
+    }
+}
+
+void DedicatedServer::Tick() {
+    TraceScope trace("DedicatedServer::Tick");
+    HiresTimer tickTimer;
+    HiresTimer sectionTimer;
+    float step = fixedStep_.GetStep();
+
+    // The clients see last tick's snapshot and fire before the server steps, as if they were a tick away
+    TraceScope section("DedicatedServer::Clients");
+    for (unsigned i = 0; i < clients_.Size(); ++i)
+        UpdateClient(i, step);
+    timings_.clientsUs_ = sectionTimer.GetUSec(true);
+    section.Next("DedicatedServer::Commands");
+
+    transport_.DrainServer([this](unsigned client, unsigned short type, const unsigned char* data, unsigned size) {
+        HandleServerMessage(client, type, data, size);
+    });
+    timings_.commandsUs_ = sectionTimer.GetUSec(true);
+    section.Next("DedicatedServer::Simulation");
+
+    // Alerts tick first, as in World
+    alertBoard_->Update(step);
+    missiles_->RunTicks(*jobSystem_, 1, step);
+    missiles_->SendHitEvent(this);
+
+    // Formatted into a fixed buffer and copied into a String that keeps its capacity
+    for (const MissileHit& hit : missiles_->GetHits())
+    {
+        char text[64];
+        snprintf(text, sizeof(text), "Missile hit %u at %.0f, %.0f", hit.target_, hit.position_.x_, hit.position_.z_);
+        alertText_ = text;
+        alertBoard_->Show(alertText_, HIT_ALERT_LIFETIME);
+    }
+    timings_.simulationUs_ = sectionTimer.GetUSec(true);
+    section.Next("DedicatedServer::Replication");
+
+    timeUs_ += step * 1e6;
+    snapshot_.timeUs_ = (unsigned)timeUs_;
+    missiles_->GetPool().CaptureSnapshot(snapshot_);
+    if (interest_)
+    {
+        interest_->Capture(snapshot_);
+        for (unsigned i = 0; i < clients_.Size(); ++i)
+        {
+            interest_->SetView(i, GetView(clients_[i]));
+            interest_->BuildPacket(i, packet_);
+            transport_.SendToClient(i, NET_MSG_SNAPSHOT, packet_.Buffer(), packet_.Size());
+        }
+    }
+    else
+    {
+        replication_.Capture(snapshot_);
+        for (unsigned i = 0; i < clients_.Size(); ++i)
+        {
+            replication_.BuildPacket(i, packet_);
+            transport_.SendToClient(i, NET_MSG_SNAPSHOT, packet_.Buffer(), packet_.Size());
+        }
+    }
+    timings_.replicationUs_ = sectionTimer.GetUSec(true);
+    timings_.tickUs_ = tickTimer.GetUSec(false);
+}
+
+void DedicatedServer::UpdateClient(unsigned index, float timeStep) {
+    transport_.DrainClient(index, [this](unsigned client, unsigned short type, const unsigned char* data, unsigned size) {
+        HandleClientMessage(client, type, data, size);
+    });
+
+    SimulatedClient& client = clients_[index];
+    client.fireTimer_ -= timeStep;
+    if (client.fireTimer_ > 0.0f)
+        return;
+    client.fireTimer_ += 1.0f / Max(options_.clientFireRate_, M_EPSILON);
+
+    // Sweep the aim back and forth across the field, each client on its own phase
+    float sweep = CLIENT_SWEEP * Sin((float)(timeUs_ * 1e-6) * 20.0f + index * 37.0f);
+    client.aimYaw_ = client.yaw_ + sweep;
+    Vector3 direction = Quaternion(CLIENT_PITCH, client.aimYaw_, 0.0f) * Vector3::FORWARD;
+
+    // Quantized the way snapshots quantize missiles
+    EntityState fire = SnapshotCodec::MakeState(0, client.position_, direction);
+    packet_.Clear();
+    BitWriter writer(packet_);
+    for (unsigned a = 0; a < 3; ++a)
+        writer.Write((unsigned)fire.position_[a], SnapshotCodec::POSITION_BITS);
+    writer.Write(fire.direction_, SnapshotCodec::DIRECTION_BITS * 2);
+    transport_.SendToServer(index, NET_MSG_FIRE, packet_.Buffer(), packet_.Size());
+}
+
+InterestView DedicatedServer::GetView(const SimulatedClient& client) const {
+    InterestView view;
+    view.position_ = client.position_;
+    view.frustum_.Define(CLIENT_FOV, CLIENT_ASPECT_RATIO, 1.0f, 0.1f, options_.interestRadius_,
+                         Matrix3x4(client.position_, Quaternion(CLIENT_PITCH, client.aimYaw_, 0.0f), 1.0f));
+    view.hasFrustum_ = true;
+    return view;
+}
+
+void DedicatedServer::HandleClientMessage(unsigned client, unsigned short type, const unsigned char* data, unsigned size) {
+    if (type != NET_MSG_SNAPSHOT)
+        return;
+
+    unsigned ack;
+    if (!clients_[client].replication_.Receive(data, size, ack))
+    {
+        ++numDecodeFailures_;
+        return;
+    }
+
+    packet_.Clear();
+    BitWriter writer(packet_);
+    writer.Write(ack, 32);
+    transport_.SendToServer(client, NET_MSG_ACK, packet_.Buffer(), packet_.Size());
+}
+
+void DedicatedServer::HandleServerMessage(unsigned client, unsigned short type, const unsigned char* data, unsigned size) {
+    BitReader reader(data, size);
+    switch (type)
+    {
+    case NET_MSG_FIRE:
+    {
+        Vector3 position;
+        position.x_ = SnapshotCodec::DequantizePosition((int)reader.Read(SnapshotCodec::POSITION_BITS));
+        position.y_ = SnapshotCodec::DequantizePosition((int)reader.Read(SnapshotCodec::POSITION_BITS));
+        position.z_ = SnapshotCodec::DequantizePosition((int)reader.Read(SnapshotCodec::POSITION_BITS));
+        Vector3 direction = SnapshotCodec::DecodeDirection(reader.Read(SnapshotCodec::DIRECTION_BITS * 2));
+        if (reader.IsOverrun())
+            break;
+        missiles_->GetPool().CreateMissile(position, direction);
+        ++numCommands_;
+        break;
+    }
+
+    case NET_MSG_ACK:
+    {
+        unsigned sequence = reader.Read(32);
+        if (reader.IsOverrun())
+            break;
+        if (interest_)
+            interest_->Acknowledge(client, sequence);
+        else
+            replication_.Acknowledge(client, sequence);
+        break;
+    }
+
+    default:
+        URHO3D_LOGDEBUGF("Ignoring message of type %u from simulated client %u", type, client);
+        break;
+    }
+}
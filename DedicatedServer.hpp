@@ -0,0 +1,176 @@
+#pragma once
+
+#include <memory>
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Container/Str.h>
+
+#include "AlertBoard.hpp"
+#include "FixedTimestep.hpp"
+#include "InterestManager.hpp"
+#include "JobSystem.hpp"
+#include "LoopbackTransport.hpp"
+#include "MissileSimulation.hpp"
+#include "Snapshot.hpp"
+#include "World.hpp"
+
+using namespace Urho3D;
+
+/// Options of the dedicated server, parsed from the command line.
+struct ServerOptions {
+
+    static ServerOptions Parse(const Vector<String>& arguments);
+
+    /// -server, run the simulation headless for simulated clients instead of starting World.
+    bool enabled_ = false;
+    /// -clients N, simulated clients connected over the loopback transport.
+    unsigned numClients_ = 8;
+    /// -clientfirerate HZ, missiles each simulated client fires per second.
+    float clientFireRate_ = 4.0f;
+    /// -clientarea SIZE, spread the clients over a SIZE x SIZE square instead of a ring around the field.
+    float clientArea_ = 0.0f;
+    /// -interest, send each client only the missiles it can see, see InterestManager.
+    bool interest_ = false;
+    /// -interestradius R, how far clients see.
+    float interestRadius_ = 150.0f;
+    /// -clientbudget BYTES, most snapshot bytes per client per tick with -interest.
+    unsigned clientBudget_ = 1200;
+};
+
+/// Time spent in each part of the last DedicatedServer tick, in microseconds.
+struct ServerTickTimings {
+    /// The simulated clients decoding snapshots, acknowledging them and firing.
+    long long clientsUs_ = 0;
+    /// The server taking in the clients' fire commands and acks.
+    long long commandsUs_ = 0;
+    /// Missile step, hits and alerts.
+    long long simulationUs_ = 0;
+    /// Capturing the snapshot and building a delta packet for every client.
+    long long replicationUs_ = 0;
+    /// The whole tick, clients included.
+    long long tickUs_ = 0;
+};
+
+/**
+* World's simulation without a display: the same MissileSimulation, with the
+* fixed field's boxes put straight into its collision grid, missiles without
+* scene nodes and alerts without windows, so nothing of the renderer or the UI
+* is needed. Gameplay runs at the fixed tick rate of WorldOptions, on the job
+* system like World does.
+*
+* Load comes from simulated clients in the same process, standing on a ring
+* around the field and firing at it, or spread over a wider area. Clients send their fire commands
+* over a LoopbackTransport, the server answers every tick with a delta
+* snapshot per client, which the client decodes and acknowledges, so the
+* per-client cost covers the same replication work a remote client would
+* cause. The clients' own work is timed apart from the server's.
+*
+* With interest management each client is only sent what its camera can see,
+* within a byte budget. The server takes the cameras from the simulated
+* clients directly, where a real one would have them reported with the
+* clients' input.
+*/
+class DedicatedServer : public Object {
+
+    URHO3D_OBJECT(DedicatedServer, Object);
+
+public:
+    explicit DedicatedServer(Context* context);
+
+    ~DedicatedServer();
+
+    /// Build the field and connect the simulated clients. Ticks are only run by Tick until SubscribeToEvents.
+    void Start(const WorldOptions& worldOptions, const ServerOptions& options);
+
+    /// Run the fixed ticks every engine frame and log the tick cost once a second.
+    void SubscribeToEvents();
+
+    /// One fixed tick: clients, commands, simulation, then snapshots.
+    void Tick();
+
+    unsigned GetNumClients() const { return clients_.Size(); }
+
+    unsigned GetNumMissiles() const { return missiles_->GetPool().GetNumMissiles(); }
+
+    /// Missiles that hit a box or the ground in the last tick.
+    unsigned GetNumMissileHits() const { return missiles_->GetHits().Size(); }
+
+    /// Fire commands the server has taken in since Start.
+    unsigned long long GetNumCommands() const { return numCommands_; }
+
+    /// Snapshots the clients failed to decode, 0 unless replication is broken.
+    unsigned GetNumDecodeFailures() const { return numDecodeFailures_; }
+
+    const ServerTickTimings& GetTickTimings() const { return timings_; }
+
+    const FixedTimestep& GetFixedTimestep() const { return fixedStep_; }
+
+    const LoopbackTransport& GetTransport() const { return transport_; }
+
+    /// Null unless the server was started with interest_.
+    const InterestManager* GetInterestManager() const { return interest_.get(); }
+
+    AlertBoard* GetAlertBoard() const { return alertBoard_; }
+
+    void HandleUpdate(StringHash eventType, VariantMap& eventData);
+
+private:
+    struct SimulatedClient {
+        explicit SimulatedClient(float speed = MissilePool::MISSILE_SPEED) : replication_(speed) {}
+
+        ReplicationClient replication_;
+        Vector3 position_;
+        /// Yaw towards the middle of the field, or anywhere when spread out. The aim sweeps around it.
+        float yaw_ = 0.0f;
+        /// Yaw of the last shot, where the camera looks.
+        float aimYaw_ = 0.0f;
+        /// Seconds until the next missile.
+        float fireTimer_ = 0.0f;
+    };
+
+    /// Put World's ground, grown to where the clients stand, and the boxes of the field into the collision grid.
+    void BuildCollisionGrid();
+
+    /// How far from the middle of the field the clients stand when on a ring.
+    float GetClientRingRadius() const;
+
+    void UpdateClient(unsigned index, float timeStep);
+
+    InterestView GetView(const SimulatedClient& client) const;
+
+    void HandleClientMessage(unsigned client, unsigned short type, const unsigned char* data, unsigned size);
+
+    void HandleServerMessage(unsigned client, unsigned short type, const unsigned char* data, unsigned size);
+
+    WorldOptions worldOptions_;
+    ServerOptions options_;
+    WorldConfig config_;
+
+    FixedTimestep fixedStep_;
+    std::unique_ptr<JobSystem> jobSystem_;
+
+    std::unique_ptr<MissileSimulation> missiles_;
+    SharedPtr<AlertBoard> alertBoard_;
+    /// Reused for the alert raised per hit.
+    String alertText_;
+
+    LoopbackTransport transport_;
+    ReplicationServer replication_;
+    std::unique_ptr<InterestManager> interest_;
+    Vector<SimulatedClient> clients_;
+    Snapshot snapshot_;
+    /// Reused for every datagram built in a tick.
+    PODVector<unsigned char> packet_;
+    double timeUs_ = 0.0;
+
+    ServerTickTimings timings_;
+    unsigned long long numCommands_ = 0;
+    unsigned numDecodeFailures_ = 0;
+
+    // Once a second log
+    unsigned logTicks_ = 0;
+    float logTime_ = 0.0f;
+    long long logTickUs_ = 0;
+    long long logClientsUs_ = 0;
+    unsigned long long logBytesToClients_ = 0;
+};
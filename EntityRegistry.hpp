@@ -0,0 +1,169 @@
+#pragma once
+
+#include <tuple>
+
+#include <Urho3D/Container/Vector.h>
+
+namespace Urho3D {
+class Camera;
+class Light;
+class Node;
+class StaticModel;
+class Zone;
+}
+
+class InstancedPopulation;
+class SoaParticleEmitter;
+
+using namespace Urho3D;
+
+/// An object in a HandlePool: the slot it is in and the generation of that slot it was added in. Null by default.
+template <class T>
+struct Handle {
+    unsigned index_ = 0;
+    unsigned generation_ = 0;
+
+    bool IsNull() const { return generation_ == 0; }
+
+    bool operator ==(const Handle& rhs) const { return index_ == rhs.index_ && generation_ == rhs.generation_; }
+
+    bool operator !=(const Handle& rhs) const { return !(*this == rhs); }
+};
+
+/**
+* Generational slot map of objects of one type. Resolving a handle is a bounds
+* check, a generation compare and two loads. Removing an object bumps the
+* generation of its slot, so its handles resolve to null from then on, also
+* after the slot is reused for another object.
+*
+* The objects are kept packed in one array, in no particular order, for
+* iterating over all of them. Removal moves the last object into the hole.
+* Objects are not owned, remove them or clear the pool before they are destroyed.
+*/
+template <class T>
+class HandlePool {
+public:
+    Handle<T> Add(T* object) {
+        unsigned index;
+        if (freeSlot_ != NO_SLOT)
+        {
+            index = freeSlot_;
+            freeSlot_ = slots_[index].dense_;
+            slots_[index].generation_ += 1;
+        }
+        else
+        {
+            index = slots_.Size();
+            Slot slot = {1, 0};
+            slots_.Push(slot);
+        }
+
+        Slot& slot = slots_[index];
+        slot.dense_ = objects_.Size();
+        objects_.Push(object);
+        denseSlots_.Push(index);
+
+        Handle<T> handle;
+        handle.index_ = index;
+        handle.generation_ = slot.generation_;
+        return handle;
+    }
+
+    /// False if the handle was already stale.
+    bool Remove(Handle<T> handle) {
+        if (!IsValid(handle))
+            return false;
+
+        unsigned dense = slots_[handle.index_].dense_;
+        unsigned last = objects_.Size() - 1;
+        objects_[dense] = objects_[last];
+        denseSlots_[dense] = denseSlots_[last];
+        slots_[denseSlots_[dense]].dense_ = dense;
+        objects_.Pop();
+        denseSlots_.Pop();
+        Release(handle.index_);
+        return true;
+    }
+
+    /// Remove every object, all handles go stale.
+    void Clear() {
+        for (unsigned index : denseSlots_)
+            Release(index);
+        objects_.Clear();
+        denseSlots_.Clear();
+    }
+
+    bool IsValid(Handle<T> handle) const {
+        // Live generations are odd, which also turns away null handles and a slot that is free
+        return (handle.generation_ & 1) && handle.index_ < slots_.Size() && slots_[handle.index_].generation_ == handle.generation_;
+    }
+
+    /// Null if the handle is null or stale.
+    T* Get(Handle<T> handle) const { return IsValid(handle) ? objects_[slots_[handle.index_].dense_] : nullptr; }
+
+    /// Every object in the pool, packed.
+    const PODVector<T*>& GetObjects() const { return objects_; }
+
+    unsigned Size() const { return objects_.Size(); }
+
+private:
+    static const unsigned NO_SLOT = 0xffffffff;
+
+    struct Slot {
+        /// Odd while the slot holds an object, even while it is free.
+        unsigned generation_;
+        /// Position in objects_, or the next free slot while free.
+        unsigned dense_;
+    };
+
+    void Release(unsigned index) {
+        Slot& slot = slots_[index];
+        slot.generation_ += 1;
+        slot.dense_ = freeSlot_;
+        freeSlot_ = index;
+    }
+
+    PODVector<Slot> slots_;
+    PODVector<T*> objects_;
+    /// Slot of each object, to fix up the slot of the object moved on removal.
+    PODVector<unsigned> denseSlots_;
+    unsigned freeSlot_ = NO_SLOT;
+};
+
+/**
+* Handles to the nodes and components World works with once its scene is
+* built, one HandlePool per type. They are found by name once, after building
+* or loading the scene, and resolved by handle from then on: Node::GetChild
+* hashes the name and scans the node's children on every call.
+*/
+class EntityRegistry {
+public:
+    template <class T> Handle<T> Add(T* object) { return GetPool<T>().Add(object); }
+
+    template <class T> bool Remove(Handle<T> handle) { return GetPool<T>().Remove(handle); }
+
+    /// Null if the handle is null or stale.
+    template <class T> T* Get(Handle<T> handle) const { return GetPool<T>().Get(handle); }
+
+    /// Every registered object of type T, packed for iteration.
+    template <class T> const PODVector<T*>& GetView() const { return GetPool<T>().GetObjects(); }
+
+    template <class T> HandlePool<T>& GetPool() { return std::get<HandlePool<T> >(pools_); }
+
+    template <class T> const HandlePool<T>& GetPool() const { return std::get<HandlePool<T> >(pools_); }
+
+    /// Remove everything, for a scene that is cleared or rebuilt.
+    void Clear() {
+        GetPool<Node>().Clear();
+        GetPool<Camera>().Clear();
+        GetPool<Light>().Clear();
+        GetPool<Zone>().Clear();
+        GetPool<StaticModel>().Clear();
+        GetPool<InstancedPopulation>().Clear();
+        GetPool<SoaParticleEmitter>().Clear();
+    }
+
+private:
+    std::tuple<HandlePool<Node>, HandlePool<Camera>, HandlePool<Light>, HandlePool<Zone>, HandlePool<StaticModel>,
+               HandlePool<InstancedPopulation>, HandlePool<SoaParticleEmitter> > pools_;
+};
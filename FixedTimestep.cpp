@@ -0,0 +1,47 @@
+#include "FixedTimestep.hpp"
+
+#include <Urho3D/Math/MathDefs.h>
+
+using namespace Urho3D;
+
+FixedTimestep::FixedTimestep(float tickRate, unsigned maxSteps)
+                :step_(1.0f / 60.0f),
+                maxSteps_(1),
+                accumulator_(0.0),
+                tick_(0),
+                stepsThisFrame_(0),
+                droppedTime_(0.0)
+                {
+    SetTickRate(tickRate);
+    SetMaxSteps(maxSteps);
+}
+
+void FixedTimestep::SetTickRate(float tickRate) {
+    step_ = 1.0f / Clamp(tickRate, 1.0f, 1000.0f);
+    accumulator_ = Min(accumulator_, (double)step_);
+}
+
+void FixedTimestep::SetMaxSteps(unsigned maxSteps) {
+    maxSteps_ = Max(maxSteps, 1u);
+}
+
+unsigned FixedTimestep::Advance(float frameTime) {
+    accumulator_ += Max(frameTime, 0.0f);
+
+    auto steps = (unsigned)(accumulator_ / step_);
+    if (steps > maxSteps_)
+    {
+        // Keep the fraction so interpolation stays smooth, drop whole ticks we cannot afford
+        double excess = (steps - maxSteps_) * (double)step_;
+        droppedTime_ += excess;
+        accumulator_ -= excess;
+        steps = maxSteps_;
+    }
+    accumulator_ -= steps * (double)step_;
+    // Guard against rounding leaving a hair under zero or a full step
+    accumulator_ = Clamp(accumulator_, 0.0, (double)step_);
+
+    tick_ += steps;
+    stepsThisFrame_ = steps;
+    return steps;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+/**
+* Turns variable frame times into a whole number of fixed simulation ticks.
+* Frame time is accumulated and spent one tick at a time; what is left over
+* becomes the interpolation factor between the previous and the current tick,
+* so rendering can blend the two states instead of showing the simulation
+* snapping from tick to tick.
+*
+* At most maxSteps ticks run per frame. When a frame falls further behind than
+* that the excess time is dropped, so a slow frame slows the simulation down
+* instead of making the next frame even slower.
+*/
+class FixedTimestep {
+public:
+    explicit FixedTimestep(float tickRate = 60.0f, unsigned maxSteps = 5);
+
+    void SetTickRate(float tickRate);
+
+    void SetMaxSteps(unsigned maxSteps);
+
+    /// Add a frame's time and return how many ticks to run for it.
+    unsigned Advance(float frameTime);
+
+    /// Seconds per tick.
+    float GetStep() const { return step_; }
+
+    float GetTickRate() const { return 1.0f / step_; }
+
+    unsigned GetMaxSteps() const { return maxSteps_; }
+
+    /// How far rendering is between the last two ticks, 0 to 1.
+    float GetAlpha() const { return (float)(accumulator_ / step_); }
+
+    /// Seconds the rendered state lags behind the last tick.
+    float GetLag() const { return step_ - (float)accumulator_; }
+
+    /// Ticks run since construction.
+    unsigned long long GetTick() const { return tick_; }
+
+    unsigned GetStepsThisFrame() const { return stepsThisFrame_; }
+
+    /// Seconds thrown away because a frame needed more than maxSteps ticks.
+    double GetDroppedTime() const { return droppedTime_; }
+
+private:
+    float step_;
+    unsigned maxSteps_;
+    double accumulator_;
+    unsigned long long tick_;
+    unsigned stepsThisFrame_;
+    double droppedTime_;
+};
@@ -0,0 +1,67 @@
+#include "FrameArena.hpp"
+
+#include <cstdint>
+
+FrameArena::FrameArena(unsigned blockSize)
+                :blockSize_(Max(blockSize, 256u)),
+                offset_(0),
+                used_(0),
+                peak_(0),
+                capacity_(0),
+                numBlocksAllocated_(0)
+                {
+    AddBlock(blockSize_);
+}
+
+FrameArena::~FrameArena() {
+    FreeBlocks();
+}
+
+void* FrameArena::Allocate(unsigned size, unsigned alignment) {
+    const Block* block = &blocks_.Back();
+    auto base = (uintptr_t)block->data_;
+    uintptr_t start = (base + offset_ + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    if (start - base + size > block->size_)
+    {
+        // Big enough for this allocation whatever the alignment of the new block
+        AddBlock(Max(blockSize_, size + alignment));
+        block = &blocks_.Back();
+        base = (uintptr_t)block->data_;
+        start = (base + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    }
+
+    unsigned end = (unsigned)(start - base) + size;
+    used_ += end - offset_;
+    peak_ = Max(peak_, used_);
+    offset_ = end;
+    return (void*)start;
+}
+
+void FrameArena::Reset() {
+    // The frame did not fit in one block, so the next one gets a block it fits in
+    if (blocks_.Size() > 1)
+    {
+        unsigned size = capacity_;
+        FreeBlocks();
+        AddBlock(size);
+    }
+    offset_ = 0;
+    used_ = 0;
+}
+
+void FrameArena::AddBlock(unsigned size) {
+    Block block;
+    block.data_ = new unsigned char[size];
+    block.size_ = size;
+    blocks_.Push(block);
+    offset_ = 0;
+    capacity_ += size;
+    ++numBlocksAllocated_;
+}
+
+void FrameArena::FreeBlocks() {
+    for (const Block& block : blocks_)
+        delete[] block.data_;
+    blocks_.Clear();
+    capacity_ = 0;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <type_traits>
+
+#include <Urho3D/Container/Vector.h>
+
+using namespace Urho3D;
+
+/**
+* Linear allocator for data that lives for one frame. Allocating bumps an
+* offset, nothing is freed on its own and Reset at the end of the frame drops
+* everything at once. Destructors never run, so only trivially destructible
+* types go in.
+*
+* Memory comes in blocks. A frame that outgrows the current block gets
+* another one, and the next Reset swaps them all for a single block big
+* enough for that frame, so a steady workload stops allocating after its
+* biggest frame. Not thread safe, it belongs to the main thread.
+*/
+class FrameArena {
+public:
+    explicit FrameArena(unsigned blockSize = 64 * 1024);
+
+    ~FrameArena();
+
+    /// Uninitialized memory that stays valid until the next Reset. alignment must be a power of two.
+    void* Allocate(unsigned size, unsigned alignment = 16);
+
+    /// Uninitialized array of count T.
+    template <class T> T* Allocate(unsigned count) {
+        static_assert(std::is_trivially_destructible<T>::value, "FrameArena never runs destructors");
+        return static_cast<T*>(Allocate(count * sizeof(T), alignof(T)));
+    }
+
+    /// Drop everything allocated since the last Reset, usually at the end of the frame.
+    void Reset();
+
+    /// Bytes handed out since the last Reset, alignment padding included.
+    unsigned GetUsed() const { return used_; }
+
+    /// Most bytes used in one frame.
+    unsigned GetPeak() const { return peak_; }
+
+    unsigned GetCapacity() const { return capacity_; }
+
+    /// Blocks taken from the heap since construction.
+    unsigned GetNumBlocksAllocated() const { return numBlocksAllocated_; }
+
+    FrameArena(const FrameArena&) = delete;
+
+    FrameArena& operator =(const FrameArena&) = delete;
+
+private:
+    struct Block {
+        unsigned char* data_;
+        unsigned size_;
+    };
+
+    void AddBlock(unsigned size);
+
+    void FreeBlocks();
+
+    unsigned blockSize_;
+    PODVector<Block> blocks_;
+    /// Bytes taken from the last block.
+    unsigned offset_;
+    unsigned used_;
+    unsigned peak_;
+    unsigned capacity_;
+    unsigned numBlocksAllocated_;
+};
@@ -3,6 +3,8 @@
 #include "Game.h"
 #include <Urho3D/Graphics/RenderPath.h>
 #include <Urho3D/Scene/ValueAnimation.h>
+#include <Urho3D/Core/ProcessUtils.h>
+#include <Urho3D/Core/StringUtils.h>
 
 
 
@@ -31,17 +33,80 @@ void Game::Setup()
     engineParameters_["WindowWidth"] = 1920;
     engineParameters_["WindowHeight"] = 1080;
     engineParameters_["WindowResizable"] = true;
+
+    // -port N to listen on, -connect HOST:PORT to talk to a peer
+    const Vector<String>& arguments = GetArguments();
+    for (unsigned i = 0; i + 1 < arguments.Size(); ++i)
+    {
+        if (arguments[i].ToLower() == "-port")
+            networkPort_ = (unsigned short)ToUInt(arguments[i + 1]);
+        else if (arguments[i].ToLower() == "-connect")
+        {
+            Vector<String> address = arguments[i + 1].Split(':');
+            if (address.Size() == 2)
+            {
+                remoteHost_ = address[0].CString();
+                remotePort_ = (unsigned short)ToUInt(address[1]);
+            }
+        }
+    }
+
+    worldOptions_ = WorldOptions::Parse(GetArguments());
+    benchmarkSettings_ = BenchmarkSettings::Parse(GetArguments());
+    if (benchmarkSettings_.enabled_ && benchmarkSettings_.scenario_ == "streaming")
+        worldOptions_.stream_ = true;
+    // A benchmark run needs no display unless asked for one, so it can gate regressions on a GPU-less box
+    if (benchmarkSettings_.enabled_ && benchmarkSettings_.headless_)
+        engineParameters_["Headless"] = true;
+    // A plain replay is for measuring and checking, not for watching
+    if (!benchmarkSettings_.enabled_ && !worldOptions_.replay_.Empty())
+        engineParameters_["Headless"] = true;
+
+    // The dedicated server has nothing to draw; benchmarks start their own servers
+    serverOptions_ = ServerOptions::Parse(GetArguments());
+    if (benchmarkSettings_.enabled_)
+        serverOptions_.enabled_ = false;
+    if (serverOptions_.enabled_)
+        engineParameters_["Headless"] = true;
 }
 
 void Game::Start()
 {
 
 
-    // Create MainMenu scene, start the scene and set it to be the current viewport
-    world_ = std::make_unique<World>(context_);
-    world_->start();
-
-    GetSubsystem<Input>()->SetMouseVisible(true);
+    // Custom components have to be known to the context before any scene creates them
+    InstancedPopulation::RegisterObject(context_);
+    SoaParticleEmitter::RegisterObject(context_);
+
+    if (serverOptions_.enabled_)
+    {
+        // Simulation only, no scene, UI, cameras or lights
+        server_ = new DedicatedServer(context_);
+        server_->Start(worldOptions_, serverOptions_);
+        server_->SubscribeToEvents();
+    }
+    else
+    {
+        // Create MainMenu scene, start the scene and set it to be the current viewport
+        world_ = std::make_unique<World>(context_);
+        world_->start(worldOptions_);
+
+        GetSubsystem<Input>()->SetMouseVisible(true);
+    }
+
+    if (benchmarkSettings_.enabled_)
+    {
+        benchmark_ = std::make_unique<Benchmark>(context_, *world_, benchmarkSettings_);
+        benchmark_->start();
+    }
+
+    network_ = std::make_unique<NetworkThread>();
+    if (network_->Start(networkPort_))
+        URHO3D_LOGINFOF("Listening on UDP port %u", network_->GetLocalPort());
+    else
+        URHO3D_LOGERRORF("Could not open UDP port %u", networkPort_);
+    if (!remoteHost_.empty())
+        network_->SetRemote(remoteHost_, remotePort_);
 
     // Setup logic update callback to handle networking
     SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(Game, HandleUpdate));
@@ -51,11 +116,28 @@ void Game::Start()
 
 void Game::Stop()
 {
+    // Joins the network thread
+    network_.reset();
+    // Writes the server's trace, if any
+    server_.Reset();
 }
 
 
 void Game::HandleUpdate(StringHash eventType, VariantMap& eventData)
 {
 
-    io_context_.poll();
+    network_->Drain([this](const NetMessage& message) { HandleNetMessage(message); });
+}
+
+void Game::HandleNetMessage(const NetMessage& message)
+{
+    switch (message.type_)
+    {
+    case NET_MSG_PING:
+        break;
+
+    default:
+        URHO3D_LOGDEBUGF("Ignoring network message of type %u", message.type_);
+        break;
+    }
 }
@@ -54,7 +54,9 @@
 
 #include <memory>
 
-#include "../ObjectHandlers/MissileController.hpp"
+#include "Benchmark.hpp"
+#include "DedicatedServer.hpp"
+#include "NetworkThread.hpp"
 
 
 
@@ -80,8 +82,24 @@ class Game : public Application
 
      void HandleUpdate(StringHash eventType, VariantMap &eventData);
 
+     void HandleNetMessage(const NetMessage& message);
+
 
   private:
 
     std::unique_ptr<World> world_;
+    WorldOptions worldOptions_;
+
+    // Runs instead of world_ with -server
+    SharedPtr<DedicatedServer> server_;
+    ServerOptions serverOptions_;
+
+    // Networking runs on its own thread, decoded messages are drained once per frame
+    std::unique_ptr<NetworkThread> network_;
+    unsigned short networkPort_ = 0;
+    std::string remoteHost_;
+    unsigned short remotePort_ = 0;
+
+    BenchmarkSettings benchmarkSettings_;
+    std::unique_ptr<Benchmark> benchmark_;
 };
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+
+namespace Urho3D
+{
+
+/// Missiles that hit world geometry this frame, sent once per frame by World when there were any.
+URHO3D_EVENT(E_MISSILEHITS, MissileHits)
+{
+    URHO3D_PARAM(P_HITS, Hits);                 // const PODVector<MissileHit>* as void pointer
+    URHO3D_PARAM(P_NUMHITS, NumHits);           // unsigned
+}
+
+/// A resource in a ResourcePreloader manifest finished loading.
+URHO3D_EVENT(E_PRELOADPROGRESS, PreloadProgress)
+{
+    URHO3D_PARAM(P_FINISHED, Finished);         // unsigned
+    URHO3D_PARAM(P_TOTAL, Total);               // unsigned
+}
+
+/// Every resource in a ResourcePreloader manifest is resident.
+URHO3D_EVENT(E_PRELOADFINISHED, PreloadFinished)
+{
+    URHO3D_PARAM(P_FAILED, Failed);             // unsigned
+}
+
+}
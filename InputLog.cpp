@@ -0,0 +1,119 @@
+#include "InputLog.hpp"
+
+namespace {
+
+const char* MAGIC = "INPL";
+
+/// Flags byte of the end marker, frames never set the top bits.
+const unsigned char END_MARKER = 0xff;
+
+const unsigned char MOUSE_VISIBLE = 0x20;
+
+/// Small values of either sign as small unsigned ones, for WriteVLE.
+unsigned ZigZag(int value) {
+    return ((unsigned)value << 1) ^ (unsigned)(value >> 31);
+}
+
+int UnZigZag(unsigned value) {
+    return (int)(value >> 1) ^ -(int)(value & 1);
+}
+
+}
+
+InputRecorder::InputRecorder(Context* context)
+                :context_(context),
+                numFrames_(0)
+                {
+}
+
+InputRecorder::~InputRecorder() {
+    // Without Close the log has no end marker, which InputReplay takes as cut short
+    if (file_)
+        file_->Close();
+}
+
+bool InputRecorder::Open(const String& fileName, unsigned seed) {
+    file_ = new File(context_, fileName, FILE_WRITE);
+    if (!file_->IsOpen())
+    {
+        file_.Reset();
+        return false;
+    }
+
+    file_->WriteFileID(MAGIC);
+    file_->WriteUInt(VERSION);
+    file_->WriteUInt(seed);
+    numFrames_ = 0;
+    return true;
+}
+
+void InputRecorder::Write(const InputFrame& frame) {
+    if (!file_)
+        return;
+
+    file_->WriteUByte((unsigned char)((frame.keys_ & 0x1f) | (frame.mouseVisible_ ? MOUSE_VISIBLE : 0)));
+    file_->WriteFloat(frame.timeStep_);
+    file_->WriteVLE(ZigZag(frame.mouseMove_.x_));
+    file_->WriteVLE(ZigZag(frame.mouseMove_.y_));
+    file_->WriteVLE(frame.events_.Size());
+    for (const InputEvent& event : frame.events_)
+    {
+        file_->WriteUByte((unsigned char)event.type_);
+        file_->WriteVLE(ZigZag(event.value_));
+    }
+    ++numFrames_;
+}
+
+void InputRecorder::Close(unsigned stateHash) {
+    if (!file_)
+        return;
+
+    file_->WriteUByte(END_MARKER);
+    file_->WriteUInt(numFrames_);
+    file_->WriteUInt(stateHash);
+    file_->Close();
+    file_.Reset();
+}
+
+InputReplay::InputReplay()
+                :seed_(0),
+                hasStateHash_(false),
+                stateHash_(0)
+                {
+}
+
+bool InputReplay::Load(Context* context, const String& fileName) {
+    SharedPtr<File> file(new File(context, fileName, FILE_READ));
+    if (!file->IsOpen() || file->ReadFileID() != MAGIC || file->ReadUInt() != InputRecorder::VERSION)
+        return false;
+
+    frames_.Clear();
+    hasStateHash_ = false;
+    seed_ = file->ReadUInt();
+    while (!file->IsEof())
+    {
+        unsigned char flags = file->ReadUByte();
+        if (flags == END_MARKER)
+        {
+            // A frame count that does not match means the frames before it are not to be trusted either
+            hasStateHash_ = file->ReadUInt() == frames_.Size();
+            stateHash_ = file->ReadUInt();
+            break;
+        }
+
+        InputFrame frame;
+        frame.keys_ = flags & 0x1f;
+        frame.mouseVisible_ = (flags & MOUSE_VISIBLE) != 0;
+        frame.timeStep_ = file->ReadFloat();
+        frame.mouseMove_.x_ = UnZigZag(file->ReadVLE());
+        frame.mouseMove_.y_ = UnZigZag(file->ReadVLE());
+        frame.events_.Resize(file->ReadVLE());
+        for (InputEvent& event : frame.events_)
+        {
+            event.type_ = (InputEventType)file->ReadUByte();
+            event.value_ = UnZigZag(file->ReadVLE());
+        }
+        frames_.Push(frame);
+    }
+    return true;
+}
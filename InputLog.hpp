@@ -0,0 +1,105 @@
+#pragma once
+
+#include <Urho3D/Container/Ptr.h>
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/Math/Vector2.h>
+
+using namespace Urho3D;
+
+/// Keys World polls every frame, as bits of InputFrame::keys_.
+enum InputKey {
+    INPUT_KEY_SHIFT = 1,
+    INPUT_KEY_W = 2,
+    INPUT_KEY_S = 4,
+    INPUT_KEY_A = 8,
+    INPUT_KEY_D = 16,
+};
+
+enum InputEventType {
+    INPUT_KEYDOWN = 0,
+    /// A mouse click that fired a missile.
+    INPUT_CLICK,
+    INPUT_WHEEL,
+};
+
+/// An input event World handled between two updates.
+struct InputEvent {
+    InputEventType type_;
+    /// Key for INPUT_KEYDOWN, wheel steps for INPUT_WHEEL.
+    int value_;
+};
+
+/// Everything World read from input for one update.
+struct InputFrame {
+    float timeStep_ = 0.0f;
+    bool mouseVisible_ = true;
+    /// InputKey bits held down.
+    unsigned keys_ = 0;
+    IntVector2 mouseMove_;
+    /// Events handled before this update, in order.
+    PODVector<InputEvent> events_;
+};
+
+/**
+* Writes the input World reads, frame by frame, to a compact binary log
+* that InputReplay can feed back. The file is a header with the random seed
+* the scene was built with, then per frame a flags byte (held keys and
+* mouse visibility), the timestep and variable length mouse motion and
+* events. Closing writes an end marker, the frame count and a hash of the
+* final world state, so a replay can tell whether it ended up the same.
+*/
+class InputRecorder {
+public:
+    explicit InputRecorder(Context* context);
+
+    ~InputRecorder();
+
+    bool Open(const String& fileName, unsigned seed);
+
+    void Write(const InputFrame& frame);
+
+    /// Write the end marker with the final state hash and close the file.
+    void Close(unsigned stateHash);
+
+    bool IsOpen() const { return file_.NotNull(); }
+
+    unsigned GetNumFrames() const { return numFrames_; }
+
+    static const unsigned VERSION = 1;
+
+private:
+    Context* context_;
+    SharedPtr<File> file_;
+    unsigned numFrames_;
+};
+
+/**
+* An input log loaded whole, to be fed back frame by frame. A log cut short,
+* e.g. by a crash, still replays up to where it ends but has no state hash
+* to compare against.
+*/
+class InputReplay {
+public:
+    InputReplay();
+
+    /// Fails on a missing file, wrong magic or version.
+    bool Load(Context* context, const String& fileName);
+
+    unsigned GetSeed() const { return seed_; }
+
+    unsigned GetNumFrames() const { return frames_.Size(); }
+
+    const InputFrame& GetFrame(unsigned index) const { return frames_[index]; }
+
+    bool HasStateHash() const { return hasStateHash_; }
+
+    unsigned GetStateHash() const { return stateHash_; }
+
+private:
+    Vector<InputFrame> frames_;
+    unsigned seed_;
+    bool hasStateHash_;
+    unsigned stateHash_;
+};
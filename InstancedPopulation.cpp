@@ -0,0 +1,429 @@
+#include "InstancedPopulation.hpp"
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Graphics/Batch.h>
+#include <Urho3D/Graphics/Camera.h>
+#include <Urho3D/Graphics/Geometry.h>
+#include <Urho3D/Graphics/Material.h>
+#include <Urho3D/Graphics/OcclusionBuffer.h>
+#include <Urho3D/Graphics/OctreeQuery.h>
+#include <Urho3D/Graphics/VertexBuffer.h>
+#include <Urho3D/Scene/Node.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+/// Packs both cell coordinates into one sort key. Built in unsigned arithmetic, shifting a negative
+/// coordinate left is undefined.
+long long CellKey(int x, int z) {
+    return (long long)(((unsigned long long)(unsigned)x << 32) | (unsigned)z);
+}
+
+}
+
+InstancedPopulation::InstancedPopulation(Context* context)
+                :StaticModel(context),
+                cellSize_(16.0f),
+                cellsDirty_(false),
+                density_(1.0f),
+                densityThreshold_(0x10000),
+                lodMinDistance_(0.0f),
+                lodMaxDistance_(0.0f),
+                faceCamera_(false),
+                occluderBudget_(0),
+                numOccludersDrawn_(0),
+                numOccluderTrianglesDrawn_(0)
+                {
+}
+
+void InstancedPopulation::RegisterObject(Context* context) {
+    context->RegisterFactory<InstancedPopulation>("Geometry");
+
+    URHO3D_COPY_BASE_ATTRIBUTES(StaticModel);
+    URHO3D_ATTRIBUTE("Cell Size", float, cellSize_, 16.0f, AM_DEFAULT);
+    URHO3D_MIXED_ACCESSOR_ATTRIBUTE("Instances", GetInstancesAttr, SetInstancesAttr, PODVector<unsigned char>, Variant::emptyBuffer, AM_DEFAULT);
+}
+
+void InstancedPopulation::Reserve(unsigned numInstances) {
+    transforms_.Reserve(numInstances);
+}
+
+void InstancedPopulation::AddInstance(const Vector3& position, const Quaternion& rotation, const Vector3& scale) {
+    transforms_.Push(Matrix3x4(position, rotation, scale));
+    MarkInstancesDirty();
+}
+
+void InstancedPopulation::RemoveAllInstances() {
+    transforms_.Clear();
+    MarkInstancesDirty();
+}
+
+void InstancedPopulation::SetCellSize(float size) {
+    cellSize_ = Max(size, 1.0f);
+    MarkInstancesDirty();
+}
+
+void InstancedPopulation::SetDensity(float density) {
+    density_ = Clamp(density, 0.0f, 1.0f);
+    densityThreshold_ = (unsigned)(density_ * 0x10000);
+}
+
+void InstancedPopulation::SetLodRange(float minDistance, float maxDistance) {
+    lodMinDistance_ = Max(minDistance, 0.0f);
+    lodMaxDistance_ = Max(maxDistance, 0.0f);
+}
+
+InstancedPopulation* InstancedPopulation::AddLodBand(Model* model, Material* material, float minDistance, float maxDistance,
+                                                     bool faceCamera) {
+    if (!node_)
+        return nullptr;
+
+    // Temporary, bands are rebuilt at runtime and never saved or cooked
+    auto* band = node_->CreateComponent<InstancedPopulation>(LOCAL);
+    band->SetTemporary(true);
+    band->lodSource_ = this;
+    band->faceCamera_ = faceCamera;
+    band->SetModel(model);
+    band->SetMaterial(material);
+    band->SetLodRange(minDistance, maxDistance);
+    lodBands_.Push(WeakPtr<InstancedPopulation>(band));
+    return band;
+}
+
+void InstancedPopulation::MarkInstancesDirty() {
+    cellsDirty_ = true;
+    if (node_)
+        OnMarkedDirty(node_);
+    for (WeakPtr<InstancedPopulation>& band : lodBands_)
+    {
+        if (band)
+            band->OnMarkedDirty(node_);
+    }
+}
+
+BoundingBox InstancedPopulation::GetInstanceBoundingBox(unsigned index) {
+    // Make sure the world transforms are current
+    GetWorldBoundingBox();
+    return boundingBox_.Transformed(worldTransforms_[index]);
+}
+
+void InstancedPopulation::RebuildCells() {
+    cellsDirty_ = false;
+    cells_.Clear();
+    if (transforms_.Empty())
+        return;
+
+    // Sort instances by the cell their origin falls in, so each cell is a contiguous run
+    struct Keyed {
+        long long key_;
+        unsigned index_;
+    };
+    PODVector<Keyed> keys(transforms_.Size());
+    for (unsigned i = 0; i < transforms_.Size(); ++i)
+    {
+        Vector3 position = transforms_[i].Translation();
+        keys[i].key_ = CellKey(FloorToInt(position.x_ / cellSize_), FloorToInt(position.z_ / cellSize_));
+        keys[i].index_ = i;
+    }
+    std::sort(keys.Begin(), keys.End(), [](const Keyed& a, const Keyed& b) {
+        return a.key_ < b.key_ || (a.key_ == b.key_ && a.index_ < b.index_);
+    });
+
+    PODVector<Matrix3x4> sorted(transforms_.Size());
+    for (unsigned i = 0; i < keys.Size(); ++i)
+    {
+        sorted[i] = transforms_[keys[i].index_];
+        if (i == 0 || keys[i].key_ != keys[i - 1].key_)
+        {
+            Cell cell;
+            cell.start_ = i;
+            cell.count_ = 0;
+            cells_.Push(cell);
+        }
+        cells_.Back().count_++;
+    }
+    transforms_.Swap(sorted);
+}
+
+void InstancedPopulation::OnWorldBoundingBoxUpdate() {
+    if (lodSource_)
+    {
+        // Bands have no instances of their own and cover wherever the source does
+        worldBoundingBox_ = lodSource_->GetWorldBoundingBox();
+        visibleTransforms_.Reserve(lodSource_->GetNumInstances());
+        return;
+    }
+
+    if (cellsDirty_)
+        RebuildCells();
+
+    // Update transforms and bounding boxes in one pass over the instances
+    const Matrix3x4& nodeTransform = node_->GetWorldTransform();
+    worldTransforms_.Resize(transforms_.Size());
+    // Reserve up front so the batch pointer into this array stays valid while views are prepared
+    visibleTransforms_.Reserve(transforms_.Size());
+
+    BoundingBox worldBox;
+    for (Cell& cell : cells_)
+    {
+        BoundingBox cellBox;
+        for (unsigned i = cell.start_; i < cell.start_ + cell.count_; ++i)
+        {
+            worldTransforms_[i] = nodeTransform * transforms_[i];
+            cellBox.Merge(boundingBox_.Transformed(worldTransforms_[i]));
+        }
+        cell.worldBox_ = cellBox;
+        worldBox.Merge(cellBox);
+    }
+    worldBoundingBox_ = worldBox;
+}
+
+void InstancedPopulation::UpdateBatches(const FrameInfo& frame) {
+    // Getting the world bounding box ensures the transforms are updated
+    const BoundingBox& worldBoundingBox = GetWorldBoundingBox();
+    distance_ = frame.camera_->GetDistance(worldBoundingBox.Center());
+
+    // A LOD band draws its source's instances, culled against the source's model
+    const InstancedPopulation* data = lodSource_ ? lodSource_.Get() : this;
+    const BoundingBox& instanceBox = data->boundingBox_;
+
+    Vector3 cameraPosition = frame.camera_->GetNode()->GetWorldPosition();
+    float minDistanceSquared = lodMinDistance_ * lodMinDistance_;
+    float maxDistanceSquared = lodMaxDistance_ > 0.0f ? lodMaxDistance_ * lodMaxDistance_ : M_INFINITY;
+    Quaternion faceRotation;
+    if (faceCamera_)
+    {
+        // Turn the XZ plane of the impostor model to face the camera
+        faceRotation = frame.camera_->GetNode()->GetWorldRotation() * Quaternion(-90.0f, 0.0f, 0.0f);
+    }
+
+    // Reject whole cells first, by frustum and by distance band, then test instances only in cells
+    // that straddle the frustum or the band
+    const Frustum& frustum = frame.camera_->GetFrustum();
+    visibleTransforms_.Clear();
+    for (const Cell& cell : data->cells_)
+    {
+        Intersection result = frustum.IsInside(cell.worldBox_);
+        if (result == OUTSIDE)
+            continue;
+
+        Vector3 nearest = cameraPosition;
+        nearest.x_ = Clamp(nearest.x_, cell.worldBox_.min_.x_, cell.worldBox_.max_.x_);
+        nearest.y_ = Clamp(nearest.y_, cell.worldBox_.min_.y_, cell.worldBox_.max_.y_);
+        nearest.z_ = Clamp(nearest.z_, cell.worldBox_.min_.z_, cell.worldBox_.max_.z_);
+        Vector3 farthest((cameraPosition.x_ < cell.worldBox_.Center().x_ ? cell.worldBox_.max_ : cell.worldBox_.min_).x_,
+                         (cameraPosition.y_ < cell.worldBox_.Center().y_ ? cell.worldBox_.max_ : cell.worldBox_.min_).y_,
+                         (cameraPosition.z_ < cell.worldBox_.Center().z_ ? cell.worldBox_.max_ : cell.worldBox_.min_).z_);
+        float nearSquared = (nearest - cameraPosition).LengthSquared();
+        float farSquared = (farthest - cameraPosition).LengthSquared();
+        if (farSquared < minDistanceSquared || nearSquared >= maxDistanceSquared)
+            continue;
+        bool inBand = nearSquared >= minDistanceSquared && farSquared < maxDistanceSquared;
+
+        unsigned end = cell.start_ + cell.count_;
+        for (unsigned i = cell.start_; i < end; ++i)
+        {
+            if (data->IsThinnedOut(i))
+                continue;
+
+            const Matrix3x4& transform = data->worldTransforms_[i];
+            if (!inBand)
+            {
+                float distanceSquared = (transform.Translation() - cameraPosition).LengthSquared();
+                if (distanceSquared < minDistanceSquared || distanceSquared >= maxDistanceSquared)
+                    continue;
+            }
+            if (result != INSIDE && frustum.IsInsideFast(instanceBox.Transformed(transform)) == OUTSIDE)
+                continue;
+
+            if (faceCamera_)
+            {
+                // A quad as wide as the instance's bounds, through their center
+                Vector3 size = instanceBox.Size() * transform.Scale();
+                float extent = Max(size.x_, size.y_);
+                visibleTransforms_.Push(Matrix3x4(transform * instanceBox.Center(), faceRotation, Vector3(extent, 1.0f, extent)));
+            }
+            else
+                visibleTransforms_.Push(transform);
+        }
+    }
+
+    for (unsigned i = 0; i < batches_.Size(); ++i)
+    {
+        batches_[i].distance_ = distance_;
+        batches_[i].worldTransform_ = visibleTransforms_.Size() ? &visibleTransforms_[0] : &Matrix3x4::IDENTITY;
+        batches_[i].numWorldTransforms_ = visibleTransforms_.Size();
+    }
+
+    float scale = boundingBox_.Size().DotProduct(DOT_SCALE);
+    float newLodDistance = frame.camera_->GetLodDistance(distance_, scale, lodBias_);
+
+    if (newLodDistance != lodDistance_)
+    {
+        lodDistance_ = newLodDistance;
+        CalculateLodLevels();
+    }
+}
+
+void InstancedPopulation::ProcessRayQuery(const RayOctreeQuery& query, PODVector<RayQueryResult>& results) {
+    // The source answers for a band's instances
+    if (lodSource_)
+        return;
+
+    // Instances are tested against their bounding boxes only, whatever the requested query level
+    GetWorldBoundingBox();
+    for (const Cell& cell : cells_)
+    {
+        if (query.ray_.HitDistance(cell.worldBox_) >= query.maxDistance_)
+            continue;
+
+        for (unsigned i = cell.start_; i < cell.start_ + cell.count_; ++i)
+        {
+            float distance = query.ray_.HitDistance(boundingBox_.Transformed(worldTransforms_[i]));
+            if (distance < query.maxDistance_)
+            {
+                RayQueryResult result;
+                result.position_ = query.ray_.origin_ + distance * query.ray_.direction_;
+                result.normal_ = -query.ray_.direction_;
+                result.distance_ = distance;
+                result.drawable_ = this;
+                result.node_ = node_;
+                result.subObject_ = i;
+                results.Push(result);
+            }
+        }
+    }
+}
+
+unsigned InstancedPopulation::GetNumOccluderTriangles() {
+    // View orders occluders by triangles per size, a budgeted population draws no more than its budget
+    unsigned triangles = StaticModel::GetNumOccluderTriangles() * transforms_.Size();
+    return occluderBudget_ ? Min(triangles, occluderBudget_) : triangles;
+}
+
+bool InstancedPopulation::DrawOcclusion(OcclusionBuffer* buffer) {
+    // Make sure instance transforms are up-to-date
+    GetWorldBoundingBox();
+
+    numOccludersDrawn_ = 0;
+    numOccluderTrianglesDrawn_ = 0;
+    if (!occluderBudget_)
+    {
+        for (unsigned i = 0; i < worldTransforms_.Size(); ++i)
+        {
+            if (!DrawInstanceOcclusion(buffer, i))
+                return false;
+        }
+        return true;
+    }
+
+    // Score every instance on screen by the share of the screen its bounds cover
+    Matrix3x4 view = buffer->GetView();
+    const Matrix4& projection = buffer->GetProjection();
+    occluderCandidates_.Clear();
+    for (unsigned i = 0; i < worldTransforms_.Size(); ++i)
+    {
+        BoundingBox box = boundingBox_.Transformed(worldTransforms_[i]);
+        float radius = box.HalfSize().Length();
+        Vector3 center = view * box.Center();
+        if (center.z_ <= -radius)
+            continue;
+
+        OccluderCandidate candidate;
+        candidate.index_ = i;
+        if (center.z_ > radius)
+        {
+            // Bounding sphere projected to normalized device coordinates
+            float invDepth = 1.0f / center.z_;
+            float x = center.x_ * projection.m00_ * invDepth;
+            float y = center.y_ * projection.m11_ * invDepth;
+            float radiusX = radius * projection.m00_ * invDepth;
+            float radiusY = radius * projection.m11_ * invDepth;
+            if (x - radiusX > 1.0f || x + radiusX < -1.0f || y - radiusY > 1.0f || y + radiusY < -1.0f)
+                continue;
+            candidate.coverage_ = Min(radiusX * radiusY, 1.0f);
+        }
+        else
+        {
+            // Inside or touching the box covers the whole screen
+            candidate.coverage_ = 1.0f;
+        }
+        if (candidate.coverage_ >= MIN_OCCLUDER_COVERAGE)
+            occluderCandidates_.Push(candidate);
+    }
+
+    std::sort(occluderCandidates_.Begin(), occluderCandidates_.End(), [](const OccluderCandidate& lhs, const OccluderCandidate& rhs) {
+        return lhs.coverage_ > rhs.coverage_;
+    });
+
+    // Biggest first until the triangle budget is spent
+    unsigned trianglesPerInstance = Max(StaticModel::GetNumOccluderTriangles(), 1u);
+    for (const OccluderCandidate& candidate : occluderCandidates_)
+    {
+        if (numOccluderTrianglesDrawn_ + trianglesPerInstance > occluderBudget_)
+            break;
+        if (!DrawInstanceOcclusion(buffer, candidate.index_))
+            return false;
+    }
+    return true;
+}
+
+bool InstancedPopulation::DrawInstanceOcclusion(OcclusionBuffer* buffer, unsigned index) {
+    for (unsigned j = 0; j < batches_.Size(); ++j)
+    {
+        Geometry* geometry = GetLodGeometry(j, occlusionLodLevel_);
+        if (!geometry)
+            continue;
+
+        // Check that the material is suitable for occlusion (default material always is) and set culling mode
+        Material* material = batches_[j].material_;
+        if (material)
+        {
+            if (!material->GetOcclusion())
+                continue;
+            buffer->SetCullMode(material->GetCullMode());
+        }
+        else
+            buffer->SetCullMode(CULL_CCW);
+
+        const unsigned char* vertexData;
+        unsigned vertexSize;
+        const unsigned char* indexData;
+        unsigned indexSize;
+        const PODVector<VertexElement>* elements;
+
+        geometry->GetRawData(vertexData, vertexSize, indexData, indexSize, elements);
+        // Check for valid geometry data
+        if (!vertexData || !indexData || !elements || VertexBuffer::GetElementOffset(*elements, TYPE_VECTOR3, SEM_POSITION) != 0)
+            continue;
+
+        // Draw and check for running out of triangles
+        if (!buffer->AddTriangles(worldTransforms_[index], vertexData, vertexSize, indexData, indexSize,
+                                  geometry->GetIndexStart(), geometry->GetIndexCount()))
+            return false;
+        numOccluderTrianglesDrawn_ += geometry->GetIndexCount() / 3;
+    }
+    ++numOccludersDrawn_;
+    return true;
+}
+
+void InstancedPopulation::SetInstances(const Matrix3x4* transforms, unsigned count) {
+    transforms_.Resize(count);
+    if (count)
+        memcpy(&transforms_[0], transforms, count * sizeof(Matrix3x4));
+    MarkInstancesDirty();
+}
+
+void InstancedPopulation::SetInstancesAttr(const PODVector<unsigned char>& value) {
+    unsigned count = value.Size() / sizeof(Matrix3x4);
+    SetInstances(count ? reinterpret_cast<const Matrix3x4*>(&value[0]) : nullptr, count);
+}
+
+PODVector<unsigned char> InstancedPopulation::GetInstancesAttr() const {
+    PODVector<unsigned char> value(transforms_.Size() * sizeof(Matrix3x4));
+    if (transforms_.Size())
+        memcpy(&value[0], &transforms_[0], value.Size());
+    return value;
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <Urho3D/Graphics/StaticModel.h>
+#include <Urho3D/Math/Matrix3x4.h>
+
+using namespace Urho3D;
+
+/**
+* Many copies of one Model/Material pair owned by a single node. Instance
+* transforms are stored contiguously in the node's local space, like
+* StaticModelGroup but without a scene node per instance. Instances are
+* bucketed into square cells so frustum culling rejects whole cells before
+* testing individual instances, and only the surviving transforms are handed
+* to the renderer as one instanced batch per geometry.
+*
+* Culling is done against the view camera, so instances outside the view
+* do not cast shadows into it. A population can be limited to a range of
+* camera distances and given LOD bands that draw the same instances further
+* out with cheaper models or camera facing impostors.
+*/
+class InstancedPopulation : public StaticModel {
+
+    URHO3D_OBJECT(InstancedPopulation, StaticModel);
+
+public:
+    explicit InstancedPopulation(Context* context);
+
+    static void RegisterObject(Context* context);
+
+    void ProcessRayQuery(const RayOctreeQuery& query, PODVector<RayQueryResult>& results) override;
+
+    void UpdateBatches(const FrameInfo& frame) override;
+
+    unsigned GetNumOccluderTriangles() override;
+
+    bool DrawOcclusion(OcclusionBuffer* buffer) override;
+
+    void Reserve(unsigned numInstances);
+
+    void AddInstance(const Vector3& position, const Quaternion& rotation, const Vector3& scale);
+
+    void RemoveAllInstances();
+
+    /// Replace every instance with local transforms copied from an array.
+    void SetInstances(const Matrix3x4* transforms, unsigned count);
+
+    /// Side length of the square culling cells in local units.
+    void SetCellSize(float size);
+
+    float GetCellSize() const { return cellSize_; }
+
+    /// Draw only instances at least minDistance and less than maxDistance from the camera, 0 for no limit.
+    void SetLodRange(float minDistance, float maxDistance);
+
+    float GetLodMinDistance() const { return lodMinDistance_; }
+
+    float GetLodMaxDistance() const { return lodMaxDistance_; }
+
+    /**
+    * Add a temporary population on the same node that draws this population's instances with
+    * another model and material between minDistance and maxDistance. With faceCamera each
+    * instance becomes a camera facing quad the size of its bounds, for a plane model used as
+    * an impostor. Bands follow this population's instances and density.
+    */
+    InstancedPopulation* AddLodBand(Model* model, Material* material, float minDistance, float maxDistance, bool faceCamera);
+
+    unsigned GetNumLodBands() const { return lodBands_.Size(); }
+
+    /// Null once the band's component is gone.
+    InstancedPopulation* GetLodBand(unsigned index) const { return lodBands_[index]; }
+
+    /**
+    * With a budget, only the instances that cover the most of the screen from the current camera
+    * are drawn into the occlusion buffer, biggest first, until the triangles run out. Zero draws
+    * every instance, as a plain occluder flag would.
+    */
+    void SetOccluderBudget(unsigned triangles) { occluderBudget_ = triangles; }
+
+    unsigned GetOccluderBudget() const { return occluderBudget_; }
+
+    /// Instances and triangles drawn by the last DrawOcclusion.
+    unsigned GetNumOccludersDrawn() const { return numOccludersDrawn_; }
+
+    unsigned GetNumOccluderTrianglesDrawn() const { return numOccluderTrianglesDrawn_; }
+
+    /// Smallest share of the screen an instance must cover to be picked as an occluder.
+    static constexpr float MIN_OCCLUDER_COVERAGE = 0.0005f;
+
+    /// Fraction of the instances that are drawn, 0 to 1. The same instances stay hidden while the density holds.
+    void SetDensity(float density);
+
+    float GetDensity() const { return density_; }
+
+    unsigned GetNumInstances() const { return transforms_.Size(); }
+
+    unsigned GetNumVisibleInstances() const { return visibleTransforms_.Size(); }
+
+    /// Local transform of an instance. Instances are reordered by cell, so indices are only stable between edits.
+    const Matrix3x4& GetInstanceTransform(unsigned index) const { return transforms_[index]; }
+
+    const PODVector<Matrix3x4>& GetInstanceTransforms() const { return transforms_; }
+
+    /// World space bounding box of one instance.
+    BoundingBox GetInstanceBoundingBox(unsigned index);
+
+    void SetInstancesAttr(const PODVector<unsigned char>& value);
+
+    PODVector<unsigned char> GetInstancesAttr() const;
+
+protected:
+    void OnWorldBoundingBoxUpdate() override;
+
+private:
+    struct Cell {
+        BoundingBox worldBox_;
+        unsigned start_;
+        unsigned count_;
+    };
+
+    void RebuildCells();
+
+    /// Instances changed, rebuild cells and bounds here and in the LOD bands.
+    void MarkInstancesDirty();
+
+    bool DrawInstanceOcclusion(OcclusionBuffer* buffer, unsigned index);
+
+    struct OccluderCandidate {
+        unsigned index_;
+        float coverage_;
+    };
+
+    /// Whether an instance is left out at the current density, by a hash of its local position quantized to
+    /// 1/16 unit. The index is not stable, it changes whenever the cells are rebuilt.
+    bool IsThinnedOut(unsigned index) const {
+        Vector3 position = transforms_[index].Translation() * 16.0f;
+        unsigned hash = (unsigned)FloorToInt(position.x_) * 73856093u ^ (unsigned)FloorToInt(position.y_) * 19349663u ^
+                        (unsigned)FloorToInt(position.z_) * 83492791u;
+        return ((hash * 2654435761u) >> 16 & 0xffff) >= densityThreshold_;
+    }
+
+    /// Instance transforms in local space, sorted by cell once the cells are built.
+    PODVector<Matrix3x4> transforms_;
+    /// Instance transforms in world space, same order as transforms_.
+    PODVector<Matrix3x4> worldTransforms_;
+    /// Transforms that passed culling this frame.
+    PODVector<Matrix3x4> visibleTransforms_;
+
+    PODVector<Cell> cells_;
+    float cellSize_;
+    bool cellsDirty_;
+    float density_;
+    /// Density scaled to 0-65536, compared against the instance hash.
+    unsigned densityThreshold_;
+
+    float lodMinDistance_;
+    float lodMaxDistance_;
+    /// Population whose instances this band draws, null for a population with its own instances.
+    WeakPtr<InstancedPopulation> lodSource_;
+    Vector<WeakPtr<InstancedPopulation> > lodBands_;
+    bool faceCamera_;
+
+    unsigned occluderBudget_;
+    unsigned numOccludersDrawn_;
+    unsigned numOccluderTrianglesDrawn_;
+    /// Scratch list for occluder selection, reused every frame.
+    PODVector<OccluderCandidate> occluderCandidates_;
+};
@@ -0,0 +1,188 @@
+#include "InterestManager.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+/// Sequence, baseline and time, plus the count of added entities.
+const unsigned HEADER_BITS = 3 * 32 + 8;
+/// Id delta and the full quantized state.
+const unsigned NEW_ENTITY_BITS = 8 + 3 * SnapshotCodec::POSITION_BITS + 2 * SnapshotCodec::DIRECTION_BITS;
+/// The changed bit and a residual now and then, entities mostly stay on their predicted path.
+const unsigned KEPT_ENTITY_BITS = 6;
+/// Re-encodes of a packet the estimate let go over budget.
+const unsigned MAX_TRIMS = 3;
+
+bool CompareId(const EntityState& lhs, const EntityState& rhs) { return lhs.id_ < rhs.id_; }
+
+}
+
+InterestManager::InterestManager(float speed, const InterestSettings& settings)
+                :speed_(speed),
+                settings_(settings),
+                nextSequence_(0),
+                timeUs_(0),
+                numOverBudget_(0)
+                {
+    // The grid covers everything a snapshot can hold
+    settings_.cellSize_ = Max(settings_.cellSize_, 1.0f);
+    cellsPerSide_ = CeilToInt(2.0f * SnapshotCodec::POSITION_RANGE / settings_.cellSize_);
+    gridOrigin_ = -SnapshotCodec::POSITION_RANGE;
+    cellStart_.Resize(cellsPerSide_ * cellsPerSide_ + 1);
+}
+
+unsigned InterestManager::AddClient() {
+    clients_.Resize(clients_.Size() + 1);
+    return clients_.Size() - 1;
+}
+
+void InterestManager::Capture(Snapshot& world) {
+    TraceScope trace("InterestManager::Capture");
+    world.sequence_ = nextSequence_++;
+    timeUs_ = world.timeUs_;
+    entities_ = world.entities_;
+
+    unsigned numEntities = entities_.Size();
+    positions_.Resize(numEntities);
+    cellEntities_.Resize(numEntities);
+    auto cellOf = [this](const Vector3& position) {
+        int x = Clamp(FloorToInt((position.x_ - gridOrigin_) / settings_.cellSize_), 0, cellsPerSide_ - 1);
+        int z = Clamp(FloorToInt((position.z_ - gridOrigin_) / settings_.cellSize_), 0, cellsPerSide_ - 1);
+        return (unsigned)(z * cellsPerSide_ + x);
+    };
+
+    // Counting sort by cell: count, turn the counts into cell ends, then fill each cell from its end
+    memset(cellStart_.Buffer(), 0, cellStart_.Size() * sizeof(unsigned));
+    for (unsigned i = 0; i < numEntities; ++i)
+    {
+        const EntityState& entity = entities_[i];
+        positions_[i] = Vector3(SnapshotCodec::DequantizePosition(entity.position_[0]),
+                                SnapshotCodec::DequantizePosition(entity.position_[1]),
+                                SnapshotCodec::DequantizePosition(entity.position_[2]));
+        ++cellStart_[cellOf(positions_[i])];
+    }
+    unsigned end = 0;
+    for (unsigned cell = 0; cell + 1 < cellStart_.Size(); ++cell)
+    {
+        end += cellStart_[cell];
+        cellStart_[cell] = end;
+    }
+    cellStart_.Back() = numEntities;
+    for (unsigned i = numEntities; i-- > 0;)
+        cellEntities_[--cellStart_[cellOf(positions_[i])]] = i;
+}
+
+void InterestManager::BuildPacket(unsigned client, PODVector<unsigned char>& out) {
+    if (!nextSequence_)
+    {
+        out.Clear();
+        return;
+    }
+
+    TraceScope trace("InterestManager::BuildPacket");
+    ClientState& state = clients_[client];
+    const Snapshot* baseline = GetBaseline(state);
+    FindCandidates(state.view_);
+    unsigned count = FitBudget(baseline);
+
+    unsigned sequence = nextSequence_ - 1;
+    Snapshot& sent = state.history_[sequence % HISTORY_SIZE];
+    for (unsigned trim = 0;; ++trim)
+    {
+        sent.sequence_ = sequence;
+        sent.timeUs_ = timeUs_;
+        sent.entities_.Resize(count);
+        for (unsigned i = 0; i < count; ++i)
+            sent.entities_[i] = entities_[candidates_[i].index_];
+        std::sort(sent.entities_.Begin(), sent.entities_.End(), CompareId);
+        SnapshotCodec::Encode(sent, baseline, speed_, out);
+
+        if (out.Size() <= settings_.budgetBytes_ || !count || trim == MAX_TRIMS)
+            break;
+        // The estimate was low, drop the furthest entities until their estimate covers the overshoot
+        unsigned overshootBits = (out.Size() - settings_.budgetBytes_) * 8;
+        for (unsigned saved = 0; count && saved < overshootBits;)
+            saved += EstimateBits(baseline, candidates_[--count].index_);
+    }
+
+    if (out.Size() > settings_.budgetBytes_)
+        ++numOverBudget_;
+    state.numSent_ = count;
+    state.numDropped_ = candidates_.Size() - count;
+}
+
+void InterestManager::Acknowledge(unsigned client, unsigned sequence) {
+    unsigned& ack = clients_[client].ack_;
+    // Acks can arrive out of order, only move forward
+    if (ack == SnapshotCodec::NO_BASELINE || (int)(sequence - ack) > 0)
+        ack = sequence;
+}
+
+const Snapshot* InterestManager::GetBaseline(const ClientState& client) const {
+    // The packet being built takes the slot of the snapshot HISTORY_SIZE back, so that one is already gone
+    unsigned sequence = nextSequence_ - 1;
+    if (client.ack_ == SnapshotCodec::NO_BASELINE || client.ack_ >= sequence || sequence - client.ack_ >= HISTORY_SIZE)
+        return nullptr;
+    const Snapshot& baseline = client.history_[client.ack_ % HISTORY_SIZE];
+    return baseline.sequence_ == client.ack_ ? &baseline : nullptr;
+}
+
+void InterestManager::FindCandidates(const InterestView& view) {
+    candidates_.Clear();
+    float radius = settings_.radius_;
+    float radiusSquared = radius * radius;
+    float nearSquared = settings_.nearRadius_ * settings_.nearRadius_;
+    int minX = Clamp(FloorToInt((view.position_.x_ - radius - gridOrigin_) / settings_.cellSize_), 0, cellsPerSide_ - 1);
+    int maxX = Clamp(FloorToInt((view.position_.x_ + radius - gridOrigin_) / settings_.cellSize_), 0, cellsPerSide_ - 1);
+    int minZ = Clamp(FloorToInt((view.position_.z_ - radius - gridOrigin_) / settings_.cellSize_), 0, cellsPerSide_ - 1);
+    int maxZ = Clamp(FloorToInt((view.position_.z_ + radius - gridOrigin_) / settings_.cellSize_), 0, cellsPerSide_ - 1);
+
+    for (int z = minZ; z <= maxZ; ++z)
+    {
+        for (int x = minX; x <= maxX; ++x)
+        {
+            unsigned cell = (unsigned)(z * cellsPerSide_ + x);
+            for (unsigned i = cellStart_[cell]; i < cellStart_[cell + 1]; ++i)
+            {
+                unsigned index = cellEntities_[i];
+                const Vector3& position = positions_[index];
+                float distanceSquared = (position - view.position_).LengthSquared();
+                if (distanceSquared > radiusSquared)
+                    continue;
+                if (distanceSquared > nearSquared && (!view.hasFrustum_ || view.frustum_.IsInside(position) == OUTSIDE))
+                    continue;
+                Candidate candidate = {distanceSquared, index};
+                candidates_.Push(candidate);
+            }
+        }
+    }
+
+    std::sort(candidates_.Begin(), candidates_.End(), [](const Candidate& lhs, const Candidate& rhs) {
+        return lhs.distanceSquared_ < rhs.distanceSquared_;
+    });
+}
+
+unsigned InterestManager::EstimateBits(const Snapshot* baseline, unsigned index) const {
+    if (!baseline)
+        return NEW_ENTITY_BITS;
+    EntityState key;
+    key.id_ = entities_[index].id_;
+    bool kept = std::binary_search(baseline->entities_.Begin(), baseline->entities_.End(), key, CompareId);
+    return kept ? KEPT_ENTITY_BITS : NEW_ENTITY_BITS;
+}
+
+unsigned InterestManager::FitBudget(const Snapshot* baseline) const {
+    unsigned budgetBits = settings_.budgetBytes_ * 8;
+    // Every baseline entity costs its present bit, sent or not
+    unsigned bits = HEADER_BITS + (baseline ? baseline->entities_.Size() : 0);
+    for (unsigned i = 0; i < candidates_.Size(); ++i)
+    {
+        unsigned cost = EstimateBits(baseline, candidates_[i].index_);
+        if (bits + cost > budgetBits)
+            return i;
+        bits += cost;
+    }
+    return candidates_.Size();
+}
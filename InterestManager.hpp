@@ -0,0 +1,116 @@
+#pragma once
+
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Math/Frustum.h>
+#include <Urho3D/Math/Vector3.h>
+
+#include "Snapshot.hpp"
+
+using namespace Urho3D;
+
+/// Where a client looks from, which decides what it is sent.
+struct InterestView {
+    Vector3 position_;
+    /// The client's camera frustum. Only the near radius is relevant when there is none.
+    Frustum frustum_;
+    bool hasFrustum_ = false;
+};
+
+struct InterestSettings {
+    /// Side of the grid cells entities are bucketed into.
+    float cellSize_ = 32.0f;
+    /// Entities further than this are never sent, usually the camera's far clip.
+    float radius_ = 150.0f;
+    /// Entities this close are sent even when outside the frustum, so turning around shows them at once.
+    float nearRadius_ = 20.0f;
+    /// Most bytes of snapshot per client per tick, the network message payload by default.
+    unsigned budgetBytes_ = 1200;
+};
+
+/**
+* Area-of-interest replication. Every tick the world snapshot is bucketed
+* into a uniform grid on x and z, and each client is sent only the entities
+* in its frustum within the interest radius, plus those right next to it.
+* Relevant entities are ranked nearest first and taken until the estimated
+* packet fills the client's byte budget, so a crowded view drops the far
+* entities rather than going over budget.
+*
+* Each client sees its own subset of the world, so deltas are encoded against
+* a per-client history of what it was sent and has acknowledged, the same way
+* ReplicationServer does for the whole world. Sequence numbers are shared by
+* all clients and packets decode with a plain ReplicationClient.
+*/
+class InterestManager {
+public:
+    InterestManager(float speed, const InterestSettings& settings = InterestSettings());
+
+    unsigned AddClient();
+
+    void SetView(unsigned client, const InterestView& view) { clients_[client].view_ = view; }
+
+    /// Take the world's entities for this tick and bucket them, its sequence number is assigned here.
+    void Capture(Snapshot& world);
+
+    /// Select client's entities from the last capture and encode them against its acknowledged baseline.
+    void BuildPacket(unsigned client, PODVector<unsigned char>& out);
+
+    void Acknowledge(unsigned client, unsigned sequence);
+
+    const InterestSettings& GetSettings() const { return settings_; }
+
+    /// Entities in client's last packet.
+    unsigned GetNumSent(unsigned client) const { return clients_[client].numSent_; }
+
+    /// Entities relevant to client in its last packet that did not fit its budget.
+    unsigned GetNumDropped(unsigned client) const { return clients_[client].numDropped_; }
+
+    /// Packets still over budget after every trim, 0 unless the estimates are far off.
+    unsigned long long GetNumOverBudget() const { return numOverBudget_; }
+
+    /// A client's baseline is lost once it falls this many snapshots behind, and it is sent a full snapshot.
+    static const unsigned HISTORY_SIZE = 16;
+
+private:
+    struct Candidate {
+        float distanceSquared_;
+        unsigned index_;
+    };
+
+    struct ClientState {
+        InterestView view_;
+        unsigned ack_ = SnapshotCodec::NO_BASELINE;
+        Snapshot history_[HISTORY_SIZE];
+        unsigned numSent_ = 0;
+        unsigned numDropped_ = 0;
+    };
+
+    const Snapshot* GetBaseline(const ClientState& client) const;
+
+    /// Gather the relevant entities of view into candidates_, nearest first.
+    void FindCandidates(const InterestView& view);
+
+    /// Bits entity index is expected to add to a packet, far less when baseline has it.
+    unsigned EstimateBits(const Snapshot* baseline, unsigned index) const;
+
+    /// How many of the nearest candidates fit in the budget by their estimates.
+    unsigned FitBudget(const Snapshot* baseline) const;
+
+    float speed_;
+    InterestSettings settings_;
+    unsigned nextSequence_;
+    unsigned timeUs_;
+
+    // The last capture, with positions dequantized once for every client's distance tests
+    PODVector<EntityState> entities_;
+    PODVector<Vector3> positions_;
+
+    // Entity indices bucketed by cell, cellStart_[cell] to cellStart_[cell + 1]
+    int cellsPerSide_;
+    float gridOrigin_;
+    PODVector<unsigned> cellStart_;
+    PODVector<unsigned> cellEntities_;
+
+    Vector<ClientState> clients_;
+    PODVector<Candidate> candidates_;
+    unsigned long long numOverBudget_;
+};
@@ -0,0 +1,186 @@
+#include "JobSystem.hpp"
+#include "Trace.hpp"
+
+#include <Urho3D/Math/MathDefs.h>
+
+JobId JobGraph::Add(std::function<void()> function) {
+    // Slots are reused after Clear so the successor lists keep their storage
+    if (numJobs_ == jobs_.Size())
+        jobs_.Resize(numJobs_ + 1);
+    Job& job = jobs_[numJobs_];
+    job.function_ = std::move(function);
+    job.successors_.Clear();
+    job.numDependencies_ = 0;
+    return numJobs_++;
+}
+
+void JobGraph::AddDependency(JobId job, JobId dependency) {
+    jobs_[dependency].successors_.Push(job);
+    ++jobs_[job].numDependencies_;
+}
+
+JobSpan JobGraph::AddParallelFor(unsigned count, unsigned grain, std::function<void(unsigned, unsigned)> function,
+                                 unsigned alignment) {
+    alignment = Max(alignment, 1u);
+    grain = Max(grain, alignment);
+    grain = (grain + alignment - 1) / alignment * alignment;
+
+    JobSpan span;
+    span.first_ = Add(std::function<void()>());
+    for (unsigned begin = 0; begin < count; begin += grain)
+    {
+        unsigned end = Min(begin + grain, count);
+        JobId part = Add([function, begin, end]() { function(begin, end); });
+        AddDependency(part, span.first_);
+    }
+    // The parts were added back to back, between first_ and last_
+    span.last_ = Add(std::function<void()>());
+    if (span.last_ == span.first_ + 1)
+        AddDependency(span.last_, span.first_);
+    for (JobId part = span.first_ + 1; part < span.last_; ++part)
+        AddDependency(span.last_, part);
+    return span;
+}
+
+void JobGraph::Clear() {
+    numJobs_ = 0;
+}
+
+unsigned JobSystem::GetDefaultNumWorkers() {
+    unsigned hardware = std::thread::hardware_concurrency();
+    return hardware > 1 ? hardware - 1 : 0;
+}
+
+JobSystem::JobSystem(unsigned numWorkers)
+                :graph_(nullptr),
+                numQueued_(0),
+                quit_(false),
+                numSteals_(0)
+                {
+    // Queue 0 belongs to the thread calling Run
+    for (unsigned i = 0; i <= numWorkers; ++i)
+        queues_.emplace_back(new Queue());
+    for (unsigned i = 1; i <= numWorkers; ++i)
+        workers_.emplace_back(&JobSystem::WorkerLoop, this, i);
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        quit_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& worker : workers_)
+        worker.join();
+}
+
+void JobSystem::Run(JobGraph& graph) {
+    unsigned numJobs = graph.numJobs_;
+    if (!numJobs)
+        return;
+
+    if (graph.pendingSize_ < numJobs)
+    {
+        graph.pending_.reset(new std::atomic<unsigned>[numJobs]);
+        graph.pendingSize_ = numJobs;
+    }
+    for (unsigned i = 0; i < numJobs; ++i)
+        graph.pending_[i].store(graph.jobs_[i].numDependencies_, std::memory_order_relaxed);
+    graph.remaining_.store(numJobs);
+    graph_ = &graph;
+
+    // Spread the roots over every queue so the workers start without having to steal
+    unsigned next = 0;
+    for (unsigned i = 0; i < numJobs; ++i)
+    {
+        if (!graph.jobs_[i].numDependencies_)
+            Push(next++ % queues_.size(), i);
+    }
+
+    JobId job;
+    while (graph.remaining_.load() > 0)
+    {
+        if (TryTake(0, job))
+            Execute(0, job);
+        else
+            std::this_thread::yield();
+    }
+    graph_ = nullptr;
+}
+
+void JobSystem::WorkerLoop(unsigned index) {
+    Trace::SetThreadName("Job worker");
+    JobId job;
+    while (!quit_)
+    {
+        if (TryTake(index, job))
+        {
+            Execute(index, job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        wake_.wait(lock, [this]() { return quit_ || numQueued_.load() > 0; });
+    }
+}
+
+void JobSystem::Push(unsigned queue, JobId job) {
+    {
+        std::lock_guard<std::mutex> lock(queues_[queue]->mutex_);
+        queues_[queue]->jobs_.push_back(job);
+    }
+    numQueued_.fetch_add(1);
+    // Taking the lock orders this with a worker that is just about to wait
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+    }
+    wake_.notify_one();
+}
+
+bool JobSystem::TryTake(unsigned queue, JobId& job) {
+    if (!numQueued_.load())
+        return false;
+
+    {
+        Queue& own = *queues_[queue];
+        std::lock_guard<std::mutex> lock(own.mutex_);
+        if (!own.jobs_.empty())
+        {
+            job = own.jobs_.back();
+            own.jobs_.pop_back();
+            numQueued_.fetch_sub(1);
+            return true;
+        }
+    }
+
+    unsigned numQueues = queues_.size();
+    for (unsigned i = 1; i < numQueues; ++i)
+    {
+        Queue& victim = *queues_[(queue + i) % numQueues];
+        std::lock_guard<std::mutex> lock(victim.mutex_);
+        if (!victim.jobs_.empty())
+        {
+            job = victim.jobs_.front();
+            victim.jobs_.pop_front();
+            numQueued_.fetch_sub(1);
+            numSteals_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobSystem::Execute(unsigned queue, JobId job) {
+    JobGraph& graph = *graph_;
+    const JobGraph::Job& entry = graph.jobs_[job];
+    if (entry.function_)
+        entry.function_();
+
+    for (JobId successor : entry.successors_)
+    {
+        if (graph.pending_[successor].fetch_sub(1) == 1)
+            Push(queue, successor);
+    }
+    // Last, Run returns as soon as this reaches zero
+    graph.remaining_.fetch_sub(1);
+}
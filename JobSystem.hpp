@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <Urho3D/Container/Vector.h>
+
+using namespace Urho3D;
+
+typedef unsigned JobId;
+
+/// First and last job of a group added in one go, depend on first_ and wait on last_.
+struct JobSpan {
+    JobId first_;
+    JobId last_;
+};
+
+/**
+* A set of jobs and the dependencies between them, built on the calling
+* thread and then run by a JobSystem. A job starts once every job it depends
+* on has finished. The graph can be cleared and rebuilt every frame, its
+* storage is kept.
+*/
+class JobGraph {
+public:
+    JobId Add(std::function<void()> function);
+
+    /// job will not start before dependency has finished.
+    void AddDependency(JobId job, JobId dependency);
+
+    /**
+    * Split [0, count) into ranges of about grain items and add a job per range calling
+    * function(begin, end). Ranges start on a multiple of alignment so SIMD loops stay aligned.
+    */
+    JobSpan AddParallelFor(unsigned count, unsigned grain, std::function<void(unsigned, unsigned)> function,
+                           unsigned alignment = 1);
+
+    void Clear();
+
+    unsigned GetNumJobs() const { return numJobs_; }
+
+private:
+    friend class JobSystem;
+
+    struct Job {
+        std::function<void()> function_;
+        PODVector<JobId> successors_;
+        unsigned numDependencies_;
+    };
+
+    Vector<Job> jobs_;
+    unsigned numJobs_ = 0;
+    /// Dependencies left per job while running, reset by JobSystem::Run.
+    std::unique_ptr<std::atomic<unsigned>[]> pending_;
+    unsigned pendingSize_ = 0;
+    std::atomic<unsigned> remaining_{0};
+};
+
+/**
+* Worker threads with a job queue each. A thread pushes the jobs it unlocks
+* onto its own queue and takes work from the back of it, so dependent jobs
+* tend to run on the thread whose caches already hold their input. An idle
+* thread steals from the front of another thread's queue.
+*
+* Run blocks the calling thread until the whole graph is done, and the
+* calling thread works on the graph meanwhile, so a JobSystem with no
+* workers runs everything serially on the caller. Only one graph runs at a
+* time and Run must always be called from the same thread.
+*/
+class JobSystem {
+public:
+    /// Start numWorkers threads besides the caller, zero runs every job on the caller.
+    explicit JobSystem(unsigned numWorkers);
+
+    ~JobSystem();
+
+    void Run(JobGraph& graph);
+
+    /// Workers plus the calling thread.
+    unsigned GetNumThreads() const { return queues_.size(); }
+
+    unsigned long long GetNumSteals() const { return numSteals_.load(std::memory_order_relaxed); }
+
+    /// One worker per hardware thread, minus the caller.
+    static unsigned GetDefaultNumWorkers();
+
+private:
+    struct Queue {
+        std::mutex mutex_;
+        std::deque<JobId> jobs_;
+    };
+
+    void WorkerLoop(unsigned index);
+
+    void Push(unsigned queue, JobId job);
+
+    /// Take a job from the thread's own queue or steal one. Returns false if there was none.
+    bool TryTake(unsigned queue, JobId& job);
+
+    void Execute(unsigned queue, JobId job);
+
+    std::vector<std::unique_ptr<Queue> > queues_;
+    std::vector<std::thread> workers_;
+    JobGraph* graph_;
+
+    std::mutex sleepMutex_;
+    std::condition_variable wake_;
+    std::atomic<unsigned> numQueued_;
+    std::atomic<bool> quit_;
+    std::atomic<unsigned long long> numSteals_;
+};
@@ -0,0 +1,29 @@
+#include "LoopbackTransport.hpp"
+
+unsigned LoopbackTransport::AddClient() {
+    toClients_.Resize(toClients_.Size() + 1);
+    return toClients_.Size() - 1;
+}
+
+void LoopbackTransport::SendToServer(unsigned client, unsigned short type, const unsigned char* data, unsigned size) {
+    Push(toServer_, client, type, data, size);
+    bytesToServer_ += size;
+}
+
+void LoopbackTransport::SendToClient(unsigned client, unsigned short type, const unsigned char* data, unsigned size) {
+    Push(toClients_[client], client, type, data, size);
+    bytesToClients_ += size;
+}
+
+void LoopbackTransport::Push(PODVector<unsigned char>& queue, unsigned client, unsigned short type,
+                             const unsigned char* data, unsigned size) {
+    Header header;
+    header.client_ = client;
+    header.type_ = type;
+    header.size_ = size;
+    unsigned offset = queue.Size();
+    queue.Resize(offset + sizeof(Header) + size);
+    memcpy(queue.Buffer() + offset, &header, sizeof(Header));
+    if (size)
+        memcpy(queue.Buffer() + offset + sizeof(Header), data, size);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstring>
+
+#include <Urho3D/Container/Vector.h>
+
+using namespace Urho3D;
+
+/**
+* Datagrams between a server and clients living in the same process, in place
+* of the UDP socket NetworkThread runs. Every datagram carries a NetMessageType
+* and is copied into one byte queue for the server and one per client, so
+* sending never allocates once the queues have grown to a tick's traffic.
+* Delivery is in order and lossless, the cost measured is the server's and
+* the clients' own.
+*
+* Not thread safe, server and clients run on one thread.
+*/
+class LoopbackTransport {
+public:
+    /// Returns the new client's index.
+    unsigned AddClient();
+
+    unsigned GetNumClients() const { return toClients_.Size(); }
+
+    void SendToServer(unsigned client, unsigned short type, const unsigned char* data, unsigned size);
+
+    void SendToClient(unsigned client, unsigned short type, const unsigned char* data, unsigned size);
+
+    /// Hand every datagram queued for the server to handler(client, type, data, size), oldest first.
+    /// The handler may send to clients but not to the server.
+    template <class Handler> unsigned DrainServer(Handler&& handler) { return Drain(toServer_, handler); }
+
+    /// Hand every datagram queued for client to handler(client, type, data, size), oldest first.
+    /// The handler may send to the server but not to clients.
+    template <class Handler> unsigned DrainClient(unsigned client, Handler&& handler) {
+        return Drain(toClients_[client], handler);
+    }
+
+    unsigned long long GetNumBytesToServer() const { return bytesToServer_; }
+
+    unsigned long long GetNumBytesToClients() const { return bytesToClients_; }
+
+private:
+    /// Precedes each datagram's payload in a queue.
+    struct Header {
+        unsigned client_;
+        unsigned short type_;
+        unsigned size_;
+    };
+
+    static void Push(PODVector<unsigned char>& queue, unsigned client, unsigned short type,
+                     const unsigned char* data, unsigned size);
+
+    template <class Handler> static unsigned Drain(PODVector<unsigned char>& queue, Handler& handler) {
+        unsigned count = 0;
+        for (unsigned offset = 0; offset < queue.Size(); ++count)
+        {
+            Header header;
+            memcpy(&header, queue.Buffer() + offset, sizeof(Header));
+            offset += sizeof(Header);
+            handler(header.client_, header.type_, queue.Buffer() + offset, header.size_);
+            offset += header.size_;
+        }
+        // Keeps its capacity for the next tick
+        queue.Clear();
+        return count;
+    }
+
+    PODVector<unsigned char> toServer_;
+    Vector<PODVector<unsigned char> > toClients_;
+    unsigned long long bytesToServer_ = 0;
+    unsigned long long bytesToClients_ = 0;
+};
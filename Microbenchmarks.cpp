@@ -0,0 +1,1212 @@
+#include "Microbenchmarks.hpp"
+#include "MissilePool.hpp"
+#include "InstancedPopulation.hpp"
+#include "JobSystem.hpp"
+#include "SoaParticleEmitter.hpp"
+#include "SpatialHash.hpp"
+#include "NetworkThread.hpp"
+#include "PoissonScatter.hpp"
+#include "Snapshot.hpp"
+#include "CookedScene.hpp"
+#include "DedicatedServer.hpp"
+#include "EntityRegistry.hpp"
+#include "World.hpp"
+
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Graphics/Camera.h>
+#include <Urho3D/Graphics/Drawable.h>
+#include <Urho3D/Graphics/Geometry.h>
+#include <Urho3D/Graphics/Material.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/Graphics/OcclusionBuffer.h>
+#include <Urho3D/Graphics/Octree.h>
+#include <Urho3D/Graphics/OctreeQuery.h>
+#include <Urho3D/Graphics/StaticModel.h>
+#include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/IO/VectorBuffer.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Math/Random.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace {
+
+Vector3 RandomDirection() {
+    Vector3 direction(Random(2.0f) - 1.0f, Random(2.0f) - 1.0f, Random(2.0f) - 1.0f);
+    return direction.LengthSquared() > M_EPSILON ? direction.Normalized() : Vector3::FORWARD;
+}
+
+/// 100k live missiles integrated on one core; the target is under 1 ms per MoveMissiles.
+void BenchmarkMissiles(Context* context, const BenchmarkSettings& settings, BenchmarkReport& report) {
+    const unsigned NUM_MISSILES = 100000;
+
+    SharedPtr<Scene> scene(new Scene(context));
+    scene->CreateComponent<Octree>();
+    Node* cameraNode = scene->CreateChild("Camera");
+    auto* camera = cameraNode->CreateComponent<Camera>();
+    camera->SetFarClip(300.0f);
+
+    SetRandomSeed(1);
+    MissilePool pool(scene, NUM_MISSILES);
+    for (unsigned i = 0; i < NUM_MISSILES; ++i)
+        pool.CreateMissile(Vector3(Random(90.0f) - 45.0f, Random(20.0f), Random(90.0f) - 45.0f), RandomDirection());
+
+    // Keep every missile alive for the whole run
+    unsigned steps = Min(settings.frames_, (unsigned)(MissilePool::MISSILE_LIFETIME / settings.timeStep_) - 1);
+    HiresTimer timer;
+    for (unsigned i = 0; i < steps; ++i)
+    {
+        timer.Reset();
+        pool.MoveMissiles(settings.timeStep_);
+        report.AddSample("missiles.move_us", timer.GetUSec(false));
+
+        timer.Reset();
+        pool.BindNodes(camera->GetFrustum());
+        report.AddSample("missiles.bind_us", timer.GetUSec(false));
+    }
+
+    report.SetMetric("missiles.live", pool.GetNumMissiles());
+    report.SetMetric("missiles.bound_nodes", pool.GetNumBoundNodes());
+    report.SetMetric("missiles.scene_children", scene->GetNumChildren());
+}
+
+/// Swept missile tests against static boxes as both counts grow, at constant density.
+void BenchmarkCollisions(Context* context, const BenchmarkSettings& settings, BenchmarkReport& report) {
+    const unsigned STEPS = Min(settings.frames_, 120u);
+
+    for (unsigned count : {1000u, 10000u, 40000u})
+    {
+        // Roughly one box per 40 square units, like the boxes around the origin
+        float extent = Sqrt(count * 40.0f) * 0.5f;
+        std::string prefix = "collisions." + std::to_string(count);
+
+        SetRandomSeed(1);
+        SpatialHash grid;
+        HiresTimer timer;
+        for (unsigned i = 0; i < count; ++i)
+        {
+            float size = 1.0f + Random(10.0f);
+            Vector3 center(Random(2 * extent) - extent, size * 0.5f, Random(2 * extent) - extent);
+            grid.InsertStatic(BoundingBox(center - Vector3::ONE * size * 0.5f, center + Vector3::ONE * size * 0.5f));
+        }
+        report.SetMetric(prefix + ".build_ms", timer.GetUSec(false) / 1000.0);
+
+        MissilePool pool(nullptr, count);
+        PODVector<MissileHit> hits;
+        unsigned totalHits = 0;
+        for (unsigned step = 0; step < STEPS; ++step)
+        {
+            // Keep the pool full so every step sweeps the same number of missiles
+            while (pool.GetNumMissiles() < count)
+            {
+                Vector3 position(Random(2 * extent) - extent, 1.0f + Random(20.0f), Random(2 * extent) - extent);
+                pool.CreateMissile(position, RandomDirection());
+            }
+            pool.MoveMissiles(settings.timeStep_);
+
+            hits.Clear();
+            timer.Reset();
+            pool.SweepCollisions(grid, settings.timeStep_, hits);
+            long long elapsed = timer.GetUSec(false);
+            report.AddSample(prefix + ".sweep_us", elapsed);
+            report.AddSample(prefix + ".sweep_ns_per_missile", elapsed * 1000.0 / count);
+            totalHits += hits.Size();
+        }
+        report.SetMetric(prefix + ".hits", totalHits);
+    }
+}
+
+/**
+* Headless missile stress: 100k missiles stepped and swept against 40k boxes through the job system,
+* with 1 thread up to one per hardware thread. Reports the step time and the speedup over 1 thread.
+*/
+void BenchmarkJobs(Context* context, const BenchmarkSettings& settings, BenchmarkReport& report) {
+    const unsigned NUM_MISSILES = 100000;
+    const unsigned NUM_BOXES = 40000;
+    const unsigned STEPS = Min(settings.frames_, 240u);
+
+    float extent = Sqrt(NUM_BOXES * 40.0f) * 0.5f;
+    SetRandomSeed(1);
+    SpatialHash grid;
+    for (unsigned i = 0; i < NUM_BOXES; ++i)
+    {
+        float size = 1.0f + Random(10.0f);
+        Vector3 center(Random(2 * extent) - extent, size * 0.5f, Random(2 * extent) - extent);
+        grid.InsertStatic(BoundingBox(center - Vector3::ONE * size * 0.5f, center + Vector3::ONE * size * 0.5f));
+    }
+
+    unsigned maxThreads = JobSystem::GetDefaultNumWorkers() + 1;
+    PODVector<unsigned> threadCounts;
+    for (unsigned threads = 1; threads < maxThreads; threads *= 2)
+        threadCounts.Push(threads);
+    threadCounts.Push(maxThreads);
+    report.SetMetric("jobs.hardware_threads", maxThreads);
+
+    double singleThreadUs = 0.0;
+    for (unsigned threads : threadCounts)
+    {
+        std::string prefix = "jobs." + std::to_string(threads);
+        JobSystem jobs(threads - 1);
+        JobGraph graph;
+        MissilePool pool(nullptr, NUM_MISSILES);
+        PODVector<MissileHit> hits;
+        // Same missiles for every thread count
+        SetRandomSeed(2);
+
+        HiresTimer timer;
+        long long totalUs = 0;
+        for (unsigned step = 0; step < STEPS; ++step)
+        {
+            while (pool.GetNumMissiles() < NUM_MISSILES)
+            {
+                Vector3 position(Random(2 * extent) - extent, 1.0f + Random(20.0f), Random(2 * extent) - extent);
+                pool.CreateMissile(position, RandomDirection());
+            }
+
+            hits.Clear();
+            graph.Clear();
+            pool.AddStepJobs(graph, grid, settings.timeStep_, hits);
+            timer.Reset();
+            jobs.Run(graph);
+            long long elapsed = timer.GetUSec(false);
+            report.AddSample(prefix + ".step_us", elapsed);
+            totalUs += elapsed;
+        }
+
+        double meanUs = (double)totalUs / STEPS;
+        if (threads == 1)
+            singleThreadUs = meanUs;
+        report.SetMetric(prefix + ".speedup", singleThreadUs / Max(meanUs, 1.0));
+        report.SetMetric(prefix + ".steals", (double)jobs.GetNumSteals());
+        report.SetMetric(prefix + ".jobs_per_step", graph.GetNumJobs());
+    }
+}
+
+/**
+* The Fire.xml effect simulated at 1k/10k/100k live particles by the SoA particle emitter, on the calling
+* thread and split across one job thread per core. Expired particles are topped up by a burst before every
+* step, so each step integrates and writes a full pool of billboards.
+*/
+void BenchmarkParticles(Context* context, const BenchmarkSettings& settings, BenchmarkReport& report) {
+    const unsigned COUNTS[] = {1000, 10000, 100000};
+    const unsigned STEPS = Min(settings.frames_, 240u);
+
+    auto* cache = context->GetSubsystem<ResourceCache>();
+    auto* effect = cache->GetResource<ParticleEffect>("Particle/Fire.xml");
+    if (!effect)
+    {
+        report.SetMetric("particles.error", 1);
+        return;
+    }
+
+    JobSystem jobs(JobSystem::GetDefaultNumWorkers());
+    report.SetMetric("particles.threads", jobs.GetNumThreads());
+
+    for (unsigned count : COUNTS)
+    {
+        double serialUs = 0.0;
+        for (unsigned threaded = 0; threaded < 2; ++threaded)
+        {
+            std::string prefix = "particles." + std::to_string(count) + (threaded ? ".jobs" : ".serial");
+            SharedPtr<Scene> scene(new Scene(context));
+            scene->CreateComponent<Octree>();
+            auto* emitter = scene->CreateChild("Particles")->CreateComponent<SoaParticleEmitter>();
+            emitter->SetEffect(effect);
+            emitter->SetEmitting(false);
+            emitter->SetMaxParticles(count);
+            emitter->SetJobSystem(threaded ? &jobs : nullptr);
+            SetRandomSeed(1);
+
+            HiresTimer timer;
+            long long totalUs = 0;
+            for (unsigned step = 0; step < STEPS; ++step)
+            {
+                emitter->Burst(Vector3::ZERO, count - emitter->GetNumParticles());
+                timer.Reset();
+                emitter->Simulate(settings.timeStep_);
+                long long elapsed = timer.GetUSec(false);
+                report.AddSample(prefix + ".step_us", elapsed);
+                totalUs += elapsed;
+            }
+
+            double meanUs = (double)totalUs / Max(STEPS, 1u);
+            if (!threaded)
+                serialUs = meanUs;
+            report.SetMetric(prefix + ".ns_per_particle", meanUs * 1000.0 / count);
+            report.SetMetric(prefix + ".speedup", serialUs / Max(meanUs, 1.0));
+        }
+    }
+}
+
+/**
+* Drawables, batches, instances and triangles the main camera would submit from fixed positions, with
+* the population LOD bands and draw distances and without them. Counted headless from the octree and
+* the drawables' batches, so the numbers are what the renderer would be handed, not what it measured.
+*/
+void BenchmarkLod(Context* context, const BenchmarkSettings& settings, BenchmarkReport& report) {
+    struct Viewpoint {
+        const char* name_;
+        Vector3 position_;
+        Vector3 lookAt_;
+    };
+    const Viewpoint VIEWPOINTS[] = {
+        {"center", Vector3(0.0f, 10.0f, 0.0f), Vector3(10.0f, 0.0f, 0.0f)},
+        {"edge", Vector3(-60.0f, 15.0f, 0.0f), Vector3(0.0f, 0.0f, 0.0f)},
+        {"mid", Vector3(-130.0f, 25.0f, 0.0f), Vector3(0.0f, 0.0f, 0.0f)},
+        {"far", Vector3(-220.0f, 40.0f, 0.0f), Vector3(0.0f, 0.0f, 0.0f)},
+    };
+
+    for (bool lod : {false, true})
+    {
+        WorldOptions options;
+        options.preload_ = false;
+        options.populationLod_ = lod;
+        World world(context);
+        world.start(options);
+
+        Scene* scene = world.GetScene();
+        auto* octree = scene->GetComponent<Octree>();
+        Node* cameraNode = world.GetCameraNode();
+        auto* camera = cameraNode->GetComponent<Camera>();
+
+        unsigned frameNumber = 1;
+        for (const Viewpoint& viewpoint : VIEWPOINTS)
+        {
+            cameraNode->SetPosition(viewpoint.position_);
+            cameraNode->LookAt(viewpoint.lookAt_);
+
+            FrameInfo frame;
+            frame.frameNumber_ = frameNumber++;
+            frame.timeStep_ = settings.timeStep_;
+            frame.viewSize_ = IntVector2(1920, 1080);
+            frame.camera_ = camera;
+            octree->Update(frame);
+
+            PODVector<Drawable*> drawables;
+            FrustumOctreeQuery query(drawables, camera->GetFrustum(), DRAWABLE_GEOMETRY, camera->GetViewMask());
+            octree->GetDrawables(query);
+
+            unsigned numDrawables = 0, numBatches = 0;
+            double numInstances = 0.0, numTriangles = 0.0;
+            for (Drawable* drawable : drawables)
+            {
+                drawable->UpdateBatches(frame);
+                bool submitted = false;
+                for (const SourceBatch& batch : drawable->GetBatches())
+                {
+                    if (!batch.geometry_ || !batch.numWorldTransforms_)
+                        continue;
+                    submitted = true;
+                    ++numBatches;
+                    numInstances += batch.numWorldTransforms_;
+                    numTriangles += batch.numWorldTransforms_ * (batch.geometry_->GetIndexCount() / 3.0);
+                }
+                if (submitted)
+                    ++numDrawables;
+            }
+
+            std::string prefix = std::string("lod.") + (lod ? "on." : "off.") + viewpoint.name_;
+            report.SetMetric(prefix + ".drawables", numDrawables);
+            report.SetMetric(prefix + ".batches", numBatches);
+            report.SetMetric(prefix + ".instances", numInstances);
+            report.SetMetric(prefix + ".triangles", numTriangles);
+        }
+
+        // Cost of the per-instance band selection itself, from the center viewpoint
+        cameraNode->SetPosition(VIEWPOINTS[0].position_);
+        cameraNode->LookAt(VIEWPOINTS[0].lookAt_);
+        PODVector<InstancedPopulation*> populations;
+        scene->GetComponents<InstancedPopulation>(populations, true);
+        FrameInfo frame;
+        frame.camera_ = camera;
+        frame.viewSize_ = IntVector2(1920, 1080);
+        HiresTimer timer;
+        for (unsigned i = 0; i < Min(settings.frames_, 200u); ++i)
+        {
+            frame.frameNumber_ = frameNumber++;
+            timer.Reset();
+            for (InstancedPopulation* population : populations)
+                population->UpdateBatches(frame);
+            report.AddSample(std::string("lod.") + (lod ? "on" : "off") + ".update_batches_us", timer.GetUSec(false));
+        }
+    }
+}
+
+/**
+* A dense field of boxes and mushrooms seen from eye height. Occluders are either every box of size 3
+* and up (the old fixed rule) or the boxes covering the most screen within a triangle budget. Each
+* mode draws its occluders into a software occlusion buffer the size the renderer uses, then tests
+* every mushroom and box in the frustum against it, the way the renderer culls drawables.
+*/
+void BenchmarkOcclusion(Context* context, const BenchmarkSettings& settings, BenchmarkReport& report) {
+    const unsigned NUM_BOXES = 4000;
+    const unsigned NUM_MUSHROOMS = 20000;
+    const unsigned BUDGET = 1200;
+    const float EXTENT = 200.0f;
+    const unsigned REPEATS = Min(settings.frames_, 50u);
+
+    auto* cache = context->GetSubsystem<ResourceCache>();
+    Model* boxModel = cache->GetResource<Model>("Models/Box.mdl");
+    Model* mushroomModel = cache->GetResource<Model>("Models/Mushroom.mdl");
+
+    SharedPtr<Scene> scene(new Scene(context));
+    scene->CreateComponent<Octree>();
+    Node* cameraNode = scene->CreateChild("Camera");
+    auto* camera = cameraNode->CreateComponent<Camera>();
+    camera->SetFarClip(300.0f);
+
+    // Fixed splits the boxes by size, adaptive holds them all
+    auto* smallBoxes = scene->CreateChild("Boxes")->CreateComponent<InstancedPopulation>();
+    auto* bigBoxes = scene->CreateChild("OccluderBoxes")->CreateComponent<InstancedPopulation>();
+    auto* allBoxes = scene->CreateChild("AllBoxes")->CreateComponent<InstancedPopulation>();
+    auto* mushrooms = scene->CreateChild("Mushrooms")->CreateComponent<InstancedPopulation>();
+    for (InstancedPopulation* boxes : {smallBoxes, bigBoxes, allBoxes})
+        boxes->SetModel(boxModel);
+    mushrooms->SetModel(mushroomModel);
+    allBoxes->SetOccluderBudget(BUDGET);
+
+    SetRandomSeed(1);
+    for (unsigned i = 0; i < NUM_BOXES; ++i)
+    {
+        float size = 1.0f + Random(10.0f);
+        Vector3 position(Random(2 * EXTENT) - EXTENT, size * 0.5f, Random(2 * EXTENT) - EXTENT);
+        (size >= 3.0f ? bigBoxes : smallBoxes)->AddInstance(position, Quaternion::IDENTITY, Vector3::ONE * size);
+        allBoxes->AddInstance(position, Quaternion::IDENTITY, Vector3::ONE * size);
+    }
+    for (unsigned i = 0; i < NUM_MUSHROOMS; ++i)
+    {
+        Vector3 position(Random(2 * EXTENT) - EXTENT, 0.0f, Random(2 * EXTENT) - EXTENT);
+        mushrooms->AddInstance(position, Quaternion(0.0f, Random(360.0f), 0.0f), Vector3::ONE * (0.5f + Random(2.0f)));
+    }
+
+    OcclusionBuffer buffer(context);
+    buffer.SetSize(256, 144, false);
+
+    const Vector3 VIEWPOINTS[] = {Vector3(0.0f, 2.0f, 0.0f), Vector3(-150.0f, 2.0f, -150.0f), Vector3(100.0f, 6.0f, -50.0f)};
+    for (bool adaptive : {false, true})
+    {
+        std::string prefix = std::string("occlusion.") + (adaptive ? "adaptive" : "fixed");
+        InstancedPopulation* occluders = adaptive ? allBoxes : bigBoxes;
+        long long totalRejected = 0;
+        HiresTimer timer;
+
+        for (unsigned view = 0; view < sizeof(VIEWPOINTS) / sizeof(VIEWPOINTS[0]); ++view)
+        {
+            cameraNode->SetPosition(VIEWPOINTS[view]);
+            cameraNode->LookAt(Vector3(VIEWPOINTS[view].x_ + 50.0f, 0.0f, VIEWPOINTS[view].z_ + 50.0f));
+            const Frustum& frustum = camera->GetFrustum();
+            buffer.SetView(camera);
+            buffer.SetMaxTriangles(5000);
+
+            unsigned tested = 0, rejected = 0;
+            for (unsigned repeat = 0; repeat < REPEATS; ++repeat)
+            {
+                timer.Reset();
+                buffer.Reset();
+                occluders->DrawOcclusion(&buffer);
+                buffer.DrawTriangles();
+                buffer.BuildDepthHierarchy();
+                report.AddSample(prefix + ".draw_us", timer.GetUSec(true));
+
+                // Occludees are the same for both modes: every box and mushroom in the frustum
+                tested = rejected = 0;
+                for (InstancedPopulation* population : {mushrooms, smallBoxes, bigBoxes})
+                {
+                    for (unsigned i = 0; i < population->GetNumInstances(); ++i)
+                    {
+                        BoundingBox box = population->GetInstanceBoundingBox(i);
+                        if (frustum.IsInsideFast(box) == OUTSIDE)
+                            continue;
+                        ++tested;
+                        if (!buffer.IsVisible(box))
+                            ++rejected;
+                    }
+                }
+                report.AddSample(prefix + ".test_us", timer.GetUSec(false));
+            }
+
+            std::string viewPrefix = prefix + ".view" + std::to_string(view);
+            report.SetMetric(viewPrefix + ".occluders", occluders->GetNumOccludersDrawn());
+            report.SetMetric(viewPrefix + ".triangles", buffer.GetNumTriangles());
+            report.SetMetric(viewPrefix + ".tested", tested);
+            report.SetMetric(viewPrefix + ".rejected", rejected);
+            totalRejected += rejected;
+        }
+        report.SetMetric(prefix + ".rejected_total", (double)totalRejected);
+    }
+}
+
+/**
+* Two network threads talking over loopback UDP. The receiving side is drained either continuously or
+* once per 60 Hz frame; wire latency (send to decode on the network thread) should not depend on
+* which, only the time messages wait in the queue for the game thread should.
+*/
+void BenchmarkNetwork(Context* context, const BenchmarkSettings& settings, BenchmarkReport& report) {
+    const unsigned NUM_MESSAGES = 100000;
+
+    for (bool framePaced : {false, true})
+    {
+        std::string prefix = framePaced ? "network.frame_drain" : "network.spin_drain";
+
+        NetworkThread sender, receiver;
+        if (!sender.Start(0) || !receiver.Start(0))
+        {
+            report.AddEvent("network: could not open loopback sockets");
+            return;
+        }
+        sender.SetRemote("127.0.0.1", receiver.GetLocalPort());
+
+        // The consumer stands in for the game thread of the receiving side
+        std::atomic<bool> sending(true);
+        std::vector<long long> wireLatency, queueLatency;
+        wireLatency.reserve(NUM_MESSAGES);
+        queueLatency.reserve(NUM_MESSAGES);
+        std::thread consumer([&]() {
+            auto drain = [&]() {
+                long long now = NetworkClockUs();
+                receiver.Drain([&](const NetMessage& message) {
+                    long long sentUs;
+                    memcpy(&sentUs, message.data_, sizeof(sentUs));
+                    wireLatency.push_back(message.receivedUs_ - sentUs);
+                    queueLatency.push_back(now - message.receivedUs_);
+                });
+            };
+            while (sending.load())
+            {
+                drain();
+                if (framePaced)
+                    std::this_thread::sleep_for(std::chrono::microseconds(16667));
+            }
+            // Collect stragglers still in flight
+            for (int i = 0; i < 10; ++i)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                drain();
+            }
+        });
+
+        long long start = NetworkClockUs();
+        NetMessage message;
+        message.type_ = NET_MSG_PING;
+        message.size_ = 64;
+        memset(message.data_, 0, message.size_);
+        for (unsigned i = 0; i < NUM_MESSAGES; ++i)
+        {
+            long long now = NetworkClockUs();
+            memcpy(message.data_, &now, sizeof(now));
+            while (!sender.Send(message))
+                std::this_thread::yield();
+            // Bursts of 64 keep the kernel receive buffer from overflowing
+            if (i % 64 == 63)
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+        long long sendElapsed = NetworkClockUs() - start;
+        sending.store(false);
+        consumer.join();
+
+        for (long long latency : wireLatency)
+            report.AddSample(prefix + ".wire_latency_us", latency);
+        for (long long latency : queueLatency)
+            report.AddSample(prefix + ".queue_latency_us", latency);
+        report.SetMetric(prefix + ".delivered", wireLatency.size());
+        report.SetMetric(prefix + ".lost", NUM_MESSAGES - wireLatency.size());
+        report.SetMetric(prefix + ".dropped_inbound", receiver.GetNumDroppedInbound());
+        report.SetMetric(prefix + ".throughput_msgs_per_s", wireLatency.size() * 1e6 / Max(sendElapsed, 1ll));
+    }
+}
+
+/**
+* Missile replication to clients with different round trip times and loss, with no real network in
+* between: packets and acks go through delay queues. Every client must end up with exactly the server's
+* quantized state, and the bytes per client are compared with sending full snapshots.
+*/
+void BenchmarkReplication(Context* context, const BenchmarkSettings& settings, BenchmarkReport& report) {
+    struct ClientProfile {
+        const char* name_;
+        unsigned roundTripTicks_;
+        float loss_;
+    };
+    const ClientProfile PROFILES[] = {{"lan", 2, 0.0f}, {"wan", 6, 0.0f}, {"lossy", 6, 0.1f}};
+    const unsigned NUM_PROFILES = sizeof(PROFILES) / sizeof(PROFILES[0]);
+    const unsigned TICKS = Min(settings.frames_, 600u);
+
+    for (unsigned count : {1000u, 10000u})
+    {
+        std::string prefix = "replication." + std::to_string(count);
+        float extent = Sqrt(count * 40.0f) * 0.5f;
+
+        SetRandomSeed(1);
+        MissilePool pool(nullptr, count);
+        ReplicationServer server(MissilePool::MISSILE_SPEED);
+
+        struct InFlight {
+            unsigned deliverTick_;
+            unsigned sequence_;
+        };
+        std::vector<ReplicationClient> clients(NUM_PROFILES, ReplicationClient(MissilePool::MISSILE_SPEED));
+        std::vector<std::deque<InFlight> > acks(NUM_PROFILES);
+        std::vector<unsigned long long> bytesSent(NUM_PROFILES, 0);
+        for (unsigned i = 0; i < NUM_PROFILES; ++i)
+            server.AddClient();
+
+        Snapshot snapshot;
+        PODVector<unsigned char> packet, fullPacket;
+        unsigned long long fullBytes = 0;
+        unsigned mismatches = 0;
+        double timeUs = 0.0;
+        HiresTimer timer;
+        for (unsigned tick = 0; tick < TICKS; ++tick)
+        {
+            while (pool.GetNumMissiles() < count)
+            {
+                Vector3 position(Random(2 * extent) - extent, 1.0f + Random(20.0f), Random(2 * extent) - extent);
+                pool.CreateMissile(position, RandomDirection());
+            }
+            pool.MoveMissiles(settings.timeStep_);
+            timeUs += settings.timeStep_ * 1e6;
+
+            timer.Reset();
+            snapshot.timeUs_ = (unsigned)timeUs;
+            pool.CaptureSnapshot(snapshot);
+            server.Capture(snapshot);
+            report.AddSample(prefix + ".capture_us", timer.GetUSec(false));
+
+            SnapshotCodec::Encode(*server.GetSnapshot(snapshot.sequence_), nullptr, MissilePool::MISSILE_SPEED, fullPacket);
+            fullBytes += fullPacket.Size();
+
+            for (unsigned i = 0; i < NUM_PROFILES; ++i)
+            {
+                const ClientProfile& profile = PROFILES[i];
+                std::string clientPrefix = prefix + "." + profile.name_;
+
+                while (!acks[i].empty() && acks[i].front().deliverTick_ <= tick)
+                {
+                    server.Acknowledge(i, acks[i].front().sequence_);
+                    acks[i].pop_front();
+                }
+
+                timer.Reset();
+                server.BuildPacket(i, packet);
+                report.AddSample(clientPrefix + ".encode_us", timer.GetUSec(false));
+                report.AddSample(clientPrefix + ".bytes_per_snapshot", packet.Size());
+                bytesSent[i] += packet.Size();
+
+                if (profile.loss_ > 0.0f && Random(1.0f) < profile.loss_)
+                    continue;
+
+                timer.Reset();
+                unsigned ack;
+                if (!clients[i].Receive(packet.Buffer(), packet.Size(), ack))
+                {
+                    ++mismatches;
+                    continue;
+                }
+                report.AddSample(clientPrefix + ".decode_us", timer.GetUSec(false));
+
+                const Snapshot* expected = server.GetSnapshot(ack);
+                const Snapshot& decoded = clients[i].GetLatest();
+                if (decoded.entities_.Size() != expected->entities_.Size() ||
+                    !std::equal(decoded.entities_.Buffer(), decoded.entities_.Buffer() + decoded.entities_.Size(),
+                                expected->entities_.Buffer()))
+                    ++mismatches;
+
+                acks[i].push_back({tick + profile.roundTripTicks_, ack});
+            }
+        }
+
+        double seconds = TICKS * settings.timeStep_;
+        report.SetMetric(prefix + ".full_kbit_per_s", fullBytes * 8.0 / 1000.0 / seconds);
+        for (unsigned i = 0; i < NUM_PROFILES; ++i)
+            report.SetMetric(prefix + "." + PROFILES[i].name_ + ".kbit_per_s", bytesSent[i] * 8.0 / 1000.0 / seconds);
+        report.SetMetric(prefix + ".mismatches", mismatches);
+    }
+}
+
+/**
+* Startup cost of the scene content: building it procedurally through World, loading the same scenes
+* from Urho3D's XML and binary formats, and instantiating them from a memory-mapped cooked file.
+* Only the scenes are timed, not the UI or controllers World sets up around them.
+*/
+void BenchmarkSceneLoad(Context* context, const BenchmarkSettings& settings, BenchmarkReport& report) {
+    const unsigned REPEATS = Min(settings.frames_, 20u);
+    String cookedPath = String(settings.output_.c_str()) + ".cooked";
+
+    WorldOptions options;
+    options.preload_ = false;
+    VectorBuffer xml[2], binary[2];
+    for (unsigned i = 0; i < REPEATS; ++i)
+    {
+        World world(context);
+        world.start(options);
+        report.AddSample("sceneload.procedural_ms", world.GetSceneBuildMs());
+
+        if (i == 0)
+        {
+            Scene* scenes[2] = {world.GetScene(), world.GetOverlayScene()};
+            for (unsigned j = 0; j < 2; ++j)
+            {
+                scenes[j]->SaveXML(xml[j]);
+                scenes[j]->Save(binary[j]);
+            }
+            if (!world.CookScene(cookedPath))
+            {
+                report.AddEvent("sceneload: could not write " + std::string(cookedPath.CString()));
+                return;
+            }
+        }
+    }
+    report.SetMetric("sceneload.xml_bytes", xml[0].GetSize() + xml[1].GetSize());
+    report.SetMetric("sceneload.binary_bytes", binary[0].GetSize() + binary[1].GetSize());
+
+    HiresTimer timer;
+    for (bool useXml : {true, false})
+    {
+        VectorBuffer* sources = useXml ? xml : binary;
+        for (unsigned i = 0; i < REPEATS; ++i)
+        {
+            SharedPtr<Scene> scenes[2] = {SharedPtr<Scene>(new Scene(context)), SharedPtr<Scene>(new Scene(context))};
+            timer.Reset();
+            for (unsigned j = 0; j < 2; ++j)
+            {
+                MemoryBuffer source(sources[j].GetData(), sources[j].GetSize());
+                if (useXml)
+                    scenes[j]->LoadXML(source);
+                else
+                    scenes[j]->Load(source);
+            }
+            report.AddSample(useXml ? "sceneload.xml_ms" : "sceneload.binary_ms", timer.GetUSec(false) / 1000.0);
+        }
+    }
+
+    for (unsigned i = 0; i < REPEATS; ++i)
+    {
+        SharedPtr<Scene> scenes[2] = {SharedPtr<Scene>(new Scene(context)), SharedPtr<Scene>(new Scene(context))};
+        timer.Reset();
+        CookedScene cooked;
+        bool loaded = cooked.Open(cookedPath);
+        report.AddSample("sceneload.cooked_open_us", timer.GetUSec(false));
+        loaded = loaded && cooked.Instantiate(0, scenes[0]) && cooked.Instantiate(1, scenes[1]);
+        report.AddSample("sceneload.cooked_ms", timer.GetUSec(false) / 1000.0);
+        if (!loaded)
+        {
+            report.AddEvent("sceneload: could not instantiate the cooked scene");
+            return;
+        }
+        report.SetMetric("sceneload.cooked_bytes", cooked.GetSize());
+    }
+}
+
+/// Camera looking across the populated square from one corner, as a stand-in for a view.
+Camera* CreateBenchmarkCamera(Scene* scene, float extent) {
+    Node* cameraNode = scene->CreateChild("Camera");
+    cameraNode->SetPosition(Vector3(-extent, 10.0f, -extent));
+    cameraNode->LookAt(Vector3::ZERO);
+    auto* camera = cameraNode->CreateComponent<Camera>();
+    camera->SetFarClip(300.0f);
+    return camera;
+}
+
+FrameInfo CreateFrameInfo(Camera* camera, unsigned frameNumber, float timeStep) {
+    FrameInfo frame;
+    frame.frameNumber_ = frameNumber;
+    frame.timeStep_ = timeStep;
+    frame.camera_ = camera;
+    frame.viewSize_ = IntVector2(1920, 1080);
+    return frame;
+}
+
+/// Node-per-instance StaticModels against one InstancedPopulation, at increasing density.
+void BenchmarkPopulation(Context* context, const BenchmarkSettings& settings, BenchmarkReport& report) {
+    auto* cache = context->GetSubsystem<ResourceCache>();
+    Model* model = cache->GetResource<Model>("Models/Mushroom.mdl");
+    Material* material = cache->GetResource<Material>("Materials/Mushroom.xml");
+    const unsigned FRAMES = Min(settings.frames_, 200u);
+
+    for (unsigned count : {1000u, 10000u, 100000u})
+    {
+        // Keep density constant so culling sees comparable layouts at every size
+        float extent = 45.0f * Sqrt(count / 240.0f);
+
+        for (bool instanced : {false, true})
+        {
+            std::string prefix = std::string("population.") + (instanced ? "instanced." : "nodes.") + std::to_string(count);
+            unsigned long long memoryBefore = GetResidentMemory();
+            HiresTimer timer;
+
+            SharedPtr<Scene> scene(new Scene(context));
+            auto* octree = scene->CreateComponent<Octree>();
+            Camera* camera = CreateBenchmarkCamera(scene, extent);
+
+            SetRandomSeed(1);
+            InstancedPopulation* population = nullptr;
+            if (instanced)
+            {
+                population = scene->CreateChild("Mushrooms")->CreateComponent<InstancedPopulation>();
+                population->SetModel(model);
+                population->SetMaterial(material);
+                population->Reserve(count);
+            }
+            for (unsigned i = 0; i < count; ++i)
+            {
+                Vector3 position(Random(2 * extent) - extent, 0.0f, Random(2 * extent) - extent);
+                Quaternion rotation(0.0f, Random(360.0f), 0.0f);
+                float scale = 0.5f + Random(2.0f);
+                if (instanced)
+                    population->AddInstance(position, rotation, Vector3::ONE * scale);
+                else
+                {
+                    Node* node = scene->CreateChild("Mushroom");
+                    node->SetTransform(position, rotation, scale);
+                    auto* object = node->CreateComponent<StaticModel>();
+                    object->SetModel(model);
+                    object->SetMaterial(material);
+                }
+            }
+            octree->Update(CreateFrameInfo(camera, 0, settings.timeStep_));
+            report.SetMetric(prefix + ".build_ms", timer.GetUSec(false) / 1000.0);
+            report.SetMetric(prefix + ".nodes", scene->GetNumChildren(true));
+            report.SetMetric(prefix + ".resident_kb", (double)(GetResidentMemory() - memoryBefore) / 1024.0);
+
+            // Per frame: octree update, frustum query and batch preparation of whatever survived
+            PODVector<Drawable*> drawables;
+            unsigned visible = 0;
+            for (unsigned frameNumber = 1; frameNumber <= FRAMES; ++frameNumber)
+            {
+                FrameInfo frame = CreateFrameInfo(camera, frameNumber, settings.timeStep_);
+                timer.Reset();
+                octree->Update(frame);
+                drawables.Clear();
+                FrustumOctreeQuery query(drawables, camera->GetFrustum(), DRAWABLE_GEOMETRY);
+                octree->GetDrawables(query);
+                visible = 0;
+                for (Drawable* drawable : drawables)
+                {
+                    drawable->UpdateBatches(frame);
+                    visible += drawable == population ? population->GetNumVisibleInstances() : 1;
+                }
+                report.AddSample(prefix + ".update_us", timer.GetUSec(false));
+            }
+            report.SetMetric(prefix + ".visible", visible);
+        }
+    }
+}
+
+/**
+* About a million boxes and mushrooms blue noise scattered over 2400x2400 units, the mushrooms thinned by
+* a density map, with 1 thread up to one per hardware thread. Every run and thread count has to produce the
+* same placements; scatter.hash can be compared between processes and builds to check it across runs too.
+*/
+void BenchmarkScatter(Context* context, const BenchmarkSettings& settings, BenchmarkReport& report) {
+    const float SIDE = 2400.0f;
+    const unsigned RUNS = Clamp(settings.frames_, 1u, 5u);
+
+    // Rolling meadows of mushrooms, from bare ground to full density
+    DensityMap meadows(64, 64);
+    for (unsigned y = 0; y < meadows.GetHeight(); ++y)
+    {
+        for (unsigned x = 0; x < meadows.GetWidth(); ++x)
+            meadows.SetValue(x, y, 0.5f + 0.5f * Sin(x * 17.0f) * Cos(y * 11.0f));
+    }
+
+    ScatterCategory boxes;
+    boxes.radius_ = 0.71f;
+    boxes.candidatesPerUnit2_ = 0.004f;
+    boxes.minScale_ = 1.0f;
+    boxes.maxScale_ = 6.0f;
+    ScatterCategory mushrooms;
+    mushrooms.radius_ = 0.3f;
+    mushrooms.candidatesPerUnit2_ = 0.6f;
+    mushrooms.minScale_ = 0.5f;
+    mushrooms.maxScale_ = 2.5f;
+    mushrooms.density_ = &meadows;
+
+    unsigned maxThreads = JobSystem::GetDefaultNumWorkers() + 1;
+    PODVector<unsigned> threadCounts;
+    for (unsigned threads = 1; threads < maxThreads; threads *= 2)
+        threadCounts.Push(threads);
+    threadCounts.Push(maxThreads);
+    report.SetMetric("scatter.hardware_threads", maxThreads);
+
+    unsigned expectedHash = 0;
+    bool deterministic = true;
+    double singleThreadMs = 0.0;
+    for (unsigned threads : threadCounts)
+    {
+        std::string prefix = "scatter." + std::to_string(threads);
+        JobSystem jobs(threads - 1);
+        double totalMs = 0.0;
+        for (unsigned run = 0; run < RUNS; ++run)
+        {
+            PoissonScatter scatter;
+            scatter.SetArea(Rect(-SIDE * 0.5f, -SIDE * 0.5f, SIDE * 0.5f, SIDE * 0.5f));
+            scatter.SetSeed(1);
+            unsigned boxCategory = scatter.AddCategory(boxes);
+            unsigned mushroomCategory = scatter.AddCategory(mushrooms);
+
+            HiresTimer timer;
+            scatter.Generate(&jobs);
+            double elapsedMs = timer.GetUSec(false) / 1000.0;
+            report.AddSample(prefix + ".generate_ms", elapsedMs);
+            totalMs += elapsedMs;
+
+            unsigned hash = scatter.GetHash();
+            if (threads == 1 && run == 0)
+            {
+                expectedHash = hash;
+                report.SetMetric("scatter.placements", scatter.GetNumPlacements());
+                report.SetMetric("scatter.boxes", scatter.GetPlacements(boxCategory).Size());
+                report.SetMetric("scatter.mushrooms", scatter.GetPlacements(mushroomCategory).Size());
+                report.SetMetric("scatter.tiles", scatter.GetNumTiles(mushroomCategory));
+            }
+            else if (hash != expectedHash)
+                deterministic = false;
+        }
+
+        double meanMs = totalMs / RUNS;
+        if (threads == 1)
+            singleThreadMs = meanMs;
+        report.SetMetric(prefix + ".speedup", singleThreadMs / Max(meanMs, 0.001));
+    }
+
+    report.SetMetric("scatter.hash", expectedHash);
+    report.SetMetric("scatter.deterministic", deterministic ? 1 : 0);
+    if (!deterministic)
+        URHO3D_LOGERROR("Scatter produced different placements between runs or thread counts");
+}
+
+/**
+* The dedicated server with 1 up to 256 simulated clients, each firing 4 missiles a second into the field
+* and decoding and acknowledging a delta snapshot every tick. Reports the server's tick time and its cost
+* per client, with the clients' own work apart, once the missiles in flight have levelled off.
+*/
+void BenchmarkServer(Context* context, const BenchmarkSettings& settings, BenchmarkReport& report) {
+    const unsigned TICKS = Min(settings.frames_, 600u);
+    // Missiles live until they hit something, about a second and a half, before that the load still grows
+    const unsigned WARMUP_TICKS = Max(settings.warmupFrames_, 120u);
+
+    WorldOptions worldOptions;
+    worldOptions.tickRate_ = 1.0f / settings.timeStep_;
+    for (unsigned numClients : {1u, 4u, 16u, 64u, 256u})
+    {
+        std::string prefix = "server." + std::to_string(numClients);
+        ServerOptions options;
+        options.numClients_ = numClients;
+
+        SharedPtr<DedicatedServer> server(new DedicatedServer(context));
+        server->Start(worldOptions, options);
+        for (unsigned tick = 0; tick < WARMUP_TICKS; ++tick)
+            server->Tick();
+
+        unsigned long long bytesBefore = server->GetTransport().GetNumBytesToClients();
+        unsigned long long commandsBefore = server->GetNumCommands();
+        double serverUs = 0.0;
+        double clientsUs = 0.0;
+        double missiles = 0.0;
+        for (unsigned tick = 0; tick < TICKS; ++tick)
+        {
+            server->Tick();
+            const ServerTickTimings& timings = server->GetTickTimings();
+            long long tickServerUs = timings.tickUs_ - timings.clientsUs_;
+            report.AddSample(prefix + ".tick_us", (double)timings.tickUs_);
+            report.AddSample(prefix + ".server_us", (double)tickServerUs);
+            report.AddSample(prefix + ".commands_us", (double)timings.commandsUs_);
+            report.AddSample(prefix + ".simulation_us", (double)timings.simulationUs_);
+            report.AddSample(prefix + ".replication_us", (double)timings.replicationUs_);
+            report.AddSample(prefix + ".clients_us", (double)timings.clientsUs_);
+            serverUs += tickServerUs;
+            clientsUs += timings.clientsUs_;
+            missiles += server->GetNumMissiles();
+        }
+
+        double seconds = TICKS * settings.timeStep_;
+        unsigned long long bytes = server->GetTransport().GetNumBytesToClients() - bytesBefore;
+        report.SetMetric(prefix + ".server_us_per_client", serverUs / TICKS / numClients);
+        report.SetMetric(prefix + ".client_us_per_client", clientsUs / TICKS / numClients);
+        report.SetMetric(prefix + ".missiles", missiles / TICKS);
+        report.SetMetric(prefix + ".commands_per_s", (server->GetNumCommands() - commandsBefore) / seconds);
+        report.SetMetric(prefix + ".kbit_per_s_per_client", bytes * 8.0 / 1000.0 / seconds / numClients);
+        report.SetMetric(prefix + ".decode_failures", server->GetNumDecodeFailures());
+    }
+}
+
+/**
+* 100 to 400 simulated clients spread over 1600x1600 units, each firing into its own patch, replicated once
+* to everyone and once through the interest manager with the default 1200 byte budget per client. Reports the
+* snapshot bytes each client is sent and the server's replication cost, per client and per tick.
+*/
+void BenchmarkInterest(Context* context, const BenchmarkSettings& settings, BenchmarkReport& report) {
+    const unsigned TICKS = Min(settings.frames_, 300u);
+    const unsigned WARMUP_TICKS = Max(settings.warmupFrames_, 120u);
+
+    WorldOptions worldOptions;
+    worldOptions.tickRate_ = 1.0f / settings.timeStep_;
+    for (unsigned numClients : {100u, 200u, 400u})
+    {
+        for (bool interest : {false, true})
+        {
+            std::string prefix = "interest." + std::to_string(numClients) + (interest ? ".interest" : ".broadcast");
+            ServerOptions options;
+            options.numClients_ = numClients;
+            options.clientArea_ = 1600.0f;
+            options.interest_ = interest;
+
+            SharedPtr<DedicatedServer> server(new DedicatedServer(context));
+            server->Start(worldOptions, options);
+            for (unsigned tick = 0; tick < WARMUP_TICKS; ++tick)
+                server->Tick();
+
+            unsigned long long bytesBefore = server->GetTransport().GetNumBytesToClients();
+            double replicationUs = 0.0;
+            double serverUs = 0.0;
+            double missiles = 0.0;
+            double sent = 0.0;
+            double dropped = 0.0;
+            for (unsigned tick = 0; tick < TICKS; ++tick)
+            {
+                server->Tick();
+                const ServerTickTimings& timings = server->GetTickTimings();
+                report.AddSample(prefix + ".replication_us", (double)timings.replicationUs_);
+                report.AddSample(prefix + ".server_us", (double)(timings.tickUs_ - timings.clientsUs_));
+                replicationUs += timings.replicationUs_;
+                serverUs += timings.tickUs_ - timings.clientsUs_;
+                missiles += server->GetNumMissiles();
+                if (const InterestManager* manager = server->GetInterestManager())
+                {
+                    for (unsigned i = 0; i < numClients; ++i)
+                    {
+                        sent += manager->GetNumSent(i);
+                        dropped += manager->GetNumDropped(i);
+                    }
+                }
+                else
+                    sent += (double)server->GetNumMissiles() * numClients;
+            }
+
+            unsigned long long bytes = server->GetTransport().GetNumBytesToClients() - bytesBefore;
+            double clientTicks = (double)TICKS * numClients;
+            report.SetMetric(prefix + ".bytes_per_client_tick", bytes / clientTicks);
+            report.SetMetric(prefix + ".kbit_per_s_per_client", bytes * 8.0 / 1000.0 / (TICKS * settings.timeStep_) / numClients);
+            report.SetMetric(prefix + ".replication_us_per_client", replicationUs / clientTicks);
+            report.SetMetric(prefix + ".server_us_per_client", serverUs / clientTicks);
+            report.SetMetric(prefix + ".missiles", missiles / TICKS);
+            report.SetMetric(prefix + ".entities_per_client", sent / clientTicks);
+            report.SetMetric(prefix + ".dropped_per_client", dropped / clientTicks);
+            report.SetMetric(prefix + ".decode_failures", server->GetNumDecodeFailures());
+            if (const InterestManager* manager = server->GetInterestManager())
+                report.SetMetric(prefix + ".over_budget", (double)manager->GetNumOverBudget());
+        }
+    }
+}
+
+/**
+* Single section edits of the world config applied to a built World, against building the whole world with
+* start. Every edit is undone before the next, so each one starts from the default world. Reports each edit's
+* apply time and its share of the start time.
+*/
+void BenchmarkReload(Context* context, const BenchmarkSettings& settings, BenchmarkReport& report) {
+    const unsigned REPEATS = Min(settings.frames_, 20u);
+
+    WorldOptions options;
+    options.preload_ = false;
+    double startMs = 0.0;
+    for (unsigned i = 0; i < REPEATS; ++i)
+    {
+        World world(context);
+        world.start(options);
+        report.AddSample("reload.start_ms", world.GetStartupMs());
+        startMs += world.GetStartupMs();
+    }
+    startMs /= REPEATS;
+
+    World world(context);
+    world.start(options);
+    const WorldConfig base = world.GetConfig();
+    const char* names[] = {"zone", "sun", "camera", "spotlight", "fire", "ground", "mushrooms", "boxes", "all"};
+    WorldConfig edits[9] = {base, base, base, base, base, base, base, base, base};
+    edits[0].fogStart_ = 80.0f;
+    edits[0].fogEnd_ = 250.0f;
+    edits[1].sunDirection_ = Vector3(-0.6f, -1.0f, 0.4f);
+    edits[2].farClip_ = 250.0f;
+    edits[3].spotColor_ = Color(1.0f, 0.6f, 0.6f);
+    edits[4].fireParticles_ = 200;
+    edits[5].groundSize_ = 120.0f;
+    edits[6].mushrooms_.candidatesPerUnit2_ *= 2.0f;
+    edits[7].boxes_.maxScale_ = 6.0f;
+    // Every edit at once
+    edits[8].fogStart_ = edits[0].fogStart_;
+    edits[8].fogEnd_ = edits[0].fogEnd_;
+    edits[8].sunDirection_ = edits[1].sunDirection_;
+    edits[8].farClip_ = edits[2].farClip_;
+    edits[8].spotColor_ = edits[3].spotColor_;
+    edits[8].fireParticles_ = edits[4].fireParticles_;
+    edits[8].groundSize_ = edits[5].groundSize_;
+    edits[8].mushrooms_ = edits[6].mushrooms_;
+    edits[8].boxes_ = edits[7].boxes_;
+
+    HiresTimer timer;
+    for (unsigned i = 0; i < 9; ++i)
+    {
+        std::string name = std::string("reload.") + names[i];
+        double applyMs = 0.0;
+        for (unsigned j = 0; j < REPEATS; ++j)
+        {
+            timer.Reset();
+            world.ApplyConfig(edits[i]);
+            double ms = timer.GetUSec(false) / 1000.0;
+            report.AddSample(name + "_ms", ms);
+            applyMs += ms;
+            world.ApplyConfig(base);
+        }
+        report.SetMetric(name + "_of_start", applyMs / REPEATS / startMs);
+    }
+}
+
+/**
+* 10k and 50k named children of one node, each with a StaticModel, looked up at random by name, by a name hash
+* computed ahead and by EntityRegistry handle, and every StaticModel gathered from the scene against iterating
+* the registry's view. Reports nanoseconds per lookup and per component, and checks that the handles of removed
+* children resolve to nothing, also once their slots are reused.
+*/
+void BenchmarkHandles(Context* context, const BenchmarkSettings& settings, BenchmarkReport& report) {
+    const unsigned REPEATS = Min(settings.frames_, 20u);
+    // A name lookup scans the children, so far fewer of them fit in the same time
+    const unsigned NAME_LOOKUPS = 1000;
+    const unsigned HANDLE_LOOKUPS = 1000000;
+
+    for (unsigned numChildren : {10000u, 50000u})
+    {
+        std::string prefix = "handles." + std::to_string(numChildren);
+        SharedPtr<Scene> scene(new Scene(context));
+        EntityRegistry registry;
+        Vector<String> names(numChildren);
+        PODVector<Handle<Node> > nodes(numChildren);
+        for (unsigned i = 0; i < numChildren; ++i)
+        {
+            names[i] = "Child" + String(i);
+            Node* node = scene->CreateChild(names[i], LOCAL);
+            nodes[i] = registry.Add(node);
+            registry.Add(node->CreateComponent<StaticModel>(LOCAL));
+        }
+
+        // Every kind of lookup goes through the children in the same random order
+        SetRandomSeed(1);
+        PODVector<unsigned> order(HANDLE_LOOKUPS);
+        for (unsigned& index : order)
+            index = (unsigned)Random((int)numChildren);
+        PODVector<StringHash> hashes(NAME_LOOKUPS);
+        for (unsigned i = 0; i < NAME_LOOKUPS; ++i)
+            hashes[i] = StringHash(names[order[i]]);
+
+        HiresTimer timer;
+        double nameNs = 0.0;
+        double handleNs = 0.0;
+        double gatherNs = 0.0;
+        double viewNs = 0.0;
+        PODVector<StaticModel*> gathered;
+        for (unsigned repeat = 0; repeat < REPEATS; ++repeat)
+        {
+            unsigned found = 0;
+            timer.Reset();
+            for (unsigned i = 0; i < NAME_LOOKUPS; ++i)
+                found += scene->GetChild(names[order[i]]) != nullptr;
+            double ns = timer.GetUSec(false) * 1000.0 / NAME_LOOKUPS;
+            report.AddSample(prefix + ".name_ns", ns);
+            nameNs += ns;
+
+            timer.Reset();
+            for (unsigned i = 0; i < NAME_LOOKUPS; ++i)
+                found += scene->GetChild(hashes[i]) != nullptr;
+            report.AddSample(prefix + ".hash_ns", timer.GetUSec(false) * 1000.0 / NAME_LOOKUPS);
+
+            timer.Reset();
+            for (unsigned i = 0; i < HANDLE_LOOKUPS; ++i)
+                found += registry.Get(nodes[order[i]]) != nullptr;
+            ns = timer.GetUSec(false) * 1000.0 / HANDLE_LOOKUPS;
+            report.AddSample(prefix + ".handle_ns", ns);
+            handleNs += ns;
+
+            if (found != 2 * NAME_LOOKUPS + HANDLE_LOOKUPS)
+                report.AddEvent(prefix + ": a lookup missed a child");
+
+            unsigned enabled = 0;
+            timer.Reset();
+            scene->GetComponents<StaticModel>(gathered, true);
+            for (StaticModel* model : gathered)
+                enabled += model->IsEnabled();
+            ns = timer.GetUSec(false) * 1000.0 / numChildren;
+            report.AddSample(prefix + ".gather_ns", ns);
+            gatherNs += ns;
+
+            timer.Reset();
+            for (StaticModel* model : registry.GetView<StaticModel>())
+                enabled += model->IsEnabled();
+            ns = timer.GetUSec(false) * 1000.0 / numChildren;
+            report.AddSample(prefix + ".view_ns", ns);
+            viewNs += ns;
+
+            if (enabled != 2 * numChildren)
+                report.AddEvent(prefix + ": a component was missed");
+        }
+        report.SetMetric(prefix + ".handle_speedup", nameNs / Max(handleNs, 1e-3));
+        report.SetMetric(prefix + ".view_speedup", gatherNs / Max(viewNs, 1e-3));
+
+        // Remove every other child, then fill the freed slots with new ones: none of the old handles may resolve
+        for (unsigned i = 0; i < numChildren; i += 2)
+        {
+            Node* node = registry.Get(nodes[i]);
+            registry.Remove(nodes[i]);
+            node->Remove();
+        }
+        for (unsigned i = 0; i < numChildren; i += 2)
+            registry.Add(scene->CreateChild(String::EMPTY, LOCAL));
+        unsigned staleResolved = 0;
+        for (unsigned i = 0; i < numChildren; i += 2)
+            staleResolved += registry.Get(nodes[i]) != nullptr;
+        report.SetMetric(prefix + ".stale_resolved", staleResolved);
+    }
+}
+
+typedef void (*MicrobenchmarkFunction)(Context*, const BenchmarkSettings&, BenchmarkReport&);
+
+struct Microbenchmark {
+    const char* name_;
+    MicrobenchmarkFunction function_;
+};
+
+const Microbenchmark MICROBENCHMARKS[] = {
+    {"missiles", BenchmarkMissiles},
+    {"population", BenchmarkPopulation},
+    {"collisions", BenchmarkCollisions},
+    {"jobs", BenchmarkJobs},
+    {"particles", BenchmarkParticles},
+    {"scatter", BenchmarkScatter},
+    {"lod", BenchmarkLod},
+    {"occlusion", BenchmarkOcclusion},
+    {"network", BenchmarkNetwork},
+    {"replication", BenchmarkReplication},
+    {"sceneload", BenchmarkSceneLoad},
+    {"server", BenchmarkServer},
+    {"interest", BenchmarkInterest},
+    {"reload", BenchmarkReload},
+    {"handles", BenchmarkHandles},
+};
+
+}
+
+bool RunMicrobenchmark(Context* context, const std::string& name, const BenchmarkSettings& settings, BenchmarkReport& report) {
+    for (const Microbenchmark& benchmark : MICROBENCHMARKS)
+    {
+        if (name == benchmark.name_)
+        {
+            benchmark.function_(context, settings, report);
+            return true;
+        }
+    }
+    return false;
+}
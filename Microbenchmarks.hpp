@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+
+#include <Urho3D/Core/Context.h>
+
+#include "Benchmark.hpp"
+
+using namespace Urho3D;
+
+/**
+* Self-contained benchmarks that do not need the interactive World, selected
+* with "-benchmark <name>". Each one fills the report and returns; the frame
+* benchmark in Benchmark.cpp handles the "frames" scenario.
+*
+* Returns false if no microbenchmark of that name exists.
+*/
+bool RunMicrobenchmark(Context* context, const std::string& name, const BenchmarkSettings& settings, BenchmarkReport& report);
@@ -0,0 +1,240 @@
+#include "MissilePool.hpp"
+#include "Trace.hpp"
+
+#include <Urho3D/Graphics/Material.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/Graphics/StaticModel.h>
+#include <Urho3D/Resource/ResourceCache.h>
+
+#include <algorithm>
+
+#ifdef URHO3D_SSE
+#include <xmmintrin.h>
+#endif
+
+MissilePool::MissilePool(Scene* scene, unsigned capacity, unsigned maxVisibleNodes)
+                :scene_(scene),
+                capacity_(capacity),
+                count_(0),
+                nextId_(1),
+                maxVisibleNodes_(maxVisibleNodes),
+                numBound_(0)
+                {
+    unsigned padded = (capacity_ + 3) & ~3u;
+    for (PODVector<float>* array : {&posX_, &posY_, &posZ_, &velX_, &velY_, &velZ_, &life_})
+    {
+        array->Resize(padded);
+        for (unsigned i = 0; i < padded; ++i)
+            (*array)[i] = 0.0f;
+    }
+    ids_.Resize(padded);
+    hitFraction_.Resize(padded);
+    hitTarget_.Resize(padded);
+    displayNodes_.Reserve(maxVisibleNodes_);
+}
+
+bool MissilePool::CreateMissile(const Vector3& position, const Vector3& direction) {
+    if (count_ >= capacity_)
+        return false;
+
+    Vector3 velocity = direction.Normalized() * MISSILE_SPEED;
+    unsigned i = count_++;
+    posX_[i] = position.x_;
+    posY_[i] = position.y_;
+    posZ_[i] = position.z_;
+    velX_[i] = velocity.x_;
+    velY_[i] = velocity.y_;
+    velZ_[i] = velocity.z_;
+    life_[i] = MISSILE_LIFETIME;
+    ids_[i] = nextId_++;
+    return true;
+}
+
+void MissilePool::MoveMissiles(float timeStep) {
+    IntegrateRange(0, count_, timeStep);
+    ExpireMissiles();
+}
+
+void MissilePool::IntegrateRange(unsigned begin, unsigned end, float timeStep) {
+    // Round up into the padding, the arrays are sized for it
+    end = Min((end + 3) & ~3u, (unsigned)posX_.Size());
+
+    float* px = &posX_[0];
+    float* py = &posY_[0];
+    float* pz = &posZ_[0];
+    const float* vx = &velX_[0];
+    const float* vy = &velY_[0];
+    const float* vz = &velZ_[0];
+    float* life = &life_[0];
+
+#ifdef URHO3D_SSE
+    __m128 dt = _mm_set1_ps(timeStep);
+    for (unsigned i = begin; i < end; i += 4)
+    {
+        _mm_storeu_ps(px + i, _mm_add_ps(_mm_loadu_ps(px + i), _mm_mul_ps(_mm_loadu_ps(vx + i), dt)));
+        _mm_storeu_ps(py + i, _mm_add_ps(_mm_loadu_ps(py + i), _mm_mul_ps(_mm_loadu_ps(vy + i), dt)));
+        _mm_storeu_ps(pz + i, _mm_add_ps(_mm_loadu_ps(pz + i), _mm_mul_ps(_mm_loadu_ps(vz + i), dt)));
+        _mm_storeu_ps(life + i, _mm_sub_ps(_mm_loadu_ps(life + i), dt));
+    }
+#else
+    // Plain loop over contiguous arrays, written so the compiler can vectorize it
+    for (unsigned i = begin; i < end; ++i)
+    {
+        px[i] += vx[i] * timeStep;
+        py[i] += vy[i] * timeStep;
+        pz[i] += vz[i] * timeStep;
+        life[i] -= timeStep;
+    }
+#endif
+}
+
+void MissilePool::ExpireMissiles() {
+    // Walk backwards so a swapped-in missile has already been checked
+    for (unsigned i = count_; i-- > 0;)
+    {
+        if (life_[i] <= 0.0f)
+            RemoveMissile(i);
+    }
+}
+
+void MissilePool::SweepCollisions(SpatialHash& grid, float timeStep, PODVector<MissileHit>& hits) {
+    SweepRange(grid, 0, count_, timeStep);
+    ResolveSweep(grid, timeStep, hits);
+}
+
+void MissilePool::SweepRange(const SpatialHash& grid, unsigned begin, unsigned end, float timeStep) {
+    // Ranges are planned before expiry, which can only shrink the pool
+    end = Min(end, count_);
+    for (unsigned i = begin; i < end; ++i)
+    {
+        Vector3 to(posX_[i], posY_[i], posZ_[i]);
+        Vector3 from = to - Vector3(velX_[i], velY_[i], velZ_[i]) * timeStep;
+        if (!grid.SweepStatic(from, to, hitFraction_[i], hitTarget_[i]))
+            hitFraction_[i] = -1.0f;
+    }
+}
+
+void MissilePool::ResolveSweep(SpatialHash& grid, float timeStep, PODVector<MissileHit>& hits) {
+    // Walk backwards so removing a missile only moves one that has already been resolved
+    for (unsigned i = count_; i-- > 0;)
+    {
+        if (hitFraction_[i] < 0.0f)
+            continue;
+
+        Vector3 to(posX_[i], posY_[i], posZ_[i]);
+        Vector3 velocity(velX_[i], velY_[i], velZ_[i]);
+        Vector3 from = to - velocity * timeStep;
+
+        MissileHit hit;
+        hit.position_ = from + (to - from) * hitFraction_[i];
+        hit.velocity_ = velocity;
+        hit.target_ = hitTarget_[i];
+        hits.Push(hit);
+        RemoveMissile(i);
+    }
+
+    grid.SetDynamicPoints(&posX_[0], &posZ_[0], count_);
+}
+
+JobSpan MissilePool::AddStepJobs(JobGraph& graph, SpatialHash& grid, float timeStep, PODVector<MissileHit>& hits) {
+    // Nothing can add missiles while the graph runs, so today's count bounds every range
+    JobSpan integrate = graph.AddParallelFor(count_, JOB_GRAIN, [this, timeStep](unsigned begin, unsigned end) {
+        TraceScope trace("MissilePool::Integrate");
+        IntegrateRange(begin, end, timeStep);
+    }, 4);
+    JobId expire = graph.Add([this]() {
+        TraceScope trace("MissilePool::Expire");
+        ExpireMissiles();
+    });
+    graph.AddDependency(expire, integrate.last_);
+
+    JobSpan sweep = graph.AddParallelFor(count_, JOB_GRAIN, [this, &grid, timeStep](unsigned begin, unsigned end) {
+        TraceScope trace("MissilePool::Sweep");
+        SweepRange(grid, begin, end, timeStep);
+    });
+    graph.AddDependency(sweep.first_, expire);
+
+    JobId resolve = graph.Add([this, &grid, timeStep, &hits]() {
+        TraceScope trace("MissilePool::Resolve");
+        ResolveSweep(grid, timeStep, hits);
+    });
+    graph.AddDependency(resolve, sweep.last_);
+
+    JobSpan span;
+    span.first_ = integrate.first_;
+    span.last_ = resolve;
+    return span;
+}
+
+void MissilePool::RemoveMissile(unsigned index) {
+    unsigned last = --count_;
+    posX_[index] = posX_[last];
+    posY_[index] = posY_[last];
+    posZ_[index] = posZ_[last];
+    velX_[index] = velX_[last];
+    velY_[index] = velY_[last];
+    velZ_[index] = velZ_[last];
+    life_[index] = life_[last];
+    ids_[index] = ids_[last];
+}
+
+void MissilePool::CaptureSnapshot(Snapshot& snapshot) const {
+    snapshot.entities_.Resize(count_);
+    for (unsigned i = 0; i < count_; ++i)
+    {
+        Vector3 velocity(velX_[i], velY_[i], velZ_[i]);
+        snapshot.entities_[i] = SnapshotCodec::MakeState(ids_[i], Vector3(posX_[i], posY_[i], posZ_[i]), velocity);
+    }
+
+    // Swap removal scrambles the order, the codec walks entities by id
+    EntityState* begin = snapshot.entities_.Buffer();
+    std::sort(begin, begin + count_, [](const EntityState& lhs, const EntityState& rhs) { return lhs.id_ < rhs.id_; });
+}
+
+void MissilePool::Clear() {
+    count_ = 0;
+}
+
+void MissilePool::BindNodes(const Frustum& frustum, float lag) {
+    unsigned bound = 0;
+    for (unsigned i = 0; i < count_ && bound < maxVisibleNodes_; ++i)
+    {
+        // Missiles fly straight, so stepping back along the velocity is exact interpolation
+        Vector3 velocity(velX_[i], velY_[i], velZ_[i]);
+        Vector3 position = Vector3(posX_[i], posY_[i], posZ_[i]) - velocity * lag;
+        if (frustum.IsInside(position) == OUTSIDE)
+            continue;
+
+        Node* node = GetDisplayNode(bound);
+        if (!node)
+            break;
+        ++bound;
+        node->SetPosition(position);
+        node->SetDirection(velocity);
+        node->SetEnabled(true);
+    }
+
+    // Park the nodes that were in use last frame but are not needed now
+    for (unsigned i = bound; i < numBound_; ++i)
+        displayNodes_[i]->SetEnabled(false);
+
+    numBound_ = bound;
+}
+
+Node* MissilePool::GetDisplayNode(unsigned index) {
+    if (index < displayNodes_.Size())
+        return displayNodes_[index];
+
+    if (!scene_)
+        return nullptr;
+
+    auto* cache = scene_->GetSubsystem<ResourceCache>();
+    // Temporary, display nodes are not part of the scene's saved or cooked state
+    SharedPtr<Node> node(scene_->CreateChild("Missile", REPLICATED, 0, true));
+    node->SetScale(0.25f);
+    auto* missileObject = node->CreateComponent<StaticModel>();
+    missileObject->SetModel(cache->GetResource<Model>("Models/Box.mdl"));
+    missileObject->SetMaterial(cache->GetResource<Material>("Materials/Stone.xml"));
+    displayNodes_.Push(node);
+    return node;
+}
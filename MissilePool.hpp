@@ -0,0 +1,116 @@
+#pragma once
+
+#include <Urho3D/Container/Ptr.h>
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Math/Frustum.h>
+#include <Urho3D/Math/Vector3.h>
+#include <Urho3D/Scene/Node.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "JobSystem.hpp"
+#include "Snapshot.hpp"
+#include "SpatialHash.hpp"
+
+using namespace Urho3D;
+
+struct MissileHit {
+    Vector3 position_;
+    Vector3 velocity_;
+    /// Id of the static box that was hit in the collision grid.
+    unsigned target_;
+};
+
+/**
+* Missiles are stored as a structure of arrays in a pool that is allocated once
+* up front, so firing and expiring missiles never touches the allocator. Only
+* the missiles inside the camera frustum are given a scene node, taken from a
+* small set of nodes that are recycled frame to frame instead of being created
+* and destroyed per missile.
+*/
+class MissilePool {
+public:
+    MissilePool(Scene* scene, unsigned capacity = 131072, unsigned maxVisibleNodes = 512);
+
+    /// Launch a missile. Returns false when the pool is full.
+    bool CreateMissile(const Vector3& position, const Vector3& direction);
+
+    /// Integrate every live missile and expire the ones that ran out of lifetime.
+    void MoveMissiles(float timeStep);
+
+    /// Attach recycled scene nodes to the missiles inside the frustum, up to maxVisibleNodes. Nodes
+    /// are placed lag seconds behind the simulated positions, to interpolate between fixed ticks.
+    void BindNodes(const Frustum& frustum, float lag = 0.0f);
+
+    /// Test the step just taken by every missile against the static geometry in the grid, so fast
+    /// missiles cannot tunnel through thin boxes. Missiles that hit are removed and appended to hits.
+    /// The grid's dynamic layer is then rebuilt from the surviving missiles.
+    void SweepCollisions(SpatialHash& grid, float timeStep, PODVector<MissileHit>& hits);
+
+    /// MoveMissiles without the expiry, for missiles [begin, end). begin must be a multiple of four.
+    void IntegrateRange(unsigned begin, unsigned end, float timeStep);
+
+    void ExpireMissiles();
+
+    /// SweepCollisions split in two: test missiles [begin, end) without changing the pool, which
+    /// is safe to run on several threads at once, then remove the hits and rebuild the grid.
+    void SweepRange(const SpatialHash& grid, unsigned begin, unsigned end, float timeStep);
+
+    void ResolveSweep(SpatialHash& grid, float timeStep, PODVector<MissileHit>& hits);
+
+    /**
+    * Add one MoveMissiles and SweepCollisions step to graph as parallel jobs. Missiles must not be
+    * created or removed elsewhere until the graph has run. Depend on the span's first job to order
+    * the step after other work, wait on its last job for the step to be complete.
+    */
+    JobSpan AddStepJobs(JobGraph& graph, SpatialHash& grid, float timeStep, PODVector<MissileHit>& hits);
+
+    /// Remove a missile. The last live missile is moved into its slot.
+    void RemoveMissile(unsigned index);
+
+    void Clear();
+
+    unsigned GetNumMissiles() const { return count_; }
+
+    unsigned GetCapacity() const { return capacity_; }
+
+    unsigned GetNumBoundNodes() const { return numBound_; }
+
+    Vector3 GetPosition(unsigned index) const { return Vector3(posX_[index], posY_[index], posZ_[index]); }
+
+    Vector3 GetVelocity(unsigned index) const { return Vector3(velX_[index], velY_[index], velZ_[index]); }
+
+    /// Id that stays with a missile for its whole life, unlike its index.
+    unsigned GetId(unsigned index) const { return ids_[index]; }
+
+    /// Quantize every live missile into snapshot, sorted by id.
+    void CaptureSnapshot(Snapshot& snapshot) const;
+
+    static constexpr float MISSILE_SPEED = 40.0f;
+
+    static constexpr float MISSILE_LIFETIME = 10.0f;
+
+    /// Missiles per job in AddStepJobs.
+    static const unsigned JOB_GRAIN = 8192;
+
+private:
+    Node* GetDisplayNode(unsigned index);
+
+    WeakPtr<Scene> scene_;
+
+    unsigned capacity_;
+    unsigned count_;
+
+    // Structure of arrays, padded to a multiple of four so the SIMD loop never needs a scalar tail
+    PODVector<float> posX_, posY_, posZ_;
+    PODVector<float> velX_, velY_, velZ_;
+    PODVector<float> life_;
+    PODVector<unsigned> ids_;
+    // Sweep results per missile, written by SweepRange
+    PODVector<float> hitFraction_;
+    PODVector<unsigned> hitTarget_;
+    unsigned nextId_;
+
+    Vector<SharedPtr<Node> > displayNodes_;
+    unsigned maxVisibleNodes_;
+    unsigned numBound_;
+};
@@ -0,0 +1,47 @@
+#include "MissileSimulation.hpp"
+#include "GameEvents.hpp"
+
+MissileSimulation::MissileSimulation(Scene* scene)
+                :pool_(std::make_unique<MissilePool>(scene))
+                {
+}
+
+void MissileSimulation::BuildCollisionGrid(const BoundingBox& ground, const PODVector<BoundingBox>& boxes) {
+    collisionGrid_.ClearStatic();
+
+    if (ground.Defined())
+    {
+        BoundingBox groundBox = ground;
+        groundBox.min_.y_ = Min(groundBox.min_.y_, groundBox.max_.y_ - 0.01f);
+        collisionGrid_.InsertStatic(groundBox);
+    }
+
+    for (const BoundingBox& box : boxes)
+        collisionGrid_.InsertStatic(box);
+}
+
+void MissileSimulation::RunTicks(JobSystem& jobSystem, unsigned steps, float step) {
+    // Every tick of the frame goes into one graph, so there is a single sync
+    hits_.Clear();
+    jobGraph_.Clear();
+    JobId previousStep = 0;
+    for (unsigned i = 0; i < steps; ++i)
+    {
+        JobSpan missileStep = pool_->AddStepJobs(jobGraph_, collisionGrid_, step, hits_);
+        if (i > 0)
+            jobGraph_.AddDependency(missileStep.first_, previousStep);
+        previousStep = missileStep.last_;
+    }
+    jobSystem.Run(jobGraph_);
+}
+
+void MissileSimulation::SendHitEvent(Object* sender) {
+    if (hits_.Empty())
+        return;
+
+    using namespace MissileHits;
+    VariantMap& hitData = sender->GetEventDataMap();
+    hitData[P_HITS] = (void*)&hits_;
+    hitData[P_NUMHITS] = hits_.Size();
+    sender->SendEvent(E_MISSILEHITS, hitData);
+}
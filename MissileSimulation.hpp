@@ -0,0 +1,51 @@
+#pragma once
+
+#include <memory>
+
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Math/BoundingBox.h>
+
+#include "JobSystem.hpp"
+#include "MissilePool.hpp"
+#include "SpatialHash.hpp"
+
+using namespace Urho3D;
+
+/**
+* The missile part of the gameplay, run the same way by World and by the
+* DedicatedServer: the missile pool, the collision grid it sweeps against
+* and the hits of the ticks run last. Each owner feeds it the static
+* geometry of its field and runs the ticks of a frame on its job system.
+*/
+class MissileSimulation {
+public:
+    /// Missiles get recycled display nodes in scene, or none when it is null.
+    explicit MissileSimulation(Scene* scene);
+
+    /// Index the ground and the boxes missiles can hit, replacing what was indexed before. The ground is
+    /// flat, so it is given a sliver of thickness below its top for missiles crossing it to register. An
+    /// undefined ground box leaves the ground out.
+    void BuildCollisionGrid(const BoundingBox& ground, const PODVector<BoundingBox>& boxes);
+
+    /// Clear the last hits and run steps fixed ticks on jobSystem, each after the one before, in one graph.
+    void RunTicks(JobSystem& jobSystem, unsigned steps, float step);
+
+    /// Send one E_MISSILEHITS from sender carrying every hit of the last ticks, if there were any.
+    void SendHitEvent(Object* sender);
+
+    MissilePool& GetPool() { return *pool_; }
+
+    const MissilePool& GetPool() const { return *pool_; }
+
+    /// Broadphase over the ground and boxes, plus the live missiles.
+    SpatialHash& GetCollisionGrid() { return collisionGrid_; }
+
+    const PODVector<MissileHit>& GetHits() const { return hits_; }
+
+private:
+    std::unique_ptr<MissilePool> pool_;
+    SpatialHash collisionGrid_;
+    PODVector<MissileHit> hits_;
+    JobGraph jobGraph_;
+};
@@ -0,0 +1,110 @@
+#include "NetworkThread.hpp"
+
+#include <chrono>
+#include <cstring>
+
+long long NetworkClockUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+NetworkThread::NetworkThread()
+                :work_(boost::asio::make_work_guard(io_context_)),
+                socket_(io_context_),
+                localPort_(0),
+                flushPending_(false),
+                droppedInbound_(0),
+                numSent_(0),
+                numReceived_(0)
+                {
+}
+
+NetworkThread::~NetworkThread() {
+    Stop();
+}
+
+bool NetworkThread::Start(unsigned short port) {
+    boost::system::error_code error;
+    socket_.open(boost::asio::ip::udp::v4(), error);
+    if (!error)
+        socket_.bind(boost::asio::ip::udp::endpoint(boost::asio::ip::udp::v4(), port), error);
+    if (error)
+        return false;
+
+    // Room for bursts while the thread is busy decoding, the default is small on most systems
+    socket_.set_option(boost::asio::socket_base::receive_buffer_size(1 << 20), error);
+
+    localPort_ = socket_.local_endpoint(error).port();
+    ReceiveNext();
+    thread_ = std::thread([this]() { io_context_.run(); });
+    return true;
+}
+
+void NetworkThread::Stop() {
+    if (!thread_.joinable())
+        return;
+
+    work_.reset();
+    io_context_.stop();
+    thread_.join();
+
+    boost::system::error_code error;
+    socket_.close(error);
+}
+
+void NetworkThread::SetRemote(const std::string& host, unsigned short port) {
+    boost::system::error_code error;
+    remote_ = boost::asio::ip::udp::endpoint(boost::asio::ip::make_address(host, error), port);
+}
+
+bool NetworkThread::Send(const NetMessage& message) {
+    if (!outbound_.TryPush(message))
+        return false;
+
+    // One flush in flight is enough, it empties the whole queue
+    if (!flushPending_.exchange(true, std::memory_order_acq_rel))
+        boost::asio::post(io_context_, [this]() { FlushOutbound(); });
+    return true;
+}
+
+void NetworkThread::FlushOutbound() {
+    // A read-modify-write, so it is ordered against the exchange in Send: either Send sees the flag cleared and
+    // posts another flush, or this sees the message Send pushed before setting it. A plain store could be
+    // reordered after the first TryPop and lose the message until the next Send
+    flushPending_.exchange(false, std::memory_order_acq_rel);
+
+    while (outbound_.TryPop(sendMessage_))
+    {
+        unsigned short size = std::min<unsigned short>(sendMessage_.size_, NetMessage::MAX_PAYLOAD);
+        memcpy(sendBuffer_, &sendMessage_.type_, 2);
+        memcpy(sendBuffer_ + 2, &size, 2);
+        memcpy(sendBuffer_ + 4, sendMessage_.data_, size);
+
+        boost::system::error_code error;
+        socket_.send_to(boost::asio::buffer(sendBuffer_, 4u + size), remote_, 0, error);
+        if (!error)
+            numSent_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void NetworkThread::ReceiveNext() {
+    socket_.async_receive_from(boost::asio::buffer(receiveBuffer_), sender_,
+        [this](const boost::system::error_code& error, size_t bytes) {
+            if (error == boost::asio::error::operation_aborted)
+                return;
+
+            if (!error && bytes >= 4)
+            {
+                unsigned short size;
+                memcpy(&receiveMessage_.type_, receiveBuffer_, 2);
+                memcpy(&size, receiveBuffer_ + 2, 2);
+                receiveMessage_.size_ = (unsigned short)std::min<size_t>(size, bytes - 4);
+                memcpy(receiveMessage_.data_, receiveBuffer_ + 4, receiveMessage_.size_);
+                receiveMessage_.receivedUs_ = NetworkClockUs();
+
+                numReceived_.fetch_add(1, std::memory_order_relaxed);
+                if (!inbound_.TryPush(receiveMessage_))
+                    droppedInbound_.fetch_add(1, std::memory_order_relaxed);
+            }
+            ReceiveNext();
+        });
+}
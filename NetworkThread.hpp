@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include <boost/asio.hpp>
+
+#include "SpscQueue.hpp"
+
+/// Wall clock in microseconds, comparable between threads.
+long long NetworkClockUs();
+
+enum NetMessageType {
+    NET_MSG_NONE = 0,
+    /// Payload starts with the sender's NetworkClockUs() stamp.
+    NET_MSG_PING,
+    /// A client fires a missile: quantized position and encoded direction, as in a snapshot.
+    NET_MSG_FIRE,
+    /// Payload is a ReplicationServer packet.
+    NET_MSG_SNAPSHOT,
+    /// Payload is the 32 bit sequence of the last snapshot the client decoded.
+    NET_MSG_ACK,
+};
+
+/// One decoded datagram. Wire layout is a 2 byte type, a 2 byte size and the payload.
+struct NetMessage {
+
+    static const unsigned MAX_PAYLOAD = 1200;
+
+    unsigned short type_ = NET_MSG_NONE;
+    unsigned short size_ = 0;
+    /// Set by the network thread when the datagram was decoded.
+    long long receivedUs_ = 0;
+    unsigned char data_[MAX_PAYLOAD];
+};
+
+/**
+* Runs an io_context and a UDP socket on a dedicated thread, so packets are
+* received and sent as soon as they arrive rather than when the game thread
+* gets around to polling. Decoded messages are exchanged with the game thread
+* through two single-producer/single-consumer queues which the game drains
+* once per frame.
+*
+* Send and Drain must only be called from the game thread.
+*/
+class NetworkThread {
+public:
+    NetworkThread();
+
+    ~NetworkThread();
+
+    bool Start(unsigned short port);
+
+    void Stop();
+
+    void SetRemote(const std::string& host, unsigned short port);
+
+    unsigned short GetLocalPort() const { return localPort_; }
+
+    /// Queue a message for sending. Returns false if the outbound queue is full.
+    bool Send(const NetMessage& message);
+
+    /// Hand every message received so far to handler. Returns the number of messages.
+    template <class Handler> unsigned Drain(Handler&& handler) {
+        unsigned count = 0;
+        while (inbound_.TryPop(drainMessage_))
+        {
+            handler(drainMessage_);
+            ++count;
+        }
+        return count;
+    }
+
+    unsigned long long GetNumDroppedInbound() const { return droppedInbound_.load(std::memory_order_relaxed); }
+
+    unsigned long long GetNumSent() const { return numSent_.load(std::memory_order_relaxed); }
+
+    unsigned long long GetNumReceived() const { return numReceived_.load(std::memory_order_relaxed); }
+
+    /// Messages received and not yet drained. The game drains every frame and receives a snapshot and a few
+    /// commands per tick, this covers a frame of several hundred milliseconds before any is dropped.
+    static const size_t INBOUND_CAPACITY = 512;
+    /// Messages queued for sending. The network thread flushes as soon as one is queued, so few wait at once.
+    static const size_t OUTBOUND_CAPACITY = 128;
+
+private:
+    void ReceiveNext();
+
+    void FlushOutbound();
+
+    boost::asio::io_context io_context_;
+    boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work_;
+    boost::asio::ip::udp::socket socket_;
+    boost::asio::ip::udp::endpoint remote_;
+    boost::asio::ip::udp::endpoint sender_;
+    unsigned short localPort_;
+    std::thread thread_;
+
+    // About 1.2 KB per slot, so sized to the traffic rather than generously
+    SpscQueue<NetMessage, INBOUND_CAPACITY> inbound_;
+    SpscQueue<NetMessage, OUTBOUND_CAPACITY> outbound_;
+    std::atomic<bool> flushPending_;
+
+    unsigned char receiveBuffer_[4 + NetMessage::MAX_PAYLOAD];
+    unsigned char sendBuffer_[4 + NetMessage::MAX_PAYLOAD];
+    NetMessage receiveMessage_;
+    NetMessage sendMessage_;
+    NetMessage drainMessage_;
+
+    std::atomic<unsigned long long> droppedInbound_;
+    std::atomic<unsigned long long> numSent_;
+    std::atomic<unsigned long long> numReceived_;
+};
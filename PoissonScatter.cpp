@@ -0,0 +1,237 @@
+#include "PoissonScatter.hpp"
+#include "Trace.hpp"
+
+#include <cstring>
+
+namespace {
+
+/// Small generator per tile, Urho's Random() is global and not safe on job threads.
+struct ScatterRandom {
+    explicit ScatterRandom(unsigned seed) : state_(seed ? seed : 0x9e3779b9u) {}
+
+    unsigned Next() {
+        state_ ^= state_ << 13;
+        state_ ^= state_ >> 17;
+        state_ ^= state_ << 5;
+        return state_;
+    }
+
+    /// Uniform in [0, range).
+    float Next(float range) { return (Next() >> 8) * (1.0f / 16777216.0f) * range; }
+
+    unsigned state_;
+};
+
+unsigned HashTile(unsigned seed, unsigned category, unsigned x, unsigned z) {
+    unsigned hash = seed ^ 0x2545f491u;
+    hash = (hash ^ category) * 0xcc9e2d51u;
+    hash = (hash ^ x) * 0x9e3779b1u;
+    hash = (hash ^ z) * 0x85ebca77u;
+    return hash ^ (hash >> 15);
+}
+
+}
+
+DensityMap::DensityMap(unsigned width, unsigned height, float value)
+                :width_(Max(width, 1u)),
+                height_(Max(height, 1u))
+                {
+    values_.Resize(width_ * height_);
+    for (float& density : values_)
+        density = value;
+}
+
+float DensityMap::Sample(float u, float v) const {
+    float x = Clamp(u, 0.0f, 1.0f) * (width_ - 1);
+    float y = Clamp(v, 0.0f, 1.0f) * (height_ - 1);
+    auto x0 = (unsigned)x;
+    auto y0 = (unsigned)y;
+    unsigned x1 = Min(x0 + 1, width_ - 1);
+    unsigned y1 = Min(y0 + 1, height_ - 1);
+    float fx = x - x0;
+    float fy = y - y0;
+    float top = Lerp(values_[y0 * width_ + x0], values_[y0 * width_ + x1], fx);
+    float bottom = Lerp(values_[y1 * width_ + x0], values_[y1 * width_ + x1], fx);
+    return Lerp(top, bottom, fy);
+}
+
+PoissonScatter::PoissonScatter()
+                :area_(-50.0f, -50.0f, 50.0f, 50.0f),
+                seed_(1)
+                {
+}
+
+unsigned PoissonScatter::AddCategory(const ScatterCategory& category) {
+    Category added;
+    added.settings_ = category;
+    added.settings_.minScale_ = Max(category.minScale_, M_EPSILON);
+    added.settings_.maxScale_ = Max(category.maxScale_, added.settings_.minScale_);
+    added.settings_.radius_ = Max(category.radius_, M_EPSILON);
+    categories_.Push(added);
+    return categories_.Size() - 1;
+}
+
+void PoissonScatter::Generate(JobSystem* jobSystem) {
+    for (unsigned i = 0; i < categories_.Size(); ++i)
+    {
+        Category& category = categories_[i];
+        SetupGrid(category);
+
+        // Tiles of one pass are a tile apart, which is more than any object's reach
+        for (unsigned pass = 0; pass < 4; ++pass)
+        {
+            unsigned firstX = pass & 1;
+            unsigned firstZ = pass >> 1;
+            graph_.Clear();
+            for (unsigned z = firstZ; z < category.tilesZ_; z += 2)
+            {
+                for (unsigned x = firstX; x < category.tilesX_; x += 2)
+                {
+                    if (jobSystem)
+                        graph_.Add([this, i, x, z]() { FillTile(i, x, z); });
+                    else
+                        FillTile(i, x, z);
+                }
+            }
+            if (jobSystem)
+                jobSystem->Run(graph_);
+        }
+
+        unsigned count = 0;
+        for (const Tile& tile : category.tiles_)
+            count += tile.placements_.Size();
+        category.placements_.Clear();
+        category.placements_.Reserve(count);
+        for (const Tile& tile : category.tiles_)
+            category.placements_.Push(tile.placements_);
+    }
+
+    // Only needed while later categories are placed
+    for (Category& category : categories_)
+    {
+        PODVector<unsigned>().Swap(category.cellHeads_);
+        Vector<Tile>().Swap(category.tiles_);
+    }
+}
+
+unsigned PoissonScatter::GetNumPlacements() const {
+    unsigned count = 0;
+    for (const Category& category : categories_)
+        count += category.placements_.Size();
+    return count;
+}
+
+unsigned PoissonScatter::GetHash() const {
+    unsigned hash = 2166136261u;
+    for (const Category& category : categories_)
+    {
+        const auto* bytes = reinterpret_cast<const unsigned char*>(category.placements_.Buffer());
+        unsigned size = category.placements_.Size() * sizeof(ScatterPlacement);
+        for (unsigned i = 0; i < size; ++i)
+            hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+void PoissonScatter::SetupGrid(Category& category) {
+    const ScatterCategory& settings = category.settings_;
+    category.cellSize_ = 2.0f * settings.radius_ * settings.maxScale_;
+    // A spare cell keeps the cells a tile reads clear of the tiles filled at the same time, whatever the rounding
+    category.cellsPerTile_ = (unsigned)CeilToInt(Max(category.cellSize_, MIN_TILE_SIZE) / category.cellSize_) + 1;
+    category.tileSize_ = category.cellsPerTile_ * category.cellSize_;
+    category.tilesX_ = (unsigned)Max(CeilToInt(area_.Size().x_ / category.tileSize_), 1);
+    category.tilesZ_ = (unsigned)Max(CeilToInt(area_.Size().y_ / category.tileSize_), 1);
+    category.cellsX_ = category.tilesX_ * category.cellsPerTile_;
+    category.cellsZ_ = category.tilesZ_ * category.cellsPerTile_;
+    category.cellHeads_.Resize(category.cellsX_ * category.cellsZ_);
+    memset(category.cellHeads_.Buffer(), 0, category.cellHeads_.Size() * sizeof(unsigned));
+    category.tiles_.Clear();
+    category.tiles_.Resize(category.tilesX_ * category.tilesZ_);
+}
+
+void PoissonScatter::FillTile(unsigned categoryIndex, unsigned tileX, unsigned tileZ) {
+    TraceScope trace("PoissonScatter::FillTile");
+    Category& category = categories_[categoryIndex];
+    const ScatterCategory& settings = category.settings_;
+    Tile& tile = category.tiles_[tileZ * category.tilesX_ + tileX];
+
+    float x0 = area_.min_.x_ + tileX * category.tileSize_;
+    float z0 = area_.min_.y_ + tileZ * category.tileSize_;
+    float width = Min(x0 + category.tileSize_, area_.max_.x_) - x0;
+    float depth = Min(z0 + category.tileSize_, area_.max_.y_) - z0;
+    if (width <= 0.0f || depth <= 0.0f)
+        return;
+
+    ScatterRandom random(HashTile(seed_, categoryIndex, tileX, tileZ));
+    float expected = settings.candidatesPerUnit2_ * width * depth;
+    auto numCandidates = (unsigned)expected;
+    if (random.Next(1.0f) < expected - numCandidates)
+        ++numCandidates;
+
+    Vector2 areaSize = area_.Size();
+    unsigned firstCellX = tileX * category.cellsPerTile_;
+    unsigned firstCellZ = tileZ * category.cellsPerTile_;
+    for (unsigned i = 0; i < numCandidates; ++i)
+    {
+        // Every candidate draws the same numbers, so the stream does not depend on what was rejected
+        float x = x0 + random.Next(width);
+        float z = z0 + random.Next(depth);
+        float yaw = random.Next(360.0f);
+        float scale = settings.minScale_ + random.Next(settings.maxScale_ - settings.minScale_);
+        float keep = random.Next(1.0f);
+
+        if (settings.density_ &&
+            keep >= settings.density_->Sample((x - area_.min_.x_) / areaSize.x_, (z - area_.min_.y_) / areaSize.y_))
+            continue;
+
+        float radius = settings.radius_ * scale;
+        if (!IsClear(categoryIndex, x, z, radius))
+            continue;
+
+        // Clamped so rounding at the tile edge never writes into a neighbour's cells
+        unsigned cellX = Clamp((unsigned)((x - area_.min_.x_) / category.cellSize_), firstCellX,
+                               firstCellX + category.cellsPerTile_ - 1);
+        unsigned cellZ = Clamp((unsigned)((z - area_.min_.y_) / category.cellSize_), firstCellZ,
+                               firstCellZ + category.cellsPerTile_ - 1);
+        unsigned& head = category.cellHeads_[cellZ * category.cellsX_ + cellX];
+        Occupant occupant = {x, z, radius, head};
+        tile.occupants_.Push(occupant);
+        head = tile.occupants_.Size();
+
+        ScatterPlacement placement;
+        placement.position_ = Vector3(x, 0.0f, z);
+        placement.yaw_ = yaw;
+        placement.scale_ = scale;
+        tile.placements_.Push(placement);
+    }
+}
+
+bool PoissonScatter::IsClear(unsigned categoryIndex, float x, float z, float radius) const {
+    for (unsigned i = 0; i <= categoryIndex; ++i)
+    {
+        const Category& other = categories_[i];
+        float reach = radius + other.settings_.radius_ * other.settings_.maxScale_;
+        int minX = Max(FloorToInt((x - reach - area_.min_.x_) / other.cellSize_), 0);
+        int maxX = Min(FloorToInt((x + reach - area_.min_.x_) / other.cellSize_), (int)other.cellsX_ - 1);
+        int minZ = Max(FloorToInt((z - reach - area_.min_.y_) / other.cellSize_), 0);
+        int maxZ = Min(FloorToInt((z + reach - area_.min_.y_) / other.cellSize_), (int)other.cellsZ_ - 1);
+        for (int cz = minZ; cz <= maxZ; ++cz)
+        {
+            for (int cx = minX; cx <= maxX; ++cx)
+            {
+                const Tile& tile = other.tiles_[(cz / other.cellsPerTile_) * other.tilesX_ + cx / other.cellsPerTile_];
+                for (unsigned j = other.cellHeads_[cz * other.cellsX_ + cx]; j;)
+                {
+                    const Occupant& occupant = tile.occupants_[j - 1];
+                    float dx = occupant.x_ - x;
+                    float dz = occupant.z_ - z;
+                    float distance = radius + occupant.radius_;
+                    if (dx * dx + dz * dz < distance * distance)
+                        return false;
+                    j = occupant.next_;
+                }
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Math/Rect.h>
+#include <Urho3D/Math/Vector3.h>
+
+#include "JobSystem.hpp"
+
+using namespace Urho3D;
+
+/// Densities in [0, 1] on a grid stretched over the scattered area, sampled bilinearly.
+class DensityMap {
+public:
+    DensityMap(unsigned width, unsigned height, float value = 1.0f);
+
+    void SetValue(unsigned x, unsigned y, float value) { values_[y * width_ + x] = value; }
+
+    unsigned GetWidth() const { return width_; }
+
+    unsigned GetHeight() const { return height_; }
+
+    /// u and v run from 0 to 1 across the area, x and z.
+    float Sample(float u, float v) const;
+
+private:
+    unsigned width_;
+    unsigned height_;
+    PODVector<float> values_;
+};
+
+/// A kind of object to scatter, e.g. mushrooms.
+struct ScatterCategory {
+    /// Footprint at scale 1. Two objects are kept at least the sum of their scaled footprints apart.
+    float radius_ = 1.0f;
+    /// Candidate positions tried per unit area. Each survives with the density map's value there and when
+    /// nothing already placed is too close, so this is the most objects per unit area there can be.
+    float candidatesPerUnit2_ = 0.01f;
+    float minScale_ = 1.0f;
+    float maxScale_ = 1.0f;
+    /// Where the category grows, uniform when null. Not owned, must outlive Generate.
+    const DensityMap* density_ = nullptr;
+};
+
+/// One scattered object, on the y = 0 plane.
+struct ScatterPlacement {
+    Vector3 position_;
+    float yaw_;
+    float scale_;
+};
+
+/**
+* Seeded blue noise placement. Objects are dart thrown into the area with a
+* minimum spacing, which leaves no clumps and no gaps the way uniform
+* scatter does. Categories are placed in the order they were added and keep
+* clear of everything placed before them, so the first category claims its
+* space and later ones fill in around it.
+*
+* The area is cut into tiles at least as big as the largest spacing, each
+* with its own random stream derived from the seed. Tiles are filled in
+* four passes, every other tile in x and z at a time, so tiles filled
+* together never compete for space and can run on a JobSystem. The result
+* depends on the seed and categories only, not on the number of threads.
+*/
+class PoissonScatter {
+public:
+    PoissonScatter();
+
+    /// x and z extent to fill.
+    void SetArea(const Rect& area) { area_ = area; }
+
+    void SetSeed(unsigned seed) { seed_ = seed; }
+
+    /// Returns the category's index for GetPlacements.
+    unsigned AddCategory(const ScatterCategory& category);
+
+    /// Place every category, replacing earlier results. Tiles run on jobSystem if given.
+    void Generate(JobSystem* jobSystem = nullptr);
+
+    /// Placements ordered by tile, then by the order they were accepted in.
+    const PODVector<ScatterPlacement>& GetPlacements(unsigned category) const { return categories_[category].placements_; }
+
+    unsigned GetNumPlacements() const;
+
+    unsigned GetNumTiles(unsigned category) const { return categories_[category].tilesX_ * categories_[category].tilesZ_; }
+
+    /// FNV-1a over every placement, equal for equal output.
+    unsigned GetHash() const;
+
+    /// Smallest tile side, so a tile is worth a job even for small objects.
+    static constexpr float MIN_TILE_SIZE = 32.0f;
+
+private:
+    /// A placed object as the spacing test sees it.
+    struct Occupant {
+        float x_;
+        float z_;
+        /// Scaled footprint.
+        float radius_;
+        /// Next occupant of the same cell plus one, 0 ends the list.
+        unsigned next_;
+    };
+
+    /// What one tile placed. Only the job filling the tile writes it.
+    struct Tile {
+        PODVector<Occupant> occupants_;
+        PODVector<ScatterPlacement> placements_;
+    };
+
+    struct Category {
+        ScatterCategory settings_;
+        /// As wide as the largest spacing, so a test only looks at the cells around it.
+        float cellSize_;
+        unsigned cellsPerTile_;
+        float tileSize_;
+        unsigned tilesX_;
+        unsigned tilesZ_;
+        unsigned cellsX_;
+        unsigned cellsZ_;
+        /// First occupant of each cell plus one, indexing the occupants of the tile the cell is in.
+        PODVector<unsigned> cellHeads_;
+        Vector<Tile> tiles_;
+        PODVector<ScatterPlacement> placements_;
+    };
+
+    void SetupGrid(Category& category);
+
+    void FillTile(unsigned categoryIndex, unsigned tileX, unsigned tileZ);
+
+    /// Whether an object at x, z with the given footprint keeps clear of this and every earlier category.
+    bool IsClear(unsigned categoryIndex, float x, float z, float radius) const;
+
+    Rect area_;
+    unsigned seed_;
+    Vector<Category> categories_;
+    JobGraph graph_;
+};
@@ -0,0 +1,187 @@
+#include "PreviewRenderScheduler.hpp"
+#include "Trace.hpp"
+
+#include <Urho3D/Graphics/Graphics.h>
+#include <Urho3D/Graphics/GraphicsEvents.h>
+#include <Urho3D/Graphics/RenderPath.h>
+#include <Urho3D/Graphics/Viewport.h>
+
+#include <cmath>
+
+PreviewRenderScheduler::PreviewRenderScheduler(Context* context, RenderSurface* surface)
+                :Object(context),
+                surface_(surface),
+                mode_(PREVIEW_CAPPED),
+                maxRate_(15.0f),
+                sinceLastRender_(0),
+                dirty_(true),
+                rendersThisFrame_(0),
+                totalRenders_(0),
+                renderStartNs_(0),
+                numFrames_(0),
+                columns_(1),
+                period_(1),
+                playTime_(0),
+                bakeViewsRendered_(0)
+                {
+    if (surface_)
+    {
+        surface_->SetUpdateMode(SURFACE_MANUALUPDATE);
+        SubscribeToEvent(E_BEGINVIEWRENDER, URHO3D_HANDLER(PreviewRenderScheduler, HandleBeginViewRender));
+        SubscribeToEvent(E_ENDVIEWRENDER, URHO3D_HANDLER(PreviewRenderScheduler, HandleEndViewRender));
+    }
+}
+
+void PreviewRenderScheduler::SetMode(PreviewUpdateMode mode) {
+    mode_ = mode;
+    dirty_ = true;
+}
+
+void PreviewRenderScheduler::Update(float timeStep) {
+    TraceScope trace("PreviewRenderScheduler::Update");
+    rendersThisFrame_ = 0;
+    sinceLastRender_ += timeStep;
+    // Released here rather than from the view render event, while the renderer may still use them
+    if (!bakeCameras_.Empty() && bakeViewsRendered_ >= bakeCameras_.Size())
+        ReleaseBake();
+
+    switch (mode_)
+    {
+    case PREVIEW_ALWAYS:
+        QueueRender();
+        break;
+
+    case PREVIEW_CAPPED:
+        if (dirty_ && sinceLastRender_ >= 1.0f / maxRate_)
+            QueueRender();
+        break;
+
+    case PREVIEW_ON_CHANGE:
+        if (dirty_)
+            QueueRender();
+        break;
+
+    case PREVIEW_SPRITESHEET:
+        if (display_ && numFrames_)
+        {
+            playTime_ = std::fmod(playTime_ + timeStep, period_);
+            auto frame = (unsigned)(playTime_ / period_ * numFrames_) % numFrames_;
+            int x = (frame % columns_) * frameSize_.x_;
+            int y = (frame / columns_) * frameSize_.y_;
+            display_->SetImageRect(IntRect(x, y, x + frameSize_.x_, y + frameSize_.y_));
+        }
+        break;
+    }
+}
+
+void PreviewRenderScheduler::QueueRender() {
+    if (surface_)
+        surface_->QueueUpdate();
+    dirty_ = false;
+    sinceLastRender_ = 0;
+    ++rendersThisFrame_;
+    ++totalRenders_;
+}
+
+void PreviewRenderScheduler::BakeSpriteSheet(Scene* scene, Node* target, Camera* camera, BorderImage* display,
+                                             const Quaternion& rotationPerSecond, unsigned numFrames, unsigned columns) {
+    mode_ = PREVIEW_SPRITESHEET;
+    numFrames_ = Max(numFrames, 1u);
+    columns_ = Clamp(columns, 1u, numFrames_);
+    playTime_ = 0;
+
+    // A constant per-second rotation turns about one axis, so a full turn repeats after 360 degrees
+    float anglePerSecond = 2.0f * Acos(Clamp(rotationPerSecond.w_, -1.0f, 1.0f));
+    Vector3 axis(rotationPerSecond.x_, rotationPerSecond.y_, rotationPerSecond.z_);
+    if (anglePerSecond < M_EPSILON || axis.LengthSquared() < M_EPSILON)
+    {
+        anglePerSecond = 360.0f;
+        axis = Vector3::UP;
+    }
+    axis.Normalize();
+    period_ = 360.0f / anglePerSecond;
+
+    // Headless: nothing to render into, but the bake still counts as the one render
+    if (!surface_ || !display)
+    {
+        QueueRender();
+        return;
+    }
+
+    frameSize_ = display->GetSize();
+    unsigned rows = (numFrames_ + columns_ - 1) / columns_;
+
+    ReleaseBake();
+    sheet_ = new Texture2D(context_);
+    sheet_->SetSize(frameSize_.x_ * columns_, frameSize_.y_ * rows, Graphics::GetRGBAFormat(), TEXTURE_RENDERTARGET);
+    sheet_->SetFilterMode(FILTER_BILINEAR);
+
+    // Reuse the render path of the live preview so the sheet keeps its transparent clear
+    RenderPath* renderPath = surface_->GetViewport(0) ? surface_->GetViewport(0)->GetRenderPath() : nullptr;
+
+    Vector3 pivot = target->GetWorldPosition();
+    Vector3 cameraOffset = camera->GetNode()->GetWorldPosition() - pivot;
+    Quaternion cameraRotation = camera->GetNode()->GetWorldRotation();
+    target->SetWorldRotation(Quaternion::IDENTITY);
+
+    bakeViewsRendered_ = 0;
+    RenderSurface* sheetSurface = sheet_->GetRenderSurface();
+    sheetSurface->SetUpdateMode(SURFACE_MANUALUPDATE);
+    sheetSurface->SetNumViewports(numFrames_);
+    for (unsigned i = 0; i < numFrames_; ++i)
+    {
+        // Orbiting the camera by the inverse rotation shows the same image as rotating the target
+        Quaternion inverse = Quaternion(360.0f * i / numFrames_, axis).Inverse();
+        Node* frameCameraNode = scene->CreateChild("PreviewSheetCamera");
+        frameCameraNode->SetTemporary(true);
+        bakeCameras_.Push(SharedPtr<Node>(frameCameraNode));
+        frameCameraNode->SetWorldPosition(pivot + inverse * cameraOffset);
+        frameCameraNode->SetWorldRotation(inverse * cameraRotation);
+        auto* frameCamera = frameCameraNode->CreateComponent<Camera>();
+        frameCamera->SetFov(camera->GetFov());
+        frameCamera->SetNearClip(camera->GetNearClip());
+        frameCamera->SetFarClip(camera->GetFarClip());
+
+        int x = (i % columns_) * frameSize_.x_;
+        int y = (i / columns_) * frameSize_.y_;
+        SharedPtr<Viewport> viewport(new Viewport(context_, scene, frameCamera,
+                                                  IntRect(x, y, x + frameSize_.x_, y + frameSize_.y_), renderPath));
+        sheetSurface->SetViewport(i, viewport);
+    }
+
+    display_ = display;
+    display_->SetTexture(sheet_);
+    display_->SetImageRect(IntRect(0, 0, frameSize_.x_, frameSize_.y_));
+
+    surface_ = sheetSurface;
+    QueueRender();
+}
+
+void PreviewRenderScheduler::HandleBeginViewRender(StringHash eventType, VariantMap& eventData) {
+    using namespace BeginViewRender;
+    if (Trace::IsEnabled() && eventData[P_SURFACE].GetPtr() == surface_.Get())
+        renderStartNs_ = Trace::Now();
+}
+
+void PreviewRenderScheduler::HandleEndViewRender(StringHash eventType, VariantMap& eventData) {
+    using namespace EndViewRender;
+    if (eventData[P_SURFACE].GetPtr() != surface_.Get())
+        return;
+    if (renderStartNs_)
+    {
+        Trace::Record("PreviewRenderScheduler::Render", renderStartNs_, Trace::Now());
+        renderStartNs_ = 0;
+    }
+    if (!bakeCameras_.Empty())
+        ++bakeViewsRendered_;
+}
+
+void PreviewRenderScheduler::ReleaseBake() {
+    if (bakeCameras_.Empty())
+        return;
+    for (Node* node : bakeCameras_)
+        node->Remove();
+    bakeCameras_.Clear();
+    if (sheet_)
+        sheet_->GetRenderSurface()->SetNumViewports(0);
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Graphics/Camera.h>
+#include <Urho3D/Graphics/RenderSurface.h>
+#include <Urho3D/Graphics/Texture2D.h>
+#include <Urho3D/Scene/Scene.h>
+#include <Urho3D/UI/BorderImage.h>
+
+using namespace Urho3D;
+
+enum PreviewUpdateMode {
+    /// Render every frame, the old SURFACE_UPDATEALWAYS behaviour.
+    PREVIEW_ALWAYS = 0,
+    /// Render when the content changed, at most maxRate times per second.
+    PREVIEW_CAPPED,
+    /// Render whenever the content changed, with no rate limit.
+    PREVIEW_ON_CHANGE,
+    /// Render a full rotation into a sprite sheet once, then only flip between its frames.
+    PREVIEW_SPRITESHEET
+};
+
+/**
+* Decides when the missile preview render target is re-rendered. The surface
+* is switched to manual updates and only queued when the schedule allows, so
+* the overlay scene stops costing a full view every frame.
+*
+* The surface may be null (headless), in which case renders are only counted.
+*/
+class PreviewRenderScheduler : public Object {
+
+    URHO3D_OBJECT(PreviewRenderScheduler, Object);
+
+public:
+    PreviewRenderScheduler(Context* context, RenderSurface* surface);
+
+    void SetMode(PreviewUpdateMode mode);
+
+    void SetMaxRate(float rate) { maxRate_ = Max(rate, 0.1f); }
+
+    /// The preview content changed and should be shown on the next allowed render.
+    void MarkDirty() { dirty_ = true; }
+
+    /// Called once per frame, queues a render if the schedule allows one.
+    void Update(float timeStep);
+
+    /**
+    * Render frames of a full rotation of target around a fixed axis into one texture and show
+    * them on display. Rather than rotating the target, each frame gets its own viewport whose
+    * camera orbits the target the opposite way, so the whole sheet renders in a single update.
+    */
+    void BakeSpriteSheet(Scene* scene, Node* target, Camera* camera, BorderImage* display,
+                         const Quaternion& rotationPerSecond, unsigned numFrames = 32, unsigned columns = 8);
+
+    PreviewUpdateMode GetMode() const { return mode_; }
+
+    unsigned GetRendersThisFrame() const { return rendersThisFrame_; }
+
+    unsigned GetTotalRenders() const { return totalRenders_; }
+
+private:
+    void QueueRender();
+
+    /// Time the preview surface's view for the trace.
+    void HandleBeginViewRender(StringHash eventType, VariantMap& eventData);
+
+    void HandleEndViewRender(StringHash eventType, VariantMap& eventData);
+
+    /// Remove the bake's cameras and viewports once the sheet has rendered.
+    void ReleaseBake();
+
+    WeakPtr<RenderSurface> surface_;
+    PreviewUpdateMode mode_;
+    float maxRate_;
+    float sinceLastRender_;
+    bool dirty_;
+
+    unsigned rendersThisFrame_;
+    unsigned totalRenders_;
+    long long renderStartNs_;
+
+    // Sprite sheet playback
+    SharedPtr<Texture2D> sheet_;
+    WeakPtr<BorderImage> display_;
+    IntVector2 frameSize_;
+    unsigned numFrames_;
+    unsigned columns_;
+    float period_;
+    float playTime_;
+    /// Camera nodes of the bake, one per frame, until the sheet has rendered.
+    Vector<SharedPtr<Node> > bakeCameras_;
+    /// Sheet viewports rendered so far.
+    unsigned bakeViewsRendered_;
+};
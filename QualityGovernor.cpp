@@ -0,0 +1,151 @@
+#include "QualityGovernor.hpp"
+
+#include <Urho3D/IO/Log.h>
+
+namespace {
+
+/// Lowest first. The last level is the world config as it is.
+const QualityLevel LEVELS[] = {
+    {"lowest", 1, 0.15f, 0.25f, 0.4f, 0.25f},
+    {"low", 2, 0.3f, 0.5f, 0.6f, 0.5f},
+    {"medium", 3, 0.6f, 0.75f, 0.8f, 0.75f},
+    {"high", 4, 1.0f, 1.0f, 1.0f, 1.0f},
+};
+
+const unsigned NUM_LEVELS = sizeof(LEVELS) / sizeof(LEVELS[0]);
+
+/// Slower than this many times the target steps down.
+const float DOWNGRADE_RATIO = 1.1f;
+
+/// Faster than this many times the target counts towards stepping up.
+const float UPGRADE_RATIO = 0.75f;
+
+}
+
+QualityGovernor::QualityGovernor(Context* context, float targetFrameMs)
+                :Object(context),
+                targetFrameMs_(Max(targetFrameMs, 1.0f)),
+                level_(NUM_LEVELS - 1),
+                frame_(0),
+                timing_(false),
+                windowSum_(0.0f),
+                windowFrames_(0),
+                fastWindows_(0),
+                lastWasUpgrade_(false)
+                {
+    failedUpgrades_.Resize(NUM_LEVELS);
+    for (unsigned& failed : failedUpgrades_)
+        failed = 0;
+}
+
+unsigned QualityGovernor::GetNumLevels() const {
+    return NUM_LEVELS;
+}
+
+const QualityLevel& QualityGovernor::GetLevelSettings(unsigned level) {
+    return LEVELS[Min(level, NUM_LEVELS - 1)];
+}
+
+void QualityGovernor::Update() {
+    // The first call only starts the clock
+    if (timing_)
+        AddFrameTime(frameTimer_.GetUSec(false) / 1000.0f);
+    frameTimer_.Reset();
+    timing_ = true;
+}
+
+void QualityGovernor::AddFrameTime(float frameMs) {
+    ++frame_;
+    windowSum_ += frameMs;
+    if (++windowFrames_ < WINDOW)
+        return;
+
+    float mean = windowSum_ / windowFrames_;
+    windowSum_ = 0.0f;
+    windowFrames_ = 0;
+    Decide(mean);
+}
+
+void QualityGovernor::Decide(float meanFrameMs) {
+    unsigned next = level_;
+    if (meanFrameMs > targetFrameMs_ * DOWNGRADE_RATIO)
+    {
+        fastWindows_ = 0;
+        if (level_ > 0)
+        {
+            if (lastWasUpgrade_)
+                ++failedUpgrades_[level_];
+            next = level_ - 1;
+        }
+    }
+    else if (meanFrameMs < targetFrameMs_ * UPGRADE_RATIO && level_ + 1 < NUM_LEVELS)
+    {
+        unsigned needed = UPGRADE_WINDOWS << Min(failedUpgrades_[level_ + 1], 8u);
+        if (++fastWindows_ >= needed)
+            next = level_ + 1;
+    }
+    else
+        fastWindows_ = 0;
+
+    if (next == level_)
+        return;
+
+    QualityDecision decision;
+    decision.frame_ = frame_;
+    decision.from_ = level_;
+    decision.to_ = next;
+    decision.meanFrameMs_ = meanFrameMs;
+    decisions_.Push(decision);
+    URHO3D_LOGINFOF("Quality %s -> %s at frame %u: mean frame %.2f ms, target %.2f ms", LEVELS[level_].name_,
+                    LEVELS[next].name_, frame_, meanFrameMs, targetFrameMs_);
+
+    lastWasUpgrade_ = next > level_;
+    fastWindows_ = 0;
+    level_ = next;
+    ApplyLevel();
+}
+
+void QualityGovernor::SetLevel(unsigned level) {
+    level_ = Min(level, NUM_LEVELS - 1);
+    fastWindows_ = 0;
+    lastWasUpgrade_ = false;
+    ApplyLevel();
+}
+
+void QualityGovernor::SetConfig(const WorldConfig& config) {
+    config_ = config;
+    ApplyLevel();
+}
+
+void QualityGovernor::ApplyLevel() {
+    const QualityLevel& settings = LEVELS[level_];
+    if (light_)
+    {
+        // Keep the config's first cascades and squeeze them so the last one ends at the level's distance
+        const Vector4& configSplits = config_.cascadeSplits_;
+        unsigned numSplits = 0;
+        while (numSplits < 4 && configSplits.Data()[numSplits] > 0.0f)
+            ++numSplits;
+        float splits[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        unsigned used = Min(settings.cascades_, numSplits);
+        if (used)
+        {
+            float scale = settings.shadowDistance_ * configSplits.Data()[numSplits - 1] / configSplits.Data()[used - 1];
+            for (unsigned i = 0; i < used; ++i)
+                splits[i] = configSplits.Data()[i] * scale;
+        }
+        light_->SetShadowCascade(CascadeParameters(splits[0], splits[1], splits[2], splits[3],
+                                                   config_.cascadeFadeStart_));
+    }
+    if (emitter_)
+        emitter_->SetMaxParticles((unsigned)RoundToInt(config_.fireParticles_ * settings.particles_));
+    if (camera_)
+        camera_->SetFarClip(config_.farClip_ * settings.farClip_);
+    for (WeakPtr<InstancedPopulation>& population : populations_)
+    {
+        if (population)
+            population->SetDensity(settings.populationDensity_);
+    }
+    if (streamer_)
+        streamer_->SetMushroomDensity(settings.populationDensity_);
+}
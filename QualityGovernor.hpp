@@ -0,0 +1,124 @@
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Graphics/Camera.h>
+#include <Urho3D/Graphics/Light.h>
+
+#include "ChunkStreamer.hpp"
+#include "InstancedPopulation.hpp"
+#include "SoaParticleEmitter.hpp"
+#include "WorldConfig.hpp"
+
+using namespace Urho3D;
+
+/// Settings of one quality step, as fractions of the world config's values.
+struct QualityLevel {
+    const char* name_;
+    /// Most shadow cascades used, the config's first ones.
+    unsigned cascades_;
+    /// Where the last used cascade ends, as a fraction of where the config's last cascade ends. The used
+    /// splits are scaled together.
+    float shadowDistance_;
+    /// Fraction of the config's fire particles.
+    float particles_;
+    /// Fraction of the config's far clip.
+    float farClip_;
+    /// Fraction of the mushrooms that are drawn.
+    float populationDensity_;
+};
+
+/// One level change and why it was made.
+struct QualityDecision {
+    unsigned frame_;
+    unsigned from_;
+    unsigned to_;
+    float meanFrameMs_;
+};
+
+/**
+* Steps quality down when frames are too slow and back up when there is
+* headroom, to hold a target frame time. Frame times are averaged over a
+* window of frames and a decision is made once per full window, after which
+* the window starts over so the new level is judged on its own frames.
+*
+* Stepping down needs one slow window. Stepping up needs several fast ones,
+* and twice as many again every time a step up to that level had to be taken
+* back, so a level the machine can almost but not quite hold is not retried
+* over and over.
+*
+* Levels scale the world config's values. Starts at the highest level, which
+* is the config unchanged.
+*/
+class QualityGovernor : public Object {
+
+    URHO3D_OBJECT(QualityGovernor, Object);
+
+public:
+    QualityGovernor(Context* context, float targetFrameMs);
+
+    void SetLight(Light* light) { light_ = light; }
+
+    void SetParticleEmitter(SoaParticleEmitter* emitter) { emitter_ = emitter; }
+
+    void SetCamera(Camera* camera) { camera_ = camera; }
+
+    void AddPopulation(InstancedPopulation* population) { populations_.Push(WeakPtr<InstancedPopulation>(population)); }
+
+    void SetStreamer(ChunkStreamer* streamer) { streamer_ = streamer; }
+
+    /// The values the levels scale. Applies the current level again, call after the config was reloaded.
+    void SetConfig(const WorldConfig& config);
+
+    /// Call once per frame, measures the wall time since the last call.
+    void Update();
+
+    /// Feed one frame time, for when the caller measures frames itself.
+    void AddFrameTime(float frameMs);
+
+    void SetLevel(unsigned level);
+
+    unsigned GetLevel() const { return level_; }
+
+    unsigned GetNumLevels() const;
+
+    static const QualityLevel& GetLevelSettings(unsigned level);
+
+    float GetTargetFrameMs() const { return targetFrameMs_; }
+
+    const PODVector<QualityDecision>& GetDecisions() const { return decisions_; }
+
+    /// Frames a decision is based on.
+    static const unsigned WINDOW = 60;
+
+    /// Fast windows in a row needed to step up to a level that never had to be taken back.
+    static const unsigned UPGRADE_WINDOWS = 3;
+
+private:
+    void Decide(float meanFrameMs);
+
+    void ApplyLevel();
+
+    float targetFrameMs_;
+    unsigned level_;
+    unsigned frame_;
+
+    HiresTimer frameTimer_;
+    bool timing_;
+    float windowSum_;
+    unsigned windowFrames_;
+    unsigned fastWindows_;
+    /// Times a step up to each level was followed by a step back down.
+    PODVector<unsigned> failedUpgrades_;
+    /// The last change was a step up, so a step down right after it counts as a failed upgrade.
+    bool lastWasUpgrade_;
+
+    WeakPtr<Light> light_;
+    WeakPtr<SoaParticleEmitter> emitter_;
+    WeakPtr<Camera> camera_;
+    Vector<WeakPtr<InstancedPopulation> > populations_;
+    WeakPtr<ChunkStreamer> streamer_;
+    WorldConfig config_;
+
+    PODVector<QualityDecision> decisions_;
+};
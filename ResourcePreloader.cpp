@@ -0,0 +1,101 @@
+#include "ResourcePreloader.hpp"
+#include "Trace.hpp"
+
+#include <Urho3D/IO/Log.h>
+
+ResourcePreloader::ResourcePreloader(Context* context)
+                :Object(context),
+                numFinished_(0),
+                numFailed_(0),
+                started_(false),
+                startNs_(0)
+                {
+}
+
+void ResourcePreloader::Add(StringHash type, const String& name) {
+    Entry entry;
+    entry.type_ = type;
+    entry.name_ = name;
+    manifest_.Push(entry);
+}
+
+void ResourcePreloader::Start() {
+    auto* cache = GetSubsystem<ResourceCache>();
+    startNs_ = Trace::Now();
+    SubscribeToEvent(E_RESOURCEBACKGROUNDLOADED, URHO3D_HANDLER(ResourcePreloader, HandleResourceBackgroundLoaded));
+
+    for (const Entry& entry : manifest_)
+    {
+        if (cache->GetExistingResource(entry.type_, entry.name_))
+        {
+            MarkFinished(true);
+            continue;
+        }
+
+        pending_.Insert(StringHash(entry.name_));
+        // False when the loader would not queue it, or when a load without threading support failed.
+        // Either way no event follows
+        if (!cache->BackgroundLoadResource(entry.type_, entry.name_, true))
+        {
+            URHO3D_LOGERRORF("Failed to preload %s", entry.name_.CString());
+            pending_.Erase(StringHash(entry.name_));
+            MarkFinished(false);
+            continue;
+        }
+
+        // Without threading support the load above completed synchronously and no event follows
+        if (cache->GetExistingResource(entry.type_, entry.name_))
+        {
+            if (Trace::IsEnabled())
+                Trace::Record(Trace::Intern("Load " + entry.name_), startNs_, Trace::Now());
+            pending_.Erase(StringHash(entry.name_));
+            MarkFinished(true);
+        }
+    }
+
+    started_ = true;
+    CheckFinished();
+}
+
+void ResourcePreloader::HandleResourceBackgroundLoaded(StringHash eventType, VariantMap& eventData) {
+    using namespace ResourceBackgroundLoaded;
+
+    const String& name = eventData[P_RESOURCENAME].GetString();
+    // Dependencies of manifest entries (textures, techniques) report here too, only count our own
+    if (!pending_.Erase(StringHash(name)))
+        return;
+
+    if (Trace::IsEnabled())
+        Trace::Record(Trace::Intern("Load " + name), startNs_, Trace::Now());
+    bool success = eventData[P_SUCCESS].GetBool();
+    if (!success)
+        URHO3D_LOGERRORF("Failed to preload %s", name.CString());
+    MarkFinished(success);
+    CheckFinished();
+}
+
+void ResourcePreloader::MarkFinished(bool success) {
+    ++numFinished_;
+    if (!success)
+        ++numFailed_;
+
+    {
+        using namespace PreloadProgress;
+        VariantMap& eventData = GetEventDataMap();
+        eventData[P_FINISHED] = numFinished_;
+        eventData[P_TOTAL] = manifest_.Size();
+        SendEvent(E_PRELOADPROGRESS, eventData);
+    }
+}
+
+void ResourcePreloader::CheckFinished() {
+    if (!IsFinished())
+        return;
+
+    UnsubscribeFromEvent(E_RESOURCEBACKGROUNDLOADED);
+
+    using namespace PreloadFinished;
+    VariantMap& eventData = GetEventDataMap();
+    eventData[P_FAILED] = numFailed_;
+    SendEvent(E_PRELOADFINISHED, eventData);
+}
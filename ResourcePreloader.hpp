@@ -0,0 +1,62 @@
+#pragma once
+
+#include <Urho3D/Container/HashSet.h>
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Resource/ResourceEvents.h>
+
+#include "GameEvents.hpp"
+
+using namespace Urho3D;
+
+/**
+* Loads a manifest of resources on the ResourceCache's background worker
+* threads. Sends E_PRELOADPROGRESS as each one becomes resident and
+* E_PRELOADFINISHED once all of them are, at which point GetResource calls
+* for manifest entries return immediately.
+*/
+class ResourcePreloader : public Object {
+
+    URHO3D_OBJECT(ResourcePreloader, Object);
+
+public:
+    explicit ResourcePreloader(Context* context);
+
+    void Add(StringHash type, const String& name);
+
+    template <class T> void Add(const String& name) { Add(T::GetTypeStatic(), name); }
+
+    /// Queue every manifest entry for background loading.
+    void Start();
+
+    unsigned GetNumResources() const { return manifest_.Size(); }
+
+    unsigned GetNumFinished() const { return numFinished_; }
+
+    unsigned GetNumFailed() const { return numFailed_; }
+
+    float GetProgress() const { return manifest_.Empty() ? 1.0f : (float)numFinished_ / manifest_.Size(); }
+
+    bool IsFinished() const { return started_ && pending_.Empty(); }
+
+private:
+    struct Entry {
+        StringHash type_;
+        String name_;
+    };
+
+    void HandleResourceBackgroundLoaded(StringHash eventType, VariantMap& eventData);
+
+    void MarkFinished(bool success);
+
+    void CheckFinished();
+
+    Vector<Entry> manifest_;
+    /// Name hashes of resources still being loaded.
+    HashSet<StringHash> pending_;
+    unsigned numFinished_;
+    unsigned numFailed_;
+    bool started_;
+    /// When the loads were queued, each load is traced from here until it is resident.
+    long long startNs_;
+};
@@ -0,0 +1,426 @@
+#include "Snapshot.hpp"
+
+#include <algorithm>
+
+namespace {
+
+const float POSITION_STEP = 2.0f * SnapshotCodec::POSITION_RANGE / (float)(1u << SnapshotCodec::POSITION_BITS);
+const unsigned DIRECTION_MAX = (1u << SnapshotCodec::DIRECTION_BITS) - 1;
+
+// Residual size classes: zero, small, medium, or the absolute position when the prediction is far off
+enum ResidualClass { RESIDUAL_ZERO = 0, RESIDUAL_SMALL, RESIDUAL_MEDIUM, RESIDUAL_ABSOLUTE };
+const unsigned SMALL_BITS = 3;
+const unsigned MEDIUM_BITS = 10;
+
+unsigned ZigZag(int value) { return ((unsigned)value << 1) ^ (unsigned)(value >> 31); }
+
+int UnZigZag(unsigned value) { return (int)(value >> 1) ^ -(int)(value & 1); }
+
+float SignNotZero(float value) { return value >= 0.0f ? 1.0f : -1.0f; }
+
+void Predict(const EntityState& baseline, float distance, int* predicted) {
+    Vector3 direction = SnapshotCodec::DecodeDirection(baseline.direction_);
+    Vector3 travel = direction * (distance / POSITION_STEP);
+    predicted[0] = baseline.position_[0] + RoundToInt(travel.x_);
+    predicted[1] = baseline.position_[1] + RoundToInt(travel.y_);
+    predicted[2] = baseline.position_[2] + RoundToInt(travel.z_);
+}
+
+void WriteFullState(BitWriter& writer, const EntityState& state) {
+    for (unsigned a = 0; a < 3; ++a)
+        writer.Write((unsigned)state.position_[a], SnapshotCodec::POSITION_BITS);
+    writer.Write(state.direction_, SnapshotCodec::DIRECTION_BITS * 2);
+}
+
+void ReadFullState(BitReader& reader, EntityState& state) {
+    for (unsigned a = 0; a < 3; ++a)
+        state.position_[a] = (int)reader.Read(SnapshotCodec::POSITION_BITS);
+    state.direction_ = reader.Read(SnapshotCodec::DIRECTION_BITS * 2);
+}
+
+void WriteDelta(BitWriter& writer, const EntityState& baseline, const EntityState& current, float distance) {
+    int predicted[3];
+    Predict(baseline, distance, predicted);
+
+    bool directionChanged = current.direction_ != baseline.direction_;
+    bool onPath = !directionChanged && current.position_[0] == predicted[0] &&
+                  current.position_[1] == predicted[1] && current.position_[2] == predicted[2];
+    writer.WriteBit(!onPath);
+    if (onPath)
+        return;
+
+    writer.WriteBit(directionChanged);
+    if (directionChanged)
+        writer.Write(current.direction_, SnapshotCodec::DIRECTION_BITS * 2);
+
+    for (unsigned a = 0; a < 3; ++a)
+    {
+        int residual = current.position_[a] - predicted[a];
+        unsigned zigZag = ZigZag(residual);
+        if (residual == 0)
+            writer.Write(RESIDUAL_ZERO, 2);
+        else if (zigZag < (1u << SMALL_BITS))
+        {
+            writer.Write(RESIDUAL_SMALL, 2);
+            writer.Write(zigZag, SMALL_BITS);
+        }
+        else if (zigZag < (1u << MEDIUM_BITS))
+        {
+            writer.Write(RESIDUAL_MEDIUM, 2);
+            writer.Write(zigZag, MEDIUM_BITS);
+        }
+        else
+        {
+            writer.Write(RESIDUAL_ABSOLUTE, 2);
+            writer.Write((unsigned)current.position_[a], SnapshotCodec::POSITION_BITS);
+        }
+    }
+}
+
+void ReadDelta(BitReader& reader, const EntityState& baseline, EntityState& current, float distance) {
+    int predicted[3];
+    Predict(baseline, distance, predicted);
+
+    current.id_ = baseline.id_;
+    current.direction_ = baseline.direction_;
+    for (unsigned a = 0; a < 3; ++a)
+        current.position_[a] = predicted[a];
+
+    if (!reader.ReadBit())
+        return;
+
+    if (reader.ReadBit())
+        current.direction_ = reader.Read(SnapshotCodec::DIRECTION_BITS * 2);
+
+    for (unsigned a = 0; a < 3; ++a)
+    {
+        switch (reader.Read(2))
+        {
+        case RESIDUAL_SMALL:
+            current.position_[a] += UnZigZag(reader.Read(SMALL_BITS));
+            break;
+        case RESIDUAL_MEDIUM:
+            current.position_[a] += UnZigZag(reader.Read(MEDIUM_BITS));
+            break;
+        case RESIDUAL_ABSOLUTE:
+            current.position_[a] = (int)reader.Read(SnapshotCodec::POSITION_BITS);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+bool CompareId(const EntityState& lhs, const EntityState& rhs) { return lhs.id_ < rhs.id_; }
+
+}
+
+BitWriter::BitWriter(PODVector<unsigned char>& buffer)
+                :buffer_(buffer),
+                numBits_(buffer.Size() * 8)
+                {
+}
+
+void BitWriter::Write(unsigned value, unsigned bits) {
+    while (bits > 0)
+    {
+        unsigned offset = numBits_ & 7;
+        if (offset == 0)
+            buffer_.Push(0);
+
+        unsigned take = Min(8 - offset, bits);
+        buffer_[numBits_ >> 3] |= (unsigned char)((value & ((1u << take) - 1)) << offset);
+        value >>= take;
+        bits -= take;
+        numBits_ += take;
+    }
+}
+
+void BitWriter::WriteVLE(unsigned value) {
+    do
+    {
+        unsigned group = value & 15;
+        value >>= 4;
+        Write(group, 4);
+        WriteBit(value != 0);
+    } while (value != 0);
+}
+
+BitReader::BitReader(const unsigned char* data, unsigned size)
+                :data_(data),
+                numBits_(size * 8),
+                position_(0),
+                overrun_(false)
+                {
+}
+
+unsigned BitReader::Read(unsigned bits) {
+    if (position_ + bits > numBits_)
+    {
+        overrun_ = true;
+        position_ = numBits_;
+        return 0;
+    }
+
+    unsigned value = 0;
+    unsigned shift = 0;
+    while (bits > 0)
+    {
+        unsigned offset = position_ & 7;
+        unsigned take = Min(8 - offset, bits);
+        value |= (unsigned)((data_[position_ >> 3] >> offset) & ((1u << take) - 1)) << shift;
+        shift += take;
+        bits -= take;
+        position_ += take;
+    }
+    return value;
+}
+
+unsigned BitReader::ReadVLE() {
+    unsigned value = 0;
+    unsigned shift = 0;
+    bool more = true;
+    while (more && shift < 32 && !overrun_)
+    {
+        value |= Read(4) << shift;
+        shift += 4;
+        more = ReadBit();
+    }
+    return value;
+}
+
+namespace SnapshotCodec {
+
+int QuantizePosition(float value) {
+    int maxValue = (int)(1u << POSITION_BITS) - 1;
+    return Clamp(RoundToInt((value + POSITION_RANGE) / POSITION_STEP), 0, maxValue);
+}
+
+float DequantizePosition(int value) {
+    return value * POSITION_STEP - POSITION_RANGE;
+}
+
+unsigned EncodeDirection(const Vector3& direction) {
+    float length = Abs(direction.x_) + Abs(direction.y_) + Abs(direction.z_);
+    float u = 0.0f;
+    float v = 0.0f;
+    if (length > M_EPSILON)
+    {
+        u = direction.x_ / length;
+        v = direction.y_ / length;
+        // Fold the lower hemisphere over the diagonals of the square
+        if (direction.z_ < 0.0f)
+        {
+            float foldedU = (1.0f - Abs(v)) * SignNotZero(u);
+            v = (1.0f - Abs(u)) * SignNotZero(v);
+            u = foldedU;
+        }
+    }
+
+    unsigned qu = (unsigned)RoundToInt((u * 0.5f + 0.5f) * DIRECTION_MAX);
+    unsigned qv = (unsigned)RoundToInt((v * 0.5f + 0.5f) * DIRECTION_MAX);
+    return qu | (qv << DIRECTION_BITS);
+}
+
+Vector3 DecodeDirection(unsigned direction) {
+    float u = (float)(direction & DIRECTION_MAX) / DIRECTION_MAX * 2.0f - 1.0f;
+    float v = (float)((direction >> DIRECTION_BITS) & DIRECTION_MAX) / DIRECTION_MAX * 2.0f - 1.0f;
+    float z = 1.0f - Abs(u) - Abs(v);
+    if (z < 0.0f)
+    {
+        float unfoldedU = (1.0f - Abs(v)) * SignNotZero(u);
+        v = (1.0f - Abs(u)) * SignNotZero(v);
+        u = unfoldedU;
+    }
+    return Vector3(u, v, z).Normalized();
+}
+
+EntityState MakeState(unsigned id, const Vector3& position, const Vector3& direction) {
+    EntityState state;
+    state.id_ = id;
+    state.position_[0] = QuantizePosition(position.x_);
+    state.position_[1] = QuantizePosition(position.y_);
+    state.position_[2] = QuantizePosition(position.z_);
+    state.direction_ = EncodeDirection(direction);
+    return state;
+}
+
+void Encode(const Snapshot& current, const Snapshot* baseline, float speed, PODVector<unsigned char>& out) {
+    out.Clear();
+    BitWriter writer(out);
+    writer.Write(current.sequence_, 32);
+    writer.Write(baseline ? baseline->sequence_ : NO_BASELINE, 32);
+    writer.Write(current.timeUs_, 32);
+
+    const PODVector<EntityState>& entities = current.entities_;
+    unsigned j = 0;
+    // Entities not in the baseline are written after the kept ones; remember where they are
+    static thread_local PODVector<unsigned> added;
+    added.Clear();
+
+    if (baseline)
+    {
+        float distance = speed * (current.timeUs_ - baseline->timeUs_) * 0.000001f;
+        for (const EntityState& old : baseline->entities_)
+        {
+            while (j < entities.Size() && entities[j].id_ < old.id_)
+                added.Push(j++);
+
+            bool present = j < entities.Size() && entities[j].id_ == old.id_;
+            writer.WriteBit(present);
+            if (present)
+                WriteDelta(writer, old, entities[j++], distance);
+        }
+    }
+    while (j < entities.Size())
+        added.Push(j++);
+
+    writer.WriteVLE(added.Size());
+    unsigned previousId = 0;
+    for (unsigned index : added)
+    {
+        const EntityState& state = entities[index];
+        writer.WriteVLE(state.id_ - previousId);
+        WriteFullState(writer, state);
+        previousId = state.id_;
+    }
+}
+
+bool ReadHeader(const unsigned char* data, unsigned size, unsigned& sequence, unsigned& baselineSequence) {
+    BitReader reader(data, size);
+    sequence = reader.Read(32);
+    baselineSequence = reader.Read(32);
+    return !reader.IsOverrun();
+}
+
+bool Decode(const unsigned char* data, unsigned size, const Snapshot* baseline, float speed, Snapshot& out) {
+    BitReader reader(data, size);
+    out.sequence_ = reader.Read(32);
+    unsigned baselineSequence = reader.Read(32);
+    out.timeUs_ = reader.Read(32);
+    out.entities_.Clear();
+
+    if (baselineSequence != NO_BASELINE)
+    {
+        if (!baseline || baseline->sequence_ != baselineSequence)
+            return false;
+
+        float distance = speed * (out.timeUs_ - baseline->timeUs_) * 0.000001f;
+        for (const EntityState& old : baseline->entities_)
+        {
+            if (!reader.ReadBit())
+                continue;
+            EntityState state;
+            ReadDelta(reader, old, state, distance);
+            out.entities_.Push(state);
+        }
+    }
+
+    unsigned numKept = out.entities_.Size();
+    unsigned numAdded = reader.ReadVLE();
+    if (reader.IsOverrun())
+        return false;
+
+    unsigned id = 0;
+    for (unsigned i = 0; i < numAdded; ++i)
+    {
+        EntityState state;
+        id += reader.ReadVLE();
+        state.id_ = id;
+        ReadFullState(reader, state);
+        if (reader.IsOverrun())
+            return false;
+        out.entities_.Push(state);
+    }
+
+    // Kept and added entities are each sorted by id, merge them back into one sorted list
+    EntityState* begin = out.entities_.Buffer();
+    std::inplace_merge(begin, begin + numKept, begin + out.entities_.Size(), CompareId);
+    return true;
+}
+
+}
+
+ReplicationServer::ReplicationServer(float speed)
+                :speed_(speed),
+                nextSequence_(0)
+                {
+}
+
+unsigned ReplicationServer::AddClient() {
+    clientAcks_.Push(SnapshotCodec::NO_BASELINE);
+    return clientAcks_.Size() - 1;
+}
+
+void ReplicationServer::Capture(Snapshot& snapshot) {
+    Snapshot& slot = history_[nextSequence_ % HISTORY_SIZE];
+    slot.sequence_ = snapshot.sequence_ = nextSequence_++;
+    slot.timeUs_ = snapshot.timeUs_;
+    // Hand the evicted snapshot's storage back to the caller for the next capture
+    slot.entities_.Swap(snapshot.entities_);
+}
+
+void ReplicationServer::BuildPacket(unsigned client, PODVector<unsigned char>& out) const {
+    if (!nextSequence_)
+    {
+        out.Clear();
+        return;
+    }
+
+    const Snapshot& latest = history_[(nextSequence_ - 1) % HISTORY_SIZE];
+    SnapshotCodec::Encode(latest, GetSnapshot(clientAcks_[client]), speed_, out);
+}
+
+void ReplicationServer::Acknowledge(unsigned client, unsigned sequence) {
+    unsigned& ack = clientAcks_[client];
+    // Acks can arrive out of order, only move forward
+    if (ack == SnapshotCodec::NO_BASELINE || (int)(sequence - ack) > 0)
+        ack = sequence;
+}
+
+const Snapshot* ReplicationServer::GetSnapshot(unsigned sequence) const {
+    if (sequence == SnapshotCodec::NO_BASELINE || sequence >= nextSequence_ || nextSequence_ - sequence > HISTORY_SIZE)
+        return nullptr;
+    return &history_[sequence % HISTORY_SIZE];
+}
+
+ReplicationClient::ReplicationClient(float speed)
+                :speed_(speed),
+                latest_(0),
+                hasLatest_(false)
+                {
+    for (Snapshot& snapshot : history_)
+        snapshot.sequence_ = SnapshotCodec::NO_BASELINE;
+}
+
+bool ReplicationClient::Receive(const unsigned char* data, unsigned size, unsigned& ackSequence) {
+    unsigned sequence, baselineSequence;
+    if (!SnapshotCodec::ReadHeader(data, size, sequence, baselineSequence))
+        return false;
+    // Drop snapshots older than the one we already have
+    if (hasLatest_ && (int)(sequence - latest_) <= 0)
+        return false;
+
+    const Snapshot* baseline = nullptr;
+    if (baselineSequence != SnapshotCodec::NO_BASELINE)
+    {
+        baseline = &history_[baselineSequence % ReplicationServer::HISTORY_SIZE];
+        if (baseline->sequence_ != baselineSequence)
+            return false;
+    }
+
+    // The slot being overwritten may be the baseline only if the history wrapped, which the server never encodes against
+    Snapshot& slot = history_[sequence % ReplicationServer::HISTORY_SIZE];
+    if (&slot == baseline)
+        return false;
+    if (!SnapshotCodec::Decode(data, size, baseline, speed_, slot))
+    {
+        slot.sequence_ = SnapshotCodec::NO_BASELINE;
+        return false;
+    }
+
+    latest_ = sequence;
+    hasLatest_ = true;
+    ackSequence = sequence;
+    return true;
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Math/Vector3.h>
+
+using namespace Urho3D;
+
+/// Appends values of arbitrary bit width to a byte buffer.
+class BitWriter {
+public:
+    explicit BitWriter(PODVector<unsigned char>& buffer);
+
+    void Write(unsigned value, unsigned bits);
+
+    void WriteBit(bool value) { Write(value ? 1u : 0u, 1); }
+
+    /// Variable length unsigned, four bits per group plus a continuation bit.
+    void WriteVLE(unsigned value);
+
+    unsigned GetNumBits() const { return numBits_; }
+
+private:
+    PODVector<unsigned char>& buffer_;
+    unsigned numBits_;
+};
+
+class BitReader {
+public:
+    BitReader(const unsigned char* data, unsigned size);
+
+    unsigned Read(unsigned bits);
+
+    bool ReadBit() { return Read(1) != 0; }
+
+    unsigned ReadVLE();
+
+    /// True if a read went past the end of the data.
+    bool IsOverrun() const { return overrun_; }
+
+private:
+    const unsigned char* data_;
+    unsigned numBits_;
+    unsigned position_;
+    bool overrun_;
+};
+
+/// Replicated state of one entity, already quantized.
+struct EntityState {
+    unsigned id_;
+    int position_[3];
+    /// Octahedral encoded unit direction.
+    unsigned direction_;
+
+    bool operator ==(const EntityState& rhs) const {
+        return id_ == rhs.id_ && position_[0] == rhs.position_[0] && position_[1] == rhs.position_[1] &&
+               position_[2] == rhs.position_[2] && direction_ == rhs.direction_;
+    }
+};
+
+struct Snapshot {
+    unsigned sequence_ = 0;
+    unsigned timeUs_ = 0;
+    /// Sorted by id.
+    PODVector<EntityState> entities_;
+};
+
+/**
+* Binary snapshot format. A snapshot is encoded against a baseline the
+* receiver has acknowledged, or in full when there is none:
+*
+*   header      sequence, baseline sequence (NO_BASELINE for a full snapshot), time in microseconds
+*   kept        for each baseline entity in id order: present bit, changed bit, then the change
+*   new         count, then per entity an id delta and the full quantized state
+*
+* Entities move in a straight line at a known speed, so a kept entity's position
+* is predicted from the baseline and only the residual is sent, in one of four
+* size classes per axis. An entity on its predicted path costs two bits.
+*/
+namespace SnapshotCodec {
+
+static const unsigned NO_BASELINE = 0xffffffff;
+
+static const float POSITION_RANGE = 1024.0f;
+static const unsigned POSITION_BITS = 18;
+static const unsigned DIRECTION_BITS = 11;
+
+int QuantizePosition(float value);
+
+float DequantizePosition(int value);
+
+unsigned EncodeDirection(const Vector3& direction);
+
+Vector3 DecodeDirection(unsigned direction);
+
+EntityState MakeState(unsigned id, const Vector3& position, const Vector3& direction);
+
+/// Encode current against baseline (may be null). speed is the speed entities travel along their direction.
+void Encode(const Snapshot& current, const Snapshot* baseline, float speed, PODVector<unsigned char>& out);
+
+/// Read the sequence numbers so the receiver can find the baseline before decoding.
+bool ReadHeader(const unsigned char* data, unsigned size, unsigned& sequence, unsigned& baselineSequence);
+
+bool Decode(const unsigned char* data, unsigned size, const Snapshot* baseline, float speed, Snapshot& out);
+
+}
+
+/**
+* Keeps a short history of snapshots and the last sequence each client
+* acknowledged, so every client gets deltas against what it actually has.
+* A client that has not acknowledged anything still in the history gets a
+* full snapshot.
+*/
+class ReplicationServer {
+public:
+    explicit ReplicationServer(float speed);
+
+    unsigned AddClient();
+
+    /// Store a new snapshot, its sequence number is assigned here.
+    void Capture(Snapshot& snapshot);
+
+    void BuildPacket(unsigned client, PODVector<unsigned char>& out) const;
+
+    void Acknowledge(unsigned client, unsigned sequence);
+
+    const Snapshot* GetSnapshot(unsigned sequence) const;
+
+    static const unsigned HISTORY_SIZE = 64;
+
+private:
+    float speed_;
+    unsigned nextSequence_;
+    Snapshot history_[HISTORY_SIZE];
+    PODVector<unsigned> clientAcks_;
+};
+
+class ReplicationClient {
+public:
+    explicit ReplicationClient(float speed);
+
+    /// Decode a packet. On success returns the sequence to acknowledge.
+    bool Receive(const unsigned char* data, unsigned size, unsigned& ackSequence);
+
+    const Snapshot& GetLatest() const { return history_[latest_ % ReplicationServer::HISTORY_SIZE]; }
+
+private:
+    float speed_;
+    unsigned latest_;
+    bool hasLatest_;
+    Snapshot history_[ReplicationServer::HISTORY_SIZE];
+};
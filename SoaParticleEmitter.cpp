@@ -0,0 +1,390 @@
+#include "SoaParticleEmitter.hpp"
+#include "AllocationTracker.hpp"
+#include "Trace.hpp"
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Graphics/Material.h>
+#include <Urho3D/Math/Random.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Scene/Node.h>
+#include <Urho3D/Scene/Scene.h>
+#include <Urho3D/Scene/SceneEvents.h>
+
+#ifdef URHO3D_SSE
+#include <xmmintrin.h>
+#endif
+
+SoaParticleEmitter::SoaParticleEmitter(Context* context)
+                :BillboardSet(context),
+                jobSystem_(nullptr),
+                capacity_(0),
+                capacityFromEffect_(true),
+                count_(0),
+                numWritten_(0),
+                emitting_(true),
+                emissionTimer_(0.0f),
+                periodTimer_(0.0f),
+                dampingForce_(0.0f),
+                sizeAdd_(0.0f),
+                sizeMul_(1.0f)
+                {
+}
+
+void SoaParticleEmitter::RegisterObject(Context* context) {
+    context->RegisterFactory<SoaParticleEmitter>("Effect");
+
+    // The billboards are output, rebuilt every frame, so they are not saved
+    URHO3D_COPY_BASE_ATTRIBUTES(BillboardSet);
+    URHO3D_REMOVE_ATTRIBUTE("Billboards");
+    URHO3D_REMOVE_ATTRIBUTE("Network Billboards");
+    URHO3D_MIXED_ACCESSOR_ATTRIBUTE("Effect", GetEffectAttr, SetEffectAttr, ResourceRef, ResourceRef(ParticleEffect::GetTypeStatic()), AM_DEFAULT);
+    URHO3D_ACCESSOR_ATTRIBUTE("Max Particles", GetMaxParticles, SetMaxParticles, unsigned, 0, AM_DEFAULT);
+    URHO3D_ACCESSOR_ATTRIBUTE("Is Emitting", IsEmitting, SetEmitting, bool, true, AM_DEFAULT);
+}
+
+void SoaParticleEmitter::SetEffect(ParticleEffect* effect) {
+    effect_ = effect;
+    if (!effect_)
+        return;
+
+    // The effect decides how the billboards are drawn, as with ParticleEmitter
+    SetMaterial(effect_->GetMaterial());
+    SetSorted(effect_->IsSorted());
+    SetRelative(effect_->IsRelative());
+    SetScaled(effect_->IsScaled());
+    SetFixedScreenSize(effect_->IsFixedScreenSize());
+    SetFaceCameraMode(effect_->GetFaceCameraMode());
+    periodTimer_ = 0.0f;
+    emissionTimer_ = 0.0f;
+    if (capacityFromEffect_)
+        ResizePool(effect_->GetNumParticles());
+}
+
+void SoaParticleEmitter::SetMaxParticles(unsigned count) {
+    capacityFromEffect_ = count == 0;
+    if (capacityFromEffect_)
+        count = effect_ ? effect_->GetNumParticles() : 0;
+    ResizePool(count);
+}
+
+void SoaParticleEmitter::ResizePool(unsigned count) {
+    if (count == capacity_)
+        return;
+
+    capacity_ = count;
+    count_ = Min(count_, capacity_);
+    numWritten_ = Min(numWritten_, capacity_);
+
+    unsigned padded = (capacity_ + 3) & ~3u;
+    PODVector<float>* arrays[] = {&posX_, &posY_, &posZ_, &velX_, &velY_, &velZ_, &timer_, &timeToLive_, &scale_,
+                                  &sizeX_, &sizeY_, &rotation_, &rotationSpeed_};
+    for (PODVector<float>* array : arrays)
+    {
+        array->Resize(padded);
+        // The padding is integrated along with the live particles, keep it finite
+        for (unsigned i = count_; i < padded; ++i)
+            (*array)[i] = 0.0f;
+    }
+
+    // New billboards start out disabled
+    SetNumBillboards(capacity_);
+}
+
+void SoaParticleEmitter::SetEmitting(bool enable) {
+    if (enable == emitting_)
+        return;
+    emitting_ = enable;
+    periodTimer_ = 0.0f;
+}
+
+unsigned SoaParticleEmitter::Burst(const Vector3& position, unsigned count) {
+    if (!effect_)
+        return 0;
+
+    // Emitter shape around position, oriented like the node, in the space the particles live in
+    Matrix3x4 transform(position, Quaternion::IDENTITY, 1.0f);
+    if (node_)
+    {
+        if (effect_->IsRelative())
+            transform = Matrix3x4(node_->GetWorldTransform().Inverse() * position, Quaternion::IDENTITY, 1.0f);
+        else
+            transform = Matrix3x4(position, node_->GetWorldRotation(), 1.0f);
+    }
+
+    unsigned emitted = 0;
+    while (emitted < count && EmitParticle(transform))
+        ++emitted;
+    return emitted;
+}
+
+bool SoaParticleEmitter::EmitParticle(const Matrix3x4& transform) {
+    if (count_ >= capacity_)
+        return false;
+
+    Vector3 start;
+    const Vector3& size = effect_->GetEmitterSize();
+    switch (effect_->GetEmitterType())
+    {
+    case EMITTER_BOX:
+        start = Vector3(Random(size.x_) - size.x_ * 0.5f, Random(size.y_) - size.y_ * 0.5f, Random(size.z_) - size.z_ * 0.5f);
+        break;
+
+    default:
+        {
+            Vector3 direction(Random(2.0f) - 1.0f, Random(2.0f) - 1.0f, Random(2.0f) - 1.0f);
+            direction.Normalize();
+            start = size * direction * 0.5f;
+        }
+        break;
+    }
+    start = transform * start;
+    Vector3 velocity = transform * Vector4(effect_->GetRandomDirection(), 0.0f) * effect_->GetRandomVelocity();
+    Vector2 particleSize = effect_->GetRandomSize();
+
+    unsigned i = count_++;
+    posX_[i] = start.x_;
+    posY_[i] = start.y_;
+    posZ_[i] = start.z_;
+    velX_[i] = velocity.x_;
+    velY_[i] = velocity.y_;
+    velZ_[i] = velocity.z_;
+    timer_[i] = 0.0f;
+    timeToLive_[i] = effect_->GetRandomTimeToLive();
+    scale_[i] = 1.0f;
+    sizeX_[i] = particleSize.x_;
+    sizeY_[i] = particleSize.y_;
+    rotation_[i] = effect_->GetRandomRotation();
+    rotationSpeed_[i] = effect_->GetRandomRotationSpeed();
+    return true;
+}
+
+void SoaParticleEmitter::Simulate(float timeStep) {
+    if (!effect_ || !capacity_)
+        return;
+
+    TraceScope trace("SoaParticleEmitter::Simulate");
+    AllocationScope allocations(ALLOC_PARTICLES);
+    ExpireParticles();
+
+    // Emission follows ParticleEmitter: active and inactive periods, a random interval between particles
+    periodTimer_ += timeStep;
+    if (emitting_)
+    {
+        float activeTime = effect_->GetActiveTime();
+        if (activeTime > 0.0f && periodTimer_ >= activeTime)
+        {
+            emitting_ = false;
+            periodTimer_ = 0.0f;
+        }
+    }
+    else
+    {
+        float inactiveTime = effect_->GetInactiveTime();
+        if (inactiveTime > 0.0f && periodTimer_ >= inactiveTime)
+        {
+            emitting_ = true;
+            periodTimer_ = 0.0f;
+        }
+    }
+    if (emitting_ && effect_->GetMinEmissionRate() > 0.0f)
+    {
+        float intervalMin = 1.0f / effect_->GetMaxEmissionRate();
+        float intervalMax = 1.0f / effect_->GetMinEmissionRate();
+        emissionTimer_ = Max(emissionTimer_ + timeStep, -intervalMax);
+
+        Matrix3x4 transform = Matrix3x4::IDENTITY;
+        if (node_ && !effect_->IsRelative())
+            transform = node_->GetWorldTransform();
+        while (emissionTimer_ > 0.0f)
+        {
+            // A full pool drops the backlog instead of emitting it all at once later
+            if (!EmitParticle(transform))
+            {
+                emissionTimer_ = 0.0f;
+                break;
+            }
+            emissionTimer_ -= Lerp(intervalMin, intervalMax, Random(1.0f));
+        }
+    }
+
+    constantForce_ = effect_->GetConstantForce();
+    if (node_ && effect_->IsRelative())
+        constantForce_ = node_->GetWorldRotation().Inverse() * constantForce_;
+    dampingForce_ = effect_->GetDampingForce();
+    sizeAdd_ = effect_->GetSizeAdd();
+    sizeMul_ = effect_->GetSizeMul();
+
+    if (jobSystem_ && count_ > JOB_GRAIN)
+    {
+        jobGraph_.Clear();
+        jobGraph_.AddParallelFor(count_, JOB_GRAIN, [this, timeStep](unsigned begin, unsigned end) {
+            TraceScope trace("SoaParticleEmitter::Integrate");
+            IntegrateRange(begin, end, timeStep);
+            WriteBillboards(begin, end);
+        }, 4);
+        jobSystem_->Run(jobGraph_);
+    }
+    else
+    {
+        IntegrateRange(0, count_, timeStep);
+        WriteBillboards(0, count_);
+    }
+
+    // Billboards of particles that expired since the last write
+    for (unsigned i = count_; i < numWritten_; ++i)
+        billboards_[i].enabled_ = false;
+    numWritten_ = count_;
+    Commit();
+}
+
+void SoaParticleEmitter::IntegrateRange(unsigned begin, unsigned end, float timeStep) {
+    float damping = 1.0f - dampingForce_ * timeStep;
+    float sizeAdd = sizeAdd_ * timeStep;
+    float sizeMul = (sizeMul_ - 1.0f) * timeStep + 1.0f;
+    Vector3 force = constantForce_ * timeStep;
+
+    float* px = &posX_[0];
+    float* py = &posY_[0];
+    float* pz = &posZ_[0];
+    float* vx = &velX_[0];
+    float* vy = &velY_[0];
+    float* vz = &velZ_[0];
+    float* timer = &timer_[0];
+    float* scale = &scale_[0];
+    float* rotation = &rotation_[0];
+    const float* rotationSpeed = &rotationSpeed_[0];
+
+    unsigned i = begin;
+#ifdef URHO3D_SSE
+    // Ranges start on a multiple of four and the arrays are padded, so the last group may run into the padding
+    unsigned simdEnd = (end + 3) & ~3u;
+    __m128 dt = _mm_set1_ps(timeStep);
+    __m128 fx = _mm_set1_ps(force.x_);
+    __m128 fy = _mm_set1_ps(force.y_);
+    __m128 fz = _mm_set1_ps(force.z_);
+    __m128 damp = _mm_set1_ps(damping);
+    __m128 add = _mm_set1_ps(sizeAdd);
+    __m128 mul = _mm_set1_ps(sizeMul);
+    __m128 zero = _mm_setzero_ps();
+    for (; i < simdEnd; i += 4)
+    {
+        __m128 x = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(vx + i), fx), damp);
+        __m128 y = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(vy + i), fy), damp);
+        __m128 z = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(vz + i), fz), damp);
+        _mm_storeu_ps(vx + i, x);
+        _mm_storeu_ps(vy + i, y);
+        _mm_storeu_ps(vz + i, z);
+        _mm_storeu_ps(px + i, _mm_add_ps(_mm_loadu_ps(px + i), _mm_mul_ps(x, dt)));
+        _mm_storeu_ps(py + i, _mm_add_ps(_mm_loadu_ps(py + i), _mm_mul_ps(y, dt)));
+        _mm_storeu_ps(pz + i, _mm_add_ps(_mm_loadu_ps(pz + i), _mm_mul_ps(z, dt)));
+        _mm_storeu_ps(timer + i, _mm_add_ps(_mm_loadu_ps(timer + i), dt));
+        _mm_storeu_ps(rotation + i, _mm_add_ps(_mm_loadu_ps(rotation + i), _mm_mul_ps(_mm_loadu_ps(rotationSpeed + i), dt)));
+        __m128 s = _mm_max_ps(_mm_add_ps(_mm_loadu_ps(scale + i), add), zero);
+        _mm_storeu_ps(scale + i, _mm_mul_ps(s, mul));
+    }
+#endif
+    for (; i < end; ++i)
+    {
+        vx[i] = (vx[i] + force.x_) * damping;
+        vy[i] = (vy[i] + force.y_) * damping;
+        vz[i] = (vz[i] + force.z_) * damping;
+        px[i] += vx[i] * timeStep;
+        py[i] += vy[i] * timeStep;
+        pz[i] += vz[i] * timeStep;
+        timer[i] += timeStep;
+        rotation[i] += rotationSpeed[i] * timeStep;
+        scale[i] = Max(scale[i] + sizeAdd, 0.0f) * sizeMul;
+    }
+}
+
+void SoaParticleEmitter::ExpireParticles() {
+    for (unsigned i = 0; i < count_;)
+    {
+        if (timer_[i] >= timeToLive_[i])
+            RemoveParticle(i);
+        else
+            ++i;
+    }
+}
+
+void SoaParticleEmitter::RemoveParticle(unsigned index) {
+    // Swap with the last live particle, so the live ones stay packed
+    unsigned last = --count_;
+    posX_[index] = posX_[last];
+    posY_[index] = posY_[last];
+    posZ_[index] = posZ_[last];
+    velX_[index] = velX_[last];
+    velY_[index] = velY_[last];
+    velZ_[index] = velZ_[last];
+    timer_[index] = timer_[last];
+    timeToLive_[index] = timeToLive_[last];
+    scale_[index] = scale_[last];
+    sizeX_[index] = sizeX_[last];
+    sizeY_[index] = sizeY_[last];
+    rotation_[index] = rotation_[last];
+    rotationSpeed_[index] = rotationSpeed_[last];
+}
+
+void SoaParticleEmitter::WriteBillboards(unsigned begin, unsigned end) {
+    const Vector<ColorFrame>& colorFrames = effect_->GetColorFrames();
+    const Vector<TextureFrame>& textureFrames = effect_->GetTextureFrames();
+    unsigned numColorFrames = colorFrames.Size();
+    unsigned numTextureFrames = textureFrames.Size();
+    bool direction = faceCameraMode_ == FC_DIRECTION;
+
+    for (unsigned i = begin; i < end; ++i)
+    {
+        Billboard& billboard = billboards_[i];
+        float time = timer_[i];
+        billboard.position_ = Vector3(posX_[i], posY_[i], posZ_[i]);
+        billboard.size_ = Vector2(sizeX_[i], sizeY_[i]) * scale_[i];
+        billboard.rotation_ = rotation_[i];
+        if (direction)
+            billboard.direction_ = Vector3(velX_[i], velY_[i], velZ_[i]).Normalized();
+
+        // Effects have a handful of frames, a scan from the start is cheaper than keeping an index per particle
+        if (numColorFrames)
+        {
+            unsigned frame = 0;
+            while (frame + 1 < numColorFrames && time >= colorFrames[frame + 1].time_)
+                ++frame;
+            billboard.color_ = frame + 1 < numColorFrames ? colorFrames[frame].Interpolate(colorFrames[frame + 1], time) :
+                               colorFrames[frame].color_;
+        }
+        if (numTextureFrames)
+        {
+            unsigned frame = 0;
+            while (frame + 1 < numTextureFrames && time >= textureFrames[frame + 1].time_)
+                ++frame;
+            billboard.uv_ = textureFrames[frame].uv_;
+        }
+
+        // A particle past its life this step is hidden now and removed on the next
+        billboard.enabled_ = time < timeToLive_[i];
+    }
+}
+
+void SoaParticleEmitter::SetEffectAttr(const ResourceRef& value) {
+    auto* cache = GetSubsystem<ResourceCache>();
+    SetEffect(cache->GetResource<ParticleEffect>(value.name_));
+}
+
+ResourceRef SoaParticleEmitter::GetEffectAttr() const {
+    return GetResourceRef(effect_, ParticleEffect::GetTypeStatic());
+}
+
+void SoaParticleEmitter::OnSceneSet(Scene* scene) {
+    BillboardSet::OnSceneSet(scene);
+
+    if (scene)
+        SubscribeToEvent(scene, E_SCENEPOSTUPDATE, URHO3D_HANDLER(SoaParticleEmitter, HandleScenePostUpdate));
+    else
+        UnsubscribeFromEvent(E_SCENEPOSTUPDATE);
+}
+
+void SoaParticleEmitter::HandleScenePostUpdate(StringHash eventType, VariantMap& eventData) {
+    using namespace ScenePostUpdate;
+
+    if (IsEnabledEffective())
+        Simulate(eventData[P_TIMESTEP].GetFloat());
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <Urho3D/Graphics/BillboardSet.h>
+#include <Urho3D/Graphics/ParticleEffect.h>
+#include <Urho3D/Resource/Resource.h>
+
+#include "JobSystem.hpp"
+
+using namespace Urho3D;
+
+/**
+* Particle emitter for high particle counts, driven by a standard
+* ParticleEffect so existing effect files such as Particle/Fire.xml work
+* unchanged. Particles live in a pool of structure-of-arrays storage sized
+* once, are integrated four at a time with SIMD, and dead particles are
+* swapped out so the live ones stay packed at the front. The result is
+* written into the BillboardSet this derives from, which the renderer draws
+* from one vertex buffer in one batch.
+*
+* Given a JobSystem, integration and billboard output are split into jobs
+* once there are enough particles to make it worthwhile.
+*/
+class SoaParticleEmitter : public BillboardSet {
+
+    URHO3D_OBJECT(SoaParticleEmitter, BillboardSet);
+
+public:
+    explicit SoaParticleEmitter(Context* context);
+
+    static void RegisterObject(Context* context);
+
+    void SetEffect(ParticleEffect* effect);
+
+    ParticleEffect* GetEffect() const { return effect_; }
+
+    /// Size of the particle pool. Zero takes the effect's particle count.
+    void SetMaxParticles(unsigned count);
+
+    unsigned GetMaxParticles() const { return capacity_; }
+
+    void SetEmitting(bool enable);
+
+    bool IsEmitting() const { return emitting_; }
+
+    void SetJobSystem(JobSystem* jobSystem) { jobSystem_ = jobSystem; }
+
+    /// Emit up to count particles at once from the effect's emitter shape around position. Returns the number emitted.
+    unsigned Burst(const Vector3& position, unsigned count);
+
+    /// Emit, move and expire particles and write the billboards. Called on scene post-update when in a scene.
+    void Simulate(float timeStep);
+
+    unsigned GetNumParticles() const { return count_; }
+
+    void SetEffectAttr(const ResourceRef& value);
+
+    ResourceRef GetEffectAttr() const;
+
+    /// Particles per job when split across a JobSystem.
+    static const unsigned JOB_GRAIN = 16384;
+
+protected:
+    void OnSceneSet(Scene* scene) override;
+
+private:
+    void HandleScenePostUpdate(StringHash eventType, VariantMap& eventData);
+
+    void ResizePool(unsigned count);
+
+    /// Add one particle from the emitter shape placed by transform. Returns false when the pool is full.
+    bool EmitParticle(const Matrix3x4& transform);
+
+    void IntegrateRange(unsigned begin, unsigned end, float timeStep);
+
+    void ExpireParticles();
+
+    void WriteBillboards(unsigned begin, unsigned end);
+
+    void RemoveParticle(unsigned index);
+
+    SharedPtr<ParticleEffect> effect_;
+    JobSystem* jobSystem_;
+    JobGraph jobGraph_;
+
+    unsigned capacity_;
+    /// Set by SetMaxParticles, otherwise the pool follows the effect.
+    bool capacityFromEffect_;
+    unsigned count_;
+    /// Live particles when the billboards were last written, to disable the ones that died since.
+    unsigned numWritten_;
+
+    bool emitting_;
+    float emissionTimer_;
+    float periodTimer_;
+
+    // Structure of arrays, padded to a multiple of four so the SIMD loop never needs a scalar tail
+    PODVector<float> posX_, posY_, posZ_;
+    PODVector<float> velX_, velY_, velZ_;
+    PODVector<float> timer_, timeToLive_;
+    PODVector<float> scale_, sizeX_, sizeY_;
+    PODVector<float> rotation_, rotationSpeed_;
+
+    // Per-step constants of the effect, in the space the particles live in
+    Vector3 constantForce_;
+    float dampingForce_;
+    float sizeAdd_;
+    float sizeMul_;
+};
@@ -0,0 +1,191 @@
+#include "SpatialHash.hpp"
+
+#include <algorithm>
+
+namespace {
+
+/// Slab test of a segment against a box, returning the entry fraction in [0, 1].
+bool SegmentHitsBox(const Vector3& from, const Vector3& delta, const BoundingBox& box, float& fraction) {
+    float tMin = 0.0f;
+    float tMax = 1.0f;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        float origin = from.Data()[axis];
+        float d = delta.Data()[axis];
+        float low = box.min_.Data()[axis];
+        float high = box.max_.Data()[axis];
+
+        if (Abs(d) < M_EPSILON)
+        {
+            if (origin < low || origin > high)
+                return false;
+            continue;
+        }
+
+        float inv = 1.0f / d;
+        float t0 = (low - origin) * inv;
+        float t1 = (high - origin) * inv;
+        if (t0 > t1)
+            Swap(t0, t1);
+        tMin = Max(tMin, t0);
+        tMax = Min(tMax, t1);
+        if (tMin > tMax)
+            return false;
+    }
+    fraction = tMin;
+    return true;
+}
+
+}
+
+SpatialHash::SpatialHash(float cellSize)
+                :cellSize_(cellSize),
+                invCellSize_(1.0f / cellSize),
+                numStatic_(0)
+                {
+}
+
+unsigned SpatialHash::InsertStatic(const BoundingBox& box) {
+    unsigned id;
+    if (!freeStatic_.Empty())
+    {
+        id = freeStatic_.Back();
+        freeStatic_.Pop();
+        staticBoxes_[id] = box;
+        staticUsed_[id] = true;
+    }
+    else
+    {
+        id = staticBoxes_.Size();
+        staticBoxes_.Push(box);
+        staticUsed_.Push(true);
+    }
+    ++numStatic_;
+
+    int x0 = CellCoordinate(box.min_.x_), x1 = CellCoordinate(box.max_.x_);
+    int z0 = CellCoordinate(box.min_.z_), z1 = CellCoordinate(box.max_.z_);
+    for (int x = x0; x <= x1; ++x)
+    {
+        for (int z = z0; z <= z1; ++z)
+            staticCells_[CellKey(x, z)].Push(id);
+    }
+    return id;
+}
+
+void SpatialHash::RemoveStatic(unsigned id) {
+    if (id >= staticBoxes_.Size() || !staticUsed_[id])
+        return;
+
+    const BoundingBox& box = staticBoxes_[id];
+    int x0 = CellCoordinate(box.min_.x_), x1 = CellCoordinate(box.max_.x_);
+    int z0 = CellCoordinate(box.min_.z_), z1 = CellCoordinate(box.max_.z_);
+    for (int x = x0; x <= x1; ++x)
+    {
+        for (int z = z0; z <= z1; ++z)
+        {
+            auto cell = staticCells_.Find(CellKey(x, z));
+            if (cell == staticCells_.End())
+                continue;
+            cell->second_.Remove(id);
+            if (cell->second_.Empty())
+                staticCells_.Erase(cell);
+        }
+    }
+
+    staticUsed_[id] = false;
+    freeStatic_.Push(id);
+    --numStatic_;
+}
+
+void SpatialHash::ClearStatic() {
+    staticBoxes_.Clear();
+    staticUsed_.Clear();
+    freeStatic_.Clear();
+    staticCells_.Clear();
+    numStatic_ = 0;
+}
+
+void SpatialHash::SetDynamicPoints(const float* x, const float* z, unsigned count) {
+    dynamicCells_.Resize(count);
+    for (unsigned i = 0; i < count; ++i)
+    {
+        dynamicCells_[i].cell_ = CellKey(CellCoordinate(x[i]), CellCoordinate(z[i]));
+        dynamicCells_[i].index_ = i;
+    }
+    std::sort(dynamicCells_.Begin(), dynamicCells_.End(), [](const DynamicEntry& a, const DynamicEntry& b) {
+        return a.cell_ < b.cell_;
+    });
+}
+
+bool SpatialHash::SweepStatic(const Vector3& from, const Vector3& to, float& hitFraction, unsigned& hitId) const {
+    if (staticCells_.Empty())
+        return false;
+
+    Vector3 delta = to - from;
+    int x = CellCoordinate(from.x_);
+    int z = CellCoordinate(from.z_);
+    int endX = CellCoordinate(to.x_);
+    int endZ = CellCoordinate(to.z_);
+
+    // Walk the cells the segment crosses in order (Amanatides & Woo)
+    int stepX = delta.x_ > 0.0f ? 1 : -1;
+    int stepZ = delta.z_ > 0.0f ? 1 : -1;
+    float tDeltaX = Abs(delta.x_) > M_EPSILON ? cellSize_ / Abs(delta.x_) : M_INFINITY;
+    float tDeltaZ = Abs(delta.z_) > M_EPSILON ? cellSize_ / Abs(delta.z_) : M_INFINITY;
+    float tMaxX = Abs(delta.x_) > M_EPSILON ? ((x + (stepX > 0 ? 1 : 0)) * cellSize_ - from.x_) / delta.x_ : M_INFINITY;
+    float tMaxZ = Abs(delta.z_) > M_EPSILON ? ((z + (stepZ > 0 ? 1 : 0)) * cellSize_ - from.z_) / delta.z_ : M_INFINITY;
+
+    bool hit = false;
+    hitFraction = M_INFINITY;
+    for (;;)
+    {
+        auto cell = staticCells_.Find(CellKey(x, z));
+        if (cell != staticCells_.End())
+        {
+            for (unsigned id : cell->second_)
+            {
+                float fraction;
+                if (SegmentHitsBox(from, delta, staticBoxes_[id], fraction) && fraction < hitFraction)
+                {
+                    hitFraction = fraction;
+                    hitId = id;
+                    hit = true;
+                }
+            }
+        }
+
+        // A hit before the segment leaves this cell cannot be beaten by a later cell
+        float cellExit = Min(tMaxX, tMaxZ);
+        if ((hit && hitFraction <= cellExit) || (x == endX && z == endZ) || cellExit > 1.0f)
+            break;
+
+        if (tMaxX < tMaxZ)
+        {
+            x += stepX;
+            tMaxX += tDeltaX;
+        }
+        else
+        {
+            z += stepZ;
+            tMaxZ += tDeltaZ;
+        }
+    }
+    return hit;
+}
+
+void SpatialHash::QueryDynamic(const BoundingBox& box, PODVector<unsigned>& result) const {
+    int x0 = CellCoordinate(box.min_.x_), x1 = CellCoordinate(box.max_.x_);
+    int z0 = CellCoordinate(box.min_.z_), z1 = CellCoordinate(box.max_.z_);
+    for (int x = x0; x <= x1; ++x)
+    {
+        for (int z = z0; z <= z1; ++z)
+        {
+            DynamicEntry key;
+            key.cell_ = CellKey(x, z);
+            auto first = std::lower_bound(dynamicCells_.Begin(), dynamicCells_.End(), key,
+                                          [](const DynamicEntry& a, const DynamicEntry& b) { return a.cell_ < b.cell_; });
+            for (auto it = first; it != dynamicCells_.End() && it->cell_ == key.cell_; ++it)
+                result.Push(it->index_);
+        }
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Math/BoundingBox.h>
+#include <Urho3D/Math/Vector3.h>
+
+using namespace Urho3D;
+
+/**
+* Uniform grid over the XZ plane, hashed so it has no fixed extent.
+*
+* The static layer holds world geometry as boxes and is edited rarely. The
+* dynamic layer holds points (missiles) and is rebuilt in one go every step
+* by sorting them by cell, so it never allocates once it has warmed up.
+*
+* Segment sweeps walk only the cells the segment passes through, so their
+* cost depends on segment length and local density rather than on the
+* total number of objects.
+*/
+class SpatialHash {
+public:
+    explicit SpatialHash(float cellSize = 8.0f);
+
+    /// Add a static box. Returns an id that stays valid until the box is removed.
+    unsigned InsertStatic(const BoundingBox& box);
+
+    void RemoveStatic(unsigned id);
+
+    void ClearStatic();
+
+    /// Replace the dynamic layer with a set of points given as separate coordinate arrays.
+    void SetDynamicPoints(const float* x, const float* z, unsigned count);
+
+    /// First static box hit by the segment. Returns false if nothing is hit, otherwise the
+    /// fraction along the segment and the id of the box.
+    bool SweepStatic(const Vector3& from, const Vector3& to, float& hitFraction, unsigned& hitId) const;
+
+    /// Indices of dynamic points in cells overlapping the box, as passed to SetDynamicPoints.
+    void QueryDynamic(const BoundingBox& box, PODVector<unsigned>& result) const;
+
+    const BoundingBox& GetStaticBox(unsigned id) const { return staticBoxes_[id]; }
+
+    unsigned GetNumStatic() const { return numStatic_; }
+
+    unsigned GetNumDynamic() const { return dynamicCells_.Size(); }
+
+    float GetCellSize() const { return cellSize_; }
+
+private:
+    struct DynamicEntry {
+        long long cell_;
+        unsigned index_;
+    };
+
+    long long CellKey(int x, int z) const { return (long long)(((unsigned long long)(unsigned)x << 32) | (unsigned)z); }
+
+    int CellCoordinate(float value) const { return FloorToInt(value * invCellSize_); }
+
+    float cellSize_;
+    float invCellSize_;
+
+    PODVector<BoundingBox> staticBoxes_;
+    PODVector<bool> staticUsed_;
+    PODVector<unsigned> freeStatic_;
+    unsigned numStatic_;
+    HashMap<long long, PODVector<unsigned> > staticCells_;
+
+    /// Dynamic points sorted by cell key.
+    PODVector<DynamicEntry> dynamicCells_;
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+/**
+* Bounded lock-free queue for exactly one producer thread and one consumer
+* thread. Capacity must be a power of two. Head and tail live on separate
+* cache lines so the two threads do not false-share.
+*/
+template <class T, size_t Capacity>
+class SpscQueue {
+
+    static_assert(Capacity && (Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+public:
+    SpscQueue() : buffer_(new T[Capacity]) {}
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator =(const SpscQueue&) = delete;
+
+    /// Producer side. Returns false if the queue is full.
+    bool TryPush(const T& value) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == Capacity)
+            return false;
+        buffer_[tail & (Capacity - 1)] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Consumer side. Returns false if the queue is empty.
+    bool TryPop(T& value) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire))
+            return false;
+        value = buffer_[head & (Capacity - 1)];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Approximate when called from a thread that is neither producer nor consumer.
+    size_t Size() const { return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire); }
+
+    static constexpr size_t GetCapacity() { return Capacity; }
+
+private:
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+    std::unique_ptr<T[]> buffer_;
+};
@@ -0,0 +1,99 @@
+#include "TimerWheel.hpp"
+
+#include <Urho3D/Math/MathDefs.h>
+
+#include <cmath>
+
+TimerWheel::TimerWheel(float tickSeconds)
+                :tickSeconds_(tickSeconds),
+                elapsed_(0.0),
+                currentTick_(0),
+                numTimers_(0)
+                {
+    for (unsigned& head : slots_)
+        head = NONE;
+}
+
+TimerWheel::TimerHandle TimerWheel::Schedule(float delay, unsigned payload) {
+    unsigned index;
+    if (!free_.Empty())
+    {
+        index = free_.Back();
+        free_.Pop();
+    }
+    else
+    {
+        index = timers_.Size();
+        timers_.Resize(index + 1);
+        timers_[index].generation_ = 0;
+    }
+
+    Timer& timer = timers_[index];
+    // Generations start at one so no live handle is ever INVALID_TIMER
+    ++timer.generation_;
+    timer.payload_ = payload;
+    timer.active_ = true;
+    auto ticks = (unsigned long long)std::ceil(Max(delay, 0.0f) / tickSeconds_);
+    timer.expiry_ = currentTick_ + Max(ticks, 1ull);
+    Insert(index);
+    ++numTimers_;
+    return ((TimerHandle)timer.generation_ << 32) | index;
+}
+
+bool TimerWheel::Cancel(TimerHandle handle) {
+    auto index = (unsigned)(handle & 0xffffffff);
+    auto generation = (unsigned)(handle >> 32);
+    if (index >= timers_.Size() || !timers_[index].active_ || timers_[index].generation_ != generation)
+        return false;
+
+    Unlink(index);
+    Release(index);
+    return true;
+}
+
+void TimerWheel::Insert(unsigned index) {
+    Timer& timer = timers_[index];
+    const unsigned long long maxDelta = (1ull << (LEVEL_BITS * NUM_LEVELS)) - 1;
+    if (timer.expiry_ - currentTick_ > maxDelta)
+        timer.expiry_ = currentTick_ + maxDelta;
+
+    unsigned long long delta = timer.expiry_ - currentTick_;
+    unsigned level = 0;
+    while (level + 1 < NUM_LEVELS && delta >= (1ull << (LEVEL_BITS * (level + 1))))
+        ++level;
+
+    timer.slot_ = level * NUM_SLOTS + (unsigned)((timer.expiry_ >> (LEVEL_BITS * level)) & (NUM_SLOTS - 1));
+    timer.prev_ = NONE;
+    timer.next_ = slots_[timer.slot_];
+    if (timer.next_ != NONE)
+        timers_[timer.next_].prev_ = index;
+    slots_[timer.slot_] = index;
+}
+
+void TimerWheel::Unlink(unsigned index) {
+    Timer& timer = timers_[index];
+    if (timer.prev_ != NONE)
+        timers_[timer.prev_].next_ = timer.next_;
+    else
+        slots_[timer.slot_] = timer.next_;
+    if (timer.next_ != NONE)
+        timers_[timer.next_].prev_ = timer.prev_;
+}
+
+void TimerWheel::Release(unsigned index) {
+    timers_[index].active_ = false;
+    free_.Push(index);
+    --numTimers_;
+}
+
+void TimerWheel::Cascade(unsigned level) {
+    unsigned slot = level * NUM_SLOTS + (unsigned)((currentTick_ >> (LEVEL_BITS * level)) & (NUM_SLOTS - 1));
+    unsigned index = slots_[slot];
+    slots_[slot] = NONE;
+    while (index != NONE)
+    {
+        unsigned next = timers_[index].next_;
+        Insert(index);
+        index = next;
+    }
+}
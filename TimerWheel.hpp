@@ -0,0 +1,109 @@
+#pragma once
+
+#include <Urho3D/Container/Vector.h>
+
+using namespace Urho3D;
+
+/**
+* Hierarchical timer wheel: four levels of 64 slots, each level 64 times
+* coarser than the one below. Scheduling and cancelling are O(1), and
+* advancing costs one slot per elapsed tick plus the timers that are
+* actually due, however many timers are pending. Timers on the upper levels
+* are cascaded down once as their slot comes round.
+*/
+class TimerWheel {
+public:
+    typedef unsigned long long TimerHandle;
+
+    static const TimerHandle INVALID_TIMER = 0;
+
+    explicit TimerWheel(float tickSeconds = 0.01f);
+
+    /// Fire payload after delay seconds, rounded up to the next tick.
+    TimerHandle Schedule(float delay, unsigned payload);
+
+    /// Returns false if the timer already fired or was cancelled.
+    bool Cancel(TimerHandle handle);
+
+    /// Move time forward and call onExpired(payload) for every timer that came due, tick by tick.
+    template <class F> void Advance(float timeStep, F&& onExpired);
+
+    unsigned GetNumTimers() const { return numTimers_; }
+
+    float GetTickSeconds() const { return tickSeconds_; }
+
+private:
+    static const unsigned LEVEL_BITS = 6;
+    static const unsigned NUM_SLOTS = 1u << LEVEL_BITS;
+    static const unsigned NUM_LEVELS = 4;
+    static const unsigned NONE = 0xffffffff;
+
+    struct Timer {
+        unsigned long long expiry_;
+        unsigned payload_;
+        unsigned generation_;
+        unsigned next_;
+        unsigned prev_;
+        unsigned slot_;
+        bool active_;
+    };
+
+    void Insert(unsigned index);
+
+    void Unlink(unsigned index);
+
+    void Release(unsigned index);
+
+    /// Re-insert every timer of an upper level slot, which moves them a level or more down.
+    void Cascade(unsigned level);
+
+    float tickSeconds_;
+    double elapsed_;
+    unsigned long long currentTick_;
+
+    PODVector<Timer> timers_;
+    PODVector<unsigned> free_;
+    /// Head timer of each slot, level major.
+    unsigned slots_[NUM_LEVELS * NUM_SLOTS];
+    unsigned numTimers_;
+};
+
+template <class F> void TimerWheel::Advance(float timeStep, F&& onExpired) {
+    elapsed_ += timeStep;
+    auto targetTick = (unsigned long long)(elapsed_ / tickSeconds_);
+
+    // Nothing pending, nothing to walk
+    if (!numTimers_)
+    {
+        currentTick_ = targetTick;
+        return;
+    }
+
+    while (currentTick_ < targetTick)
+    {
+        ++currentTick_;
+        for (unsigned level = 1; level < NUM_LEVELS; ++level)
+        {
+            // A lower level just wrapped, bring the next slot of this level down
+            if ((currentTick_ & ((1ull << (LEVEL_BITS * level)) - 1)) != 0)
+                break;
+            Cascade(level);
+        }
+
+        unsigned slot = (unsigned)(currentTick_ & (NUM_SLOTS - 1));
+        while (slots_[slot] != NONE)
+        {
+            unsigned index = slots_[slot];
+            unsigned payload = timers_[index].payload_;
+            Unlink(index);
+            Release(index);
+            onExpired(payload);
+        }
+
+        if (!numTimers_)
+        {
+            currentTick_ = targetTick;
+            break;
+        }
+    }
+}
@@ -0,0 +1,136 @@
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct TraceBuffer {
+    TraceEvent events_[Trace::BUFFER_SIZE];
+    /// Events ever written, the newest is at (written_ - 1) % BUFFER_SIZE.
+    std::atomic<unsigned> written_{0};
+    unsigned threadIndex_ = 0;
+    const char* threadName_ = nullptr;
+};
+
+// Buffers belong to the registry rather than their thread, so a thread that ended still shows up in the trace
+std::mutex registryMutex;
+std::vector<std::unique_ptr<TraceBuffer> > buffers;
+std::set<std::string> internedNames;
+
+thread_local TraceBuffer* localBuffer = nullptr;
+
+TraceBuffer* GetLocalBuffer() {
+    if (!localBuffer)
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        buffers.emplace_back(new TraceBuffer());
+        localBuffer = buffers.back().get();
+        localBuffer->threadIndex_ = buffers.size() - 1;
+    }
+    return localBuffer;
+}
+
+void WriteEscaped(std::ofstream& file, const char* text) {
+    for (; *text; ++text)
+    {
+        if (*text == '"' || *text == '\\')
+            file << '\\';
+        file << *text;
+    }
+}
+
+}
+
+std::atomic<bool> Trace::enabled_{false};
+
+void Trace::SetEnabled(bool enable) {
+    enabled_.store(enable, std::memory_order_relaxed);
+}
+
+long long Trace::Now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Trace::Record(const char* name, long long startNs, long long endNs) {
+    TraceBuffer* buffer = GetLocalBuffer();
+    unsigned index = buffer->written_.load(std::memory_order_relaxed);
+    TraceEvent& event = buffer->events_[index & (BUFFER_SIZE - 1)];
+    event.name_ = name;
+    event.startNs_ = startNs;
+    event.durationNs_ = endNs - startNs;
+    buffer->written_.store(index + 1, std::memory_order_release);
+}
+
+void Trace::SetThreadName(const char* name) {
+    GetLocalBuffer()->threadName_ = name;
+}
+
+const char* Trace::Intern(const String& name) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    return internedNames.insert(std::string(name.CString(), name.Length())).first->c_str();
+}
+
+bool Trace::WriteChromeTrace(const String& fileName) {
+    std::ofstream file(fileName.CString());
+    if (!file)
+        return false;
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+
+    // Timestamps relative to the oldest event kept, Chrome's viewer starts at zero anyway
+    long long origin = 0;
+    bool first = true;
+    for (const std::unique_ptr<TraceBuffer>& buffer : buffers)
+    {
+        unsigned written = buffer->written_.load(std::memory_order_acquire);
+        unsigned oldest = written > BUFFER_SIZE ? written - BUFFER_SIZE : 0;
+        if (written > oldest)
+        {
+            long long start = buffer->events_[oldest & (BUFFER_SIZE - 1)].startNs_;
+            origin = first ? start : std::min(origin, start);
+            first = false;
+        }
+    }
+
+    char line[128];
+    first = true;
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for (const std::unique_ptr<TraceBuffer>& buffer : buffers)
+    {
+        file << (first ? "\n" : ",\n");
+        first = false;
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadIndex_ << ",\"args\":{\"name\":\"";
+        if (buffer->threadName_)
+            WriteEscaped(file, buffer->threadName_);
+        else
+            file << "Thread " << buffer->threadIndex_;
+        file << "\"}}";
+
+        unsigned written = buffer->written_.load(std::memory_order_acquire);
+        for (unsigned i = written > BUFFER_SIZE ? written - BUFFER_SIZE : 0; i < written; ++i)
+        {
+            const TraceEvent& event = buffer->events_[i & (BUFFER_SIZE - 1)];
+            file << ",\n{\"name\":\"";
+            WriteEscaped(file, event.name_);
+            snprintf(line, sizeof(line), "\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", buffer->threadIndex_,
+                     (event.startNs_ - origin) / 1000.0, event.durationNs_ / 1000.0);
+            file << line;
+        }
+    }
+    file << "\n]}\n";
+    return file.good();
+}
+
+void Trace::Clear() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (const std::unique_ptr<TraceBuffer>& buffer : buffers)
+        buffer->written_.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+
+#include <Urho3D/Container/Str.h>
+
+using namespace Urho3D;
+
+/// One timed section on one thread. The name is not copied, it must outlive the trace.
+struct TraceEvent {
+    const char* name_;
+    long long startNs_;
+    long long durationNs_;
+};
+
+/**
+* Hot path profiler. Timed sections are written to a ring buffer per thread,
+* so recording takes no lock and never allocates after a thread's first
+* event, and the last BUFFER_SIZE sections of every thread are kept. While
+* disabled a TraceScope costs one relaxed load and a branch.
+*
+* The buffers are written out as Chrome trace-event JSON, which
+* chrome://tracing and ui.perfetto.dev open. Write while no other thread is
+* recording, e.g. between frames, or the newest events of a busy thread may
+* come out torn.
+*/
+class Trace {
+public:
+    static void SetEnabled(bool enable);
+
+    static bool IsEnabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    /// Nanoseconds on a monotonic clock.
+    static long long Now();
+
+    /// Record a section that ran from startNs to endNs on the calling thread.
+    static void Record(const char* name, long long startNs, long long endNs);
+
+    /// Name the calling thread in the trace. Unnamed threads show up by number.
+    static void SetThreadName(const char* name);
+
+    /// A copy of name that lives as long as the process, for names built at runtime such as resource paths.
+    static const char* Intern(const String& name);
+
+    static bool WriteChromeTrace(const String& fileName);
+
+    /// Drop the recorded sections of every thread.
+    static void Clear();
+
+    /// Sections kept per thread, a power of two.
+    static const unsigned BUFFER_SIZE = 1 << 16;
+
+private:
+    static std::atomic<bool> enabled_;
+};
+
+/**
+* Times the enclosing scope when tracing is enabled. Next ends the current
+* section and starts another, for a function timed section by section.
+*/
+class TraceScope {
+public:
+    explicit TraceScope(const char* name)
+                :name_(Trace::IsEnabled() ? name : nullptr),
+                startNs_(name_ ? Trace::Now() : 0)
+                {
+    }
+
+    ~TraceScope() {
+        if (name_)
+            Trace::Record(name_, startNs_, Trace::Now());
+    }
+
+    void Next(const char* name) {
+        const char* next = Trace::IsEnabled() ? name : nullptr;
+        long long now = name_ || next ? Trace::Now() : 0;
+        if (name_)
+            Trace::Record(name_, startNs_, now);
+        name_ = next;
+        startNs_ = now;
+    }
+
+    TraceScope(const TraceScope&) = delete;
+
+    TraceScope& operator =(const TraceScope&) = delete;
+
+private:
+    const char* name_;
+    long long startNs_;
+};
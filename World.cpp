@@ -5,7 +5,19 @@
 #include "World.hpp"
 #include <iostream>
 
+#include <Urho3D/Core/StringUtils.h>
+#include <Urho3D/IO/FileSystem.h>
 
+namespace {
+
+/// Register the T of parent's child called name, a null handle if there is none.
+template <class T> Handle<T> RegisterChild(EntityRegistry& registry, Node* parent, const char* name) {
+    Node* node = parent->GetChild(name);
+    T* component = node ? node->GetComponent<T>() : nullptr;
+    return component ? registry.Add(component) : Handle<T>();
+}
+
+}
 
 World::World(Context *context)
                 :Object(context),
@@ -13,6 +25,8 @@ World::World(Context *context)
                 framecount_(0),
                 time_(0)
                 {
+    headless_ = context_->GetSubsystem<Engine>()->IsHeadless();
+
     // Init cache and UI
     cache_ = context_->GetSubsystem<ResourceCache>();
     uiRoot_ = context_->GetSubsystem<UI>()->GetRoot();
@@ -26,8 +40,156 @@ World::World(Context *context)
     overlayScene_ = new Scene(context_);
 }
 
-void World::start() {
+World::~World() {
+    // The UI root outlives the world, take off what was added to it
+    for (UIElement* element : uiElements_)
+        element->Remove();
 
+    if (recorder_ && ready_)
+    {
+        recorder_->Close(GetStateHash());
+        URHO3D_LOGINFOF("Recorded %u frames of input to %s", recorder_->GetNumFrames(), options_.record_.CString());
+    }
+
+    if (!options_.trace_.Empty())
+    {
+        // The job workers are asleep between frames, so every buffer is safe to read
+        Trace::SetEnabled(false);
+        if (Trace::WriteChromeTrace(options_.trace_))
+            URHO3D_LOGINFOF("Trace written to %s", options_.trace_.CString());
+        else
+            URHO3D_LOGERRORF("Could not write trace to %s", options_.trace_.CString());
+    }
+}
+
+WorldOptions WorldOptions::Parse(const Vector<String>& arguments) {
+    WorldOptions options;
+    for (unsigned i = 0; i < arguments.Size(); ++i)
+    {
+        String argument = arguments[i].ToLower();
+        bool hasValue = i + 1 < arguments.Size() && !arguments[i + 1].StartsWith("-");
+
+        if (argument == "-syncload")
+            options.preload_ = false;
+        else if (argument == "-preview" && hasValue)
+        {
+            String mode = arguments[++i].ToLower();
+            if (mode == "always")
+                options.previewMode_ = PREVIEW_ALWAYS;
+            else if (mode == "onchange")
+                options.previewMode_ = PREVIEW_ON_CHANGE;
+            else if (mode == "spritesheet")
+                options.previewMode_ = PREVIEW_SPRITESHEET;
+            else
+                options.previewMode_ = PREVIEW_CAPPED;
+        }
+        else if (argument == "-previewrate" && hasValue)
+            options.previewRate_ = ToFloat(arguments[++i]);
+        else if (argument == "-cook" && hasValue)
+            options.cookScene_ = arguments[++i];
+        else if (argument == "-cooked" && hasValue)
+            options.cookedScene_ = arguments[++i];
+        else if (argument == "-stream")
+            options.stream_ = true;
+        else if (argument == "-streambudget" && hasValue)
+            options.streamBudgetUs_ = ToUInt(arguments[++i]);
+        else if (argument == "-tickrate" && hasValue)
+            options.tickRate_ = ToFloat(arguments[++i]);
+        else if (argument == "-maxsteps" && hasValue)
+            options.maxCatchUpSteps_ = ToUInt(arguments[++i]);
+        else if (argument == "-threads" && hasValue)
+            options.threads_ = ToUInt(arguments[++i]);
+        else if (argument == "-nolod")
+            options.populationLod_ = false;
+        else if (argument == "-occluders" && hasValue)
+            options.adaptiveOccluders_ = arguments[++i].ToLower() != "fixed";
+        else if (argument == "-occluderbudget" && hasValue)
+            options.occluderBudget_ = ToUInt(arguments[++i]);
+        else if (argument == "-adaptive")
+            options.adaptiveQuality_ = true;
+        else if (argument == "-targetms" && hasValue)
+            options.targetFrameMs_ = ToFloat(arguments[++i]);
+        else if (argument == "-explosionparticles" && hasValue)
+            options.explosionParticles_ = ToUInt(arguments[++i]);
+        else if (argument == "-trailparticles" && hasValue)
+            options.trailParticles_ = ToUInt(arguments[++i]);
+        else if (argument == "-seed" && hasValue)
+            options.seed_ = ToUInt(arguments[++i]);
+        else if (argument == "-record" && hasValue)
+            options.record_ = arguments[++i];
+        else if (argument == "-replay" && hasValue)
+            options.replay_ = arguments[++i];
+        else if (argument == "-trace" && hasValue)
+            options.trace_ = arguments[++i];
+        else if (argument == "-worldconfig" && hasValue)
+            options.worldConfig_ = arguments[++i];
+    }
+    return options;
+}
+
+void World::start(const WorldOptions& options) {
+    startupTimer_.Reset();
+    options_ = options;
+
+    if (!options_.trace_.Empty())
+    {
+        Trace::SetThreadName("Main");
+        Trace::SetEnabled(true);
+    }
+
+    if (!options_.replay_.Empty())
+    {
+        replay_ = std::make_unique<InputReplay>();
+        if (replay_->Load(context_, options_.replay_))
+            URHO3D_LOGINFOF("Replaying %u frames from %s", replay_->GetNumFrames(), options_.replay_.CString());
+        else
+        {
+            URHO3D_LOGERRORF("Could not load input log %s, running on live input", options_.replay_.CString());
+            replay_.reset();
+        }
+    }
+    else if (!options_.record_.Empty())
+    {
+        recorder_ = std::make_unique<InputRecorder>(context_);
+        if (!recorder_->Open(options_.record_, options_.seed_))
+        {
+            URHO3D_LOGERRORF("Could not open input log %s for writing", options_.record_.CString());
+            recorder_.reset();
+        }
+    }
+
+    // A config that cannot be read leaves the built in world, it is read again once the file changes
+    if (!options_.worldConfig_.Empty())
+    {
+        if (config_.Load(context_, options_.worldConfig_))
+            URHO3D_LOGINFOF("World config read from %s", options_.worldConfig_.CString());
+        WatchConfig();
+    }
+
+    if (!options_.preload_)
+    {
+        BuildScene();
+        return;
+    }
+
+    // Pull everything the scene needs in on the worker threads, the scene is built once it is all resident
+    preloader_ = new ResourcePreloader(context_);
+    preloader_->Add<Font>("Fonts/Anonymous Pro.ttf");
+    preloader_->Add<Model>("Models/Box.mdl");
+    preloader_->Add<Model>("Models/Plane.mdl");
+    preloader_->Add<Model>("Models/Mushroom.mdl");
+    preloader_->Add<Material>("Materials/Stone.xml");
+    preloader_->Add<Material>("Materials/StoneTiled.xml");
+    preloader_->Add<Material>("Materials/Mushroom.xml");
+    preloader_->Add<ParticleEffect>("Particle/Fire.xml");
+
+    SubscribeToEvent(preloader_, E_PRELOADPROGRESS, URHO3D_HANDLER(World, HandlePreloadProgress));
+    SubscribeToEvent(preloader_, E_PRELOADFINISHED, URHO3D_HANDLER(World, HandlePreloadFinished));
+    preloader_->Start();
+}
+
+void World::BuildScene() {
+    TraceScope trace("World::BuildScene");
 
     // Let's use the default style that comes with Urho3D.
     auto* style = cache_->GetResource<XMLFile>("UI/DefaultStyle.xml");
@@ -39,13 +201,81 @@ void World::start() {
     // Add a button, just as an interactive UI sample.
     CreateButton();
 
+    // Alert windows are created once here and reused for every alert
+    alertBoard_ = new AlertBoard(context_, uiRoot_, cache_->GetResource<Font>("Fonts/Anonymous Pro.ttf"));
+
     // Setup Controllers
-    missileController_ = std::make_unique<MissileController>(scene_);
+    missiles_ = std::make_unique<MissileSimulation>(scene_);
+    unsigned numWorkers = options_.threads_ ? options_.threads_ - 1 : JobSystem::GetDefaultNumWorkers();
+    jobSystem_ = std::make_unique<JobSystem>(numWorkers);
     alertController_ = std::make_unique<AlertController>(context_);
 
     // Create an alert maker
     alertMaker_ = std::make_unique<AlertMaker>(context_,*alertController_);
 
+    // Same seed, same mushrooms, boxes and particles, which a replay relies on
+    if (replay_)
+        options_.seed_ = replay_->GetSeed();
+    SetRandomSeed(options_.seed_);
+
+    // Build the scenes node by node, or instantiate them in bulk from a cooked file
+    HiresTimer sceneTimer;
+    if (options_.cookedScene_.Empty() || !LoadCookedScene(options_.cookedScene_))
+        CreateSceneContent();
+    sceneBuildMs_ = sceneTimer.GetUSec(false) / 1000.0f;
+
+    if (options_.stream_)
+        CreateStreamer();
+    else
+    {
+        // Index the plane and boxes so missiles can hit them
+        BuildCollisionGrid();
+
+        if (options_.populationLod_)
+            SetupPopulationLod();
+        SetupOccluders();
+    }
+
+    // Fire and missile explosions are simulated on the job system
+    SetupParticles();
+
+    // Create missile preview
+    CreateMissilePreview(cache_);
+
+    // Now we setup the viewport. Of course, you can have more than one!
+    SetupViewport();
+
+    // The governor reacts to wall time, which would make a replay end up somewhere else than its recording
+    if (options_.adaptiveQuality_ && (replay_ || recorder_))
+        URHO3D_LOGWARNING("Adaptive quality is off while recording or replaying input");
+    else if (options_.adaptiveQuality_)
+        CreateQualityGovernor();
+
+    fixedStep_.SetTickRate(options_.tickRate_);
+    fixedStep_.SetMaxSteps(options_.maxCatchUpSteps_);
+    ResetInterpolation();
+
+    if (replay_ || recorder_)
+    {
+        // The frame the scene was built on ran on a timestep nobody recorded, start updating the scene with the first input frame
+        scene_->SetUpdateEnabled(false);
+    }
+    // Replayed frames run as fast as they can, on the recorded timesteps
+    if (replay_)
+        GetSubsystem<Engine>()->SetMaxFps(0);
+
+    SubscribeToEvents();
+
+    ready_ = true;
+    startupMs_ = startupTimer_.GetUSec(false) / 1000.0f;
+    URHO3D_LOGINFOF("World built %.2f ms after start", startupMs_);
+
+    if (!options_.cookScene_.Empty())
+        CookScene(options_.cookScene_);
+}
+
+void World::CreateSceneContent() {
+
     // Let the scene have an Octree component!
     scene_->CreateComponent<Octree>();
     overlayScene_->CreateComponent<Octree>();
@@ -56,17 +286,30 @@ void World::start() {
     // Let's add an additional scene component for fun.
     scene_->CreateComponent<DebugRenderer>();
 
-    // Create plane node & StaticModel component for showing a static plane
-    CreatePlane(cache_);
-
     // Zone component for ambient lighting and fog control
     CreateAmbientLigthing();
 
-    // Create some mushrooms
-    CreateMushrooms(cache_);
+    if (options_.stream_)
+    {
+        // Ground, mushrooms and boxes come in chunks around the camera, see CreateStreamer
+        SetupMushroomMaterial(cache_);
+    }
+    else
+    {
+        // Create plane node & StaticModel component for showing a static plane
+        CreatePlane(cache_);
+
+        // Boxes and mushrooms are scattered together, so neither grows into the other
+        PoissonScatter scatter;
+        ScatterField(scatter, config_, options_.seed_, jobSystem_.get());
+        fieldBoxes_ = scatter.GetPlacements(FIELD_BOXES);
+
+        // Create some mushrooms
+        CreateMushrooms(cache_, scatter.GetPlacements(FIELD_MUSHROOMS));
 
-    // Create randomly sized boxes. If boxes are big enough, make them occluders
-    CreateBoxes(cache_);
+        // Create randomly sized boxes. If boxes are big enough, make them occluders
+        CreateBoxes(cache_, scatter.GetPlacements(FIELD_BOXES));
+    }
 
     // Create a directional light to the world. Enable cascaded shadows on it
     CreateDirectionLight();
@@ -81,40 +324,138 @@ void World::start() {
     // Create overlay camera to render missile preview from.
     CreateOverlayCamera();
 
-    // Create missile preview
-    CreateMissilePreview(cache_);
-
-
-
     // add a green spot light to the camera node
     CreateSpotLight();
+}
 
-    // Now we setup the viewport. Of course, you can have more than one!
-    SetupViewport();
-
-    SubscribeToEvents();
+bool World::LoadCookedScene(const String& fileName) {
+    CookedScene cooked;
+    if (!cooked.Open(fileName) || cooked.GetNumScenes() != 2 ||
+        !cooked.Instantiate(0, scene_) || !cooked.Instantiate(1, overlayScene_))
+    {
+        URHO3D_LOGERRORF("Could not load cooked scene %s, building it instead", fileName.CString());
+        scene_->Clear();
+        overlayScene_->Clear();
+        return false;
+    }
 
+    // Shader parameter animation lives on the material resource, not in the scene
+    SetupMushroomMaterial(cache_);
 
+    cameraNode_ = scene_->GetChild("Camera");
+    overlayCameraNode_ = overlayScene_->GetChild("Camera");
+    if (!cameraNode_ || !overlayCameraNode_)
+    {
+        URHO3D_LOGERRORF("Cooked scene %s has no cameras, building it instead", fileName.CString());
+        scene_->Clear();
+        overlayScene_->Clear();
+        return false;
+    }
+    camera_ = cameraNode_->GetComponent<Camera>();
+    overlayCamera_ = overlayCameraNode_->GetComponent<Camera>();
+    RegisterEntities();
+    URHO3D_LOGINFOF("Loaded cooked scene %s (%u bytes)", fileName.CString(), cooked.GetSize());
+    return true;
+}
 
+void World::RegisterEntities() {
+    registry_.Clear();
+    entities_ = WorldEntities();
+    entities_.zone_ = RegisterChild<Zone>(registry_, scene_, "Zone");
+    entities_.sun_ = RegisterChild<Light>(registry_, scene_, "DirectionalLight");
+    entities_.spotLight_ = RegisterChild<Light>(registry_, cameraNode_, "SpotLight");
+    entities_.plane_ = RegisterChild<StaticModel>(registry_, scene_, "Plane");
+    entities_.fire_ = RegisterChild<SoaParticleEmitter>(registry_, scene_, "Particle");
+    entities_.mushrooms_ = RegisterChild<InstancedPopulation>(registry_, scene_, "Mushrooms");
+    entities_.boxes_[0] = RegisterChild<InstancedPopulation>(registry_, scene_, "Boxes");
+    entities_.boxes_[1] = RegisterChild<InstancedPopulation>(registry_, scene_, "OccluderBoxes");
+}
 
+bool World::CookScene(const String& fileName) {
+    PODVector<Scene*> scenes;
+    scenes.Push(scene_);
+    scenes.Push(overlayScene_);
+    if (!CookedScene::Cook(scenes, fileName))
+    {
+        URHO3D_LOGERRORF("Could not write cooked scene %s", fileName.CString());
+        return false;
+    }
+    URHO3D_LOGINFOF("Cooked scene written to %s", fileName.CString());
+    return true;
 }
 
 
 
 ///////////////// Setup stuff ///////////////////////
 void World::CreateAlert(const std::string & text, const float lifeTime) {
-    alertController_->CreateAlert(text, lifeTime);
+    AllocationScope allocations(ALLOC_ALERTS);
+    // Copied into a String that keeps its capacity rather than a new one per alert
+    alertText_.Clear();
+    alertText_.Append(text.c_str(), (unsigned)text.size());
+    alertBoard_->Show(alertText_, lifeTime);
+}
+
+unsigned World::GetStateHash() const {
+    // FNV-1a over the raw bytes, a replay must match bit for bit
+    unsigned hash = 2166136261u;
+    auto add = [&hash](const void* data, unsigned size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (unsigned i = 0; i < size; ++i)
+            hash = (hash ^ bytes[i]) * 16777619u;
+    };
+
+    Vector3 cameraPosition = cameraNode_->GetPosition();
+    Quaternion cameraRotation = cameraNode_->GetRotation();
+    add(&cameraPosition, sizeof(cameraPosition));
+    add(&cameraRotation, sizeof(cameraRotation));
+    const MissilePool& missilePool = missiles_->GetPool();
+    unsigned numMissiles = missilePool.GetNumMissiles();
+    add(&numMissiles, sizeof(numMissiles));
+    for (unsigned i = 0; i < numMissiles; ++i)
+    {
+        Vector3 position = missilePool.GetPosition(i);
+        add(&position, sizeof(position));
+    }
+    unsigned numAlerts = alertBoard_->GetNumShown();
+    add(&numAlerts, sizeof(numAlerts));
+    unsigned long long tick = fixedStep_.GetTick();
+    add(&tick, sizeof(tick));
+    unsigned seed = GetRandomSeed();
+    add(&seed, sizeof(seed));
+    return hash;
+}
+
+void World::FireMissile() {
+    AllocationScope allocations(ALLOC_MISSILES);
+    missiles_->GetPool().CreateMissile(cameraNode_->GetPosition() ,cameraNode_->GetDirection());
 }
 
 void World::CreateMissilePreview(ResourceCache* cache){
 
-    auto* missilePreviewNode = overlayScene_->CreateChild("missilePreview");
+    // A cooked overlay scene already has the preview node
+    auto* missilePreviewNode = overlayScene_->GetChild("missilePreview");
+    if (!missilePreviewNode)
+    {
+        missilePreviewNode = overlayScene_->CreateChild("missilePreview");
 
-    auto* missilePreview = missilePreviewNode->CreateComponent<StaticModel>();
-    missilePreview->SetModel(cache->GetResource<Model>("Models/Box.mdl"));
-    missilePreview->SetMaterial(cache->GetResource<Material>("Materials/Stone.xml"));
-    missilePreviewNode->SetPosition(Vector3(0,0,2.5));
+        auto* missilePreview = missilePreviewNode->CreateComponent<StaticModel>();
+        missilePreview->SetModel(cache->GetResource<Model>("Models/Box.mdl"));
+        missilePreview->SetMaterial(cache->GetResource<Material>("Materials/Stone.xml"));
+        missilePreviewNode->SetPosition(Vector3(0,0,2.5));
+    }
+    // Rotated every frame, so it is never looked up by name again
+    entities_.missilePreview_ = registry_.Add(missilePreviewNode);
 
+    // Without a renderer there is nothing to render the preview into, the scheduler only counts
+    if (headless_)
+    {
+        previewScheduler_ = new PreviewRenderScheduler(context_, nullptr);
+        previewScheduler_->SetMode(options_.previewMode_);
+        previewScheduler_->SetMaxRate(options_.previewRate_);
+        if (options_.previewMode_ == PREVIEW_SPRITESHEET)
+            previewScheduler_->BakeSpriteSheet(overlayScene_, missilePreviewNode, overlayCamera_, nullptr, Quaternion(8, 16, 0));
+        return;
+    }
 
 
     auto* missileDisplay = new Button(context_);
@@ -124,6 +465,7 @@ void World::CreateMissilePreview(ResourceCache* cache){
     missileDisplay->SetBlendMode(BLEND_ALPHA);
 
     uiRoot_->AddChild(missileDisplay);
+    uiElements_.Push(SharedPtr<UIElement>(missileDisplay));
 
 
     // Create a renderable texture (1024x768, RGB format), enable bilinear filtering on it
@@ -138,8 +480,6 @@ void World::CreateMissilePreview(ResourceCache* cache){
 
     SharedPtr<Viewport> OverlayViewport(new Viewport(context_, overlayScene_, overlayCamera_));
     surface->SetViewport(0, OverlayViewport);
-    surface->SetUpdateMode(RenderSurfaceUpdateMode::SURFACE_UPDATEALWAYS);
-//    surface->QueueUpdate();
 
     auto rp = OverlayViewport->GetRenderPath()->Clone();
     for ( int i = 0; i < rp->GetNumCommands(); i++ )
@@ -153,6 +493,13 @@ void World::CreateMissilePreview(ResourceCache* cache){
     }
     OverlayViewport->SetRenderPath(rp);
 
+    // Only re-render the preview as often as the chosen mode allows, instead of every frame
+    previewScheduler_ = new PreviewRenderScheduler(context_, surface);
+    previewScheduler_->SetMode(options_.previewMode_);
+    previewScheduler_->SetMaxRate(options_.previewRate_);
+    if (options_.previewMode_ == PREVIEW_SPRITESHEET)
+        previewScheduler_->BakeSpriteSheet(overlayScene_, missilePreviewNode, overlayCamera_, missileDisplay, Quaternion(8, 16, 0));
+
 
 
 
@@ -166,10 +513,11 @@ void World::CreateMissilePreview(ResourceCache* cache){
 
 void World::CreatePlane(ResourceCache* cache){
     Node* planeNode = scene_->CreateChild("Plane");
-    planeNode->SetScale(Vector3(100.0f, 1.0f, 100.0f));
     auto* planeObject = planeNode->CreateComponent<StaticModel>();
     planeObject->SetModel(cache->GetResource<Model>("Models/Plane.mdl"));
     planeObject->SetMaterial(cache->GetResource<Material>("Materials/StoneTiled.xml"));
+    entities_.plane_ = registry_.Add(planeObject);
+    ConfigureGround();
 }
 
 void World::CreateText(ResourceCache* cache){
@@ -184,12 +532,14 @@ void World::CreateText(ResourceCache* cache){
     text_->SetHorizontalAlignment(HA_CENTER);
     text_->SetVerticalAlignment(VA_TOP);
     uiRoot_->AddChild(text_);
+    uiElements_.Push(SharedPtr<UIElement>(text_));
 }
 
 void World::CreateButton(){
     Button* button=new Button(context_);
     // Note, must be part of the UI system before SetSize calls!
     uiRoot_->AddChild(button);
+    uiElements_.Push(SharedPtr<UIElement>(button));
     button->SetName("Button Quit");
     button->SetStyle("Button");
     button->SetSize(32,32);
@@ -205,11 +555,11 @@ void World::CreateAmbientLigthing(){
 
     Node* zoneNode = scene_->CreateChild("Zone");
     auto* zone = zoneNode->CreateComponent<Zone>();
-    zone->SetBoundingBox(BoundingBox(-1000.0f, 1000.0f));
-    zone->SetAmbientColor(Color(0.15f, 0.15f, 0.15f));
-    zone->SetFogColor(Color(0.5f, 0.5f, 0.7f));
-    zone->SetFogStart(100.0f);
-    zone->SetFogEnd(300.0f);
+    // A streamed world has no edge, the zone has to cover wherever the camera can fly
+    float extent = options_.stream_ ? 100000.0f : 1000.0f;
+    zone->SetBoundingBox(BoundingBox(-extent, extent));
+    entities_.zone_ = registry_.Add(zone);
+    ConfigureZone();
 
 }
 
@@ -220,7 +570,7 @@ void World::SetWorldColour(Scene* scene){
     zone->SetAmbientColor(Color(1.0f, 1.0f, 1.0f,0.0f));
 }
 
-void World::CreateMushrooms(ResourceCache* cache){
+Material* World::SetupMushroomMaterial(ResourceCache* cache){
 
     auto* mushroomMat = cache->GetResource<Material>("Materials/Mushroom.xml");
     // Apply shader parameter animation to material
@@ -232,75 +582,236 @@ void World::CreateMushrooms(ResourceCache* cache){
     // Optionally associate material with scene to make sure shader parameter animation respects scene time scale
     mushroomMat->SetScene(scene_);
     mushroomMat->SetShaderParameterAnimation("MatSpecColor", specColorAnimation);
+    return mushroomMat;
+}
+
+void World::ScatterField(PoissonScatter& scatter, const WorldConfig& config, unsigned seed, JobSystem* jobSystem){
+    float extent = config.fieldSize_ * 0.5f;
+    scatter.SetArea(Rect(-extent, -extent, extent, extent));
+    scatter.SetSeed(seed);
+    scatter.AddCategory(config.boxes_);
+    scatter.AddCategory(config.mushrooms_);
+    scatter.Generate(jobSystem);
+}
+
+void World::CreateMushrooms(ResourceCache* cache, const PODVector<ScatterPlacement>& placements){
+
+    auto* mushroomMat = SetupMushroomMaterial(cache);
+
+
+
+
+
+    // All mushrooms share one node, their transforms are kept in the population component
+    Node* mushroomsNode = scene_->CreateChild("Mushrooms");
+    auto* mushrooms = mushroomsNode->CreateComponent<InstancedPopulation>();
+    mushrooms->SetModel(cache->GetResource<Model>("Models/Mushroom.mdl"));
+    mushrooms->SetMaterial(mushroomMat);
+    mushrooms->SetCastShadows(true);
+    entities_.mushrooms_ = registry_.Add(mushrooms);
+    PopulateMushrooms(placements);
+}
+
+void World::PopulateMushrooms(const PODVector<ScatterPlacement>& placements){
+    InstancedPopulation* mushrooms = registry_.Get(entities_.mushrooms_);
+    if (!mushrooms)
+        return;
+
+    // LOD bands draw the same instances, so they follow along
+    mushrooms->RemoveAllInstances();
+    mushrooms->Reserve(placements.Size());
+    for (const ScatterPlacement& placement : placements)
+        mushrooms->AddInstance(placement.position_, Quaternion(0.0f, placement.yaw_, 0.0f), Vector3::ONE * placement.scale_);
+}
+
+void World::CreateBoxes(ResourceCache* cache, const PODVector<ScatterPlacement>& placements){
+    // Occluder flag is per drawable, so big boxes and small boxes go into separate populations.
+    // Adaptive occluders choose from every box per frame, so they all go into the occluder population
+    const char* groupNames[2] = {"Boxes", "OccluderBoxes"};
+    for (unsigned i = 0; i < 2; ++i)
+    {
+        Node* boxesNode = scene_->CreateChild(groupNames[i]);
+        auto* boxes = boxesNode->CreateComponent<InstancedPopulation>();
+        boxes->SetModel(cache->GetResource<Model>("Models/Box.mdl"));
+        boxes->SetMaterial(cache->GetResource<Material>("Materials/Stone.xml"));
+        boxes->SetCastShadows(true);
+        boxes->SetOccluder(i == 1);
+        entities_.boxes_[i] = registry_.Add(boxes);
+    }
+    PopulateBoxes(placements);
+}
+
+void World::PopulateBoxes(const PODVector<ScatterPlacement>& placements){
+    InstancedPopulation* boxGroups[2];
+    for (unsigned i = 0; i < 2; ++i)
+    {
+        boxGroups[i] = registry_.Get(entities_.boxes_[i]);
+        if (!boxGroups[i])
+            return;
+        boxGroups[i]->RemoveAllInstances();
+    }
+
+    for (const ScatterPlacement& placement : placements)
+    {
+        BoundingBox bounds = GetFieldBoxBounds(placement);
+        bool occluder = options_.adaptiveOccluders_ || placement.scale_ >= 3.0f;
+        boxGroups[occluder ? 1 : 0]->AddInstance(bounds.Center(), Quaternion::IDENTITY, bounds.Size());
+    }
+}
+
+BoundingBox World::GetFieldBoxBounds(const ScatterPlacement& placement){
+    float halfSize = placement.scale_ * 0.5f;
+    Vector3 center(placement.position_.x_, halfSize, placement.position_.z_);
+    return BoundingBox(center - Vector3::ONE * halfSize, center + Vector3::ONE * halfSize);
+}
 
+BoundingBox World::GetGroundBounds(const WorldConfig& config){
+    // The plane model is a unit square at the origin, scaled by ConfigureGround
+    float halfSize = config.groundSize_ * 0.5f;
+    return BoundingBox(Vector3(-halfSize, 0.0f, -halfSize), Vector3(halfSize, 0.0f, halfSize));
+}
 
+void World::SetupPopulationLod(){
+    // Nothing is visible past the fog end, and little detail survives past the fog start
+    Zone* zone = registry_.Get(entities_.zone_);
+    if (!zone)
+        return;
+    float fogStart = zone->GetFogStart();
+    float fogEnd = zone->GetFogEnd();
+    float fullDetailEnd = fogStart * 0.5f;
 
+    if (InstancedPopulation* mushrooms = registry_.Get(entities_.mushrooms_))
+    {
+        mushrooms->SetLodRange(0.0f, fullDetailEnd);
 
+        if (mushrooms->GetNumLodBands() == 2 && mushrooms->GetLodBand(0) && mushrooms->GetLodBand(1))
+        {
+            mushrooms->GetLodBand(0)->SetLodRange(fullDetailEnd, fogStart);
+            mushrooms->GetLodBand(1)->SetLodRange(fogStart, fogEnd);
+        }
+        else
+        {
+            // Lowest LOD of the same model and no shadows, then flat impostors out to the fog end
+            InstancedPopulation* simplified = mushrooms->AddLodBand(mushrooms->GetModel(), mushrooms->GetMaterial(),
+                                                                    fullDetailEnd, fogStart, false);
+            simplified->SetLodBias(0.01f);
+            simplified->SetCastShadows(false);
+            InstancedPopulation* impostors = mushrooms->AddLodBand(cache_->GetResource<Model>("Models/Plane.mdl"),
+                                                                   mushrooms->GetMaterial(), fogStart, fogEnd, true);
+            impostors->SetCastShadows(false);
+        }
+    }
 
-    const unsigned NUM_MUSHROOMS = 240;
-    for (unsigned i = 0; i < NUM_MUSHROOMS; ++i)
+    for (Handle<InstancedPopulation> handle : entities_.boxes_)
     {
-        Node* mushroomNode = scene_->CreateChild("Mushroom");
-        mushroomNode->SetPosition(Vector3(Random(90.0f) - 45.0f, 0.0f, Random(90.0f) - 45.0f));
-        mushroomNode->SetRotation(Quaternion(0.0f, Random(360.0f), 0.0f));
-        mushroomNode->SetScale(0.5f + Random(2.0f));
-        auto* mushroomObject = mushroomNode->CreateComponent<StaticModel>();
-        mushroomObject->SetModel(cache->GetResource<Model>("Models/Mushroom.mdl"));
-        mushroomObject->SetMaterial(mushroomMat);
-        mushroomObject->SetCastShadows(true);
+        if (InstancedPopulation* boxes = registry_.Get(handle))
+            boxes->SetLodRange(0.0f, fogEnd);
     }
 }
 
-void World::CreateBoxes(ResourceCache* cache){
-    const unsigned NUM_BOXES = 20;
-    for (unsigned i = 0; i < NUM_BOXES; ++i)
+void World::SetupOccluders(){
+    if (!options_.adaptiveOccluders_)
+        return;
+
+    // A cooked scene may still have small boxes apart, let the selection consider them as well. The budget
+    // is for the whole scene, each population gets a share by its number of instances.
+    unsigned totalInstances = 0;
+    for (Handle<InstancedPopulation> handle : entities_.boxes_)
     {
-        Node* boxNode = scene_->CreateChild("Box");
-        float size = 1.0f + Random(10.0f);
-        boxNode->SetPosition(Vector3(Random(80.0f) - 40.0f, size * 0.5f, Random(80.0f) - 40.0f));
-        boxNode->SetScale(size);
+        if (InstancedPopulation* boxes = registry_.Get(handle))
+            totalInstances += boxes->GetNumInstances();
+    }
+    if (!totalInstances)
+        return;
 
-        auto* boxObject = boxNode->CreateComponent<StaticModel>();
-        boxObject->SetModel(cache->GetResource<Model>("Models/Box.mdl"));
-        boxObject->SetMaterial(cache->GetResource<Material>("Materials/Stone.xml"));
-        boxObject->SetCastShadows(true);
-        if (size >= 3.0f)
-            boxObject->SetOccluder(true);
+    unsigned budgetLeft = options_.occluderBudget_;
+    unsigned instancesLeft = totalInstances;
+    for (Handle<InstancedPopulation> handle : entities_.boxes_)
+    {
+        InstancedPopulation* boxes = registry_.Get(handle);
+        if (!boxes || !boxes->GetNumInstances())
+            continue;
+
+        // Shares are rounded down and the last population takes what is left, so they add up to the budget
+        unsigned share = (unsigned)((unsigned long long)budgetLeft * boxes->GetNumInstances() / instancesLeft);
+        budgetLeft -= share;
+        instancesLeft -= boxes->GetNumInstances();
+        boxes->SetOccluder(true);
+        boxes->SetOccluderBudget(share);
+    }
+}
+
+void World::BuildCollisionGrid(){
+    // From the populations rather than the placements, a cooked scene has no placements. One cooked
+    // from a streamed world has neither plane nor boxes, whatever it lacks is left out
+    PODVector<BoundingBox> boxBounds;
+    for (Handle<InstancedPopulation> handle : entities_.boxes_)
+    {
+        InstancedPopulation* boxes = registry_.Get(handle);
+        if (!boxes)
+            continue;
+        for (unsigned i = 0; i < boxes->GetNumInstances(); ++i)
+            boxBounds.Push(boxes->GetInstanceBoundingBox(i));
     }
+    BoundingBox ground;
+    if (StaticModel* plane = registry_.Get(entities_.plane_))
+        ground = plane->GetWorldBoundingBox();
+    missiles_->BuildCollisionGrid(ground, boxBounds);
 }
 
 void World::CreateDirectionLight(){
     Node* lightNode = scene_->CreateChild("DirectionalLight");
-    lightNode->SetDirection(Vector3(0.6f, -1.0f, 0.8f));
     auto* light = lightNode->CreateComponent<Light>();
     light->SetLightType(LIGHT_DIRECTIONAL);
     light->SetCastShadows(true);
-    light->SetShadowBias(BiasParameters(0.00025f, 0.5f));
-    // Set cascade splits at 10, 50 and 200 world units, fade shadows out at 80% of maximum shadow distance
-    light->SetShadowCascade(CascadeParameters(10.0f, 50.0f, 200.0f, 0.0f, 0.8f));
+    entities_.sun_ = registry_.Add(light);
+    ConfigureSun();
 }
 
 void World::CreateParticleEmmitter(ResourceCache* cache){
     assert(scene_);
     Node* particle_emmitter = scene_->CreateChild("Particle");
-    particle_emmitter->SetPosition(Vector3(0,10,10));
-    particle_emmitter->SetScale(Vector3(5,6,6));
     ParticleEffect* effect = cache->GetResource<ParticleEffect>("Particle/Fire.xml");
     assert(effect);
-    ParticleEmitter* emitter=particle_emmitter->CreateComponent<ParticleEmitter>();
+    SoaParticleEmitter* emitter=particle_emmitter->CreateComponent<SoaParticleEmitter>();
     assert(emitter);
     emitter->SetEffect(effect);
     emitter->SetEmitting(true);
-    emitter->SetNumParticles(100);
     particle_emmitter->SetAnimationEnabled(true);
     particle_emmitter->SetEnabled(true);
+    entities_.fire_ = registry_.Add(emitter);
+    ConfigureFire();
+
+}
 
+void World::SetupParticles(){
+    if (SoaParticleEmitter* fire = registry_.Get(entities_.fire_))
+        fire->SetJobSystem(jobSystem_.get());
+
+    // Temporary, the pool is sized at runtime and never saved or cooked
+    Node* explosionNode = scene_->CreateChild("Explosions", LOCAL);
+    explosionNode->SetTemporary(true);
+    explosions_ = explosionNode->CreateComponent<SoaParticleEmitter>();
+    explosions_->SetEffect(cache_->GetResource<ParticleEffect>("Particle/Fire.xml"));
+    explosions_->SetMaxParticles(options_.explosionParticles_);
+    explosions_->SetEmitting(false);
+    explosions_->SetJobSystem(jobSystem_.get());
+
+    if (!options_.trailParticles_)
+        return;
+    Node* trailNode = scene_->CreateChild("Trails", LOCAL);
+    trailNode->SetTemporary(true);
+    trails_ = trailNode->CreateComponent<SoaParticleEmitter>();
+    trails_->SetEffect(cache_->GetResource<ParticleEffect>("Particle/Fire.xml"));
+    trails_->SetMaxParticles(options_.trailParticles_);
+    trails_->SetEmitting(false);
+    trails_->SetJobSystem(jobSystem_.get());
 }
 
 void World::CreateCamera(){
     cameraNode_=scene_->CreateChild("Camera");
     camera_=cameraNode_->CreateComponent<Camera>();
-    camera_->SetFarClip(300.0f);
+    ConfigureCamera();
 
     // Set an initial position for the front camera scene node above the plane
     cameraNode_->SetPosition(Vector3(0.0f, 10.0f, 0.0f));
@@ -321,20 +832,199 @@ void World::CreateOverlayCamera(){
 
 void World::CreateSpotLight(){
     {
-        Node* node_light=cameraNode_->CreateChild();
+        Node* node_light=cameraNode_->CreateChild("SpotLight");
         Light* light=node_light->CreateComponent<Light>();
         node_light->Pitch(15);  // point slightly downwards
         light->SetLightType(LIGHT_SPOT);
-        light->SetRange(20);
-        light->SetColor(Color(.6,1,.6,1.0));
-        light->SetBrightness(2.8);
-        light->SetFov(25);
+        entities_.spotLight_ = registry_.Add(light);
     }
+    ConfigureSpotLight();
 
 }
 
+void World::ConfigureZone(){
+    Zone* zone = registry_.Get(entities_.zone_);
+    if (!zone)
+        return;
+    zone->SetAmbientColor(config_.ambientColor_);
+    zone->SetFogColor(config_.fogColor_);
+    zone->SetFogStart(config_.fogStart_);
+    zone->SetFogEnd(config_.fogEnd_);
+}
+
+void World::ConfigureSun(){
+    Light* light = registry_.Get(entities_.sun_);
+    if (!light)
+        return;
+    light->GetNode()->SetDirection(config_.sunDirection_);
+    light->SetShadowBias(BiasParameters(config_.shadowConstantBias_, config_.shadowSlopeBias_));
+    // Splits in world units, shadows fade out from a fraction of the maximum shadow distance
+    const Vector4& splits = config_.cascadeSplits_;
+    light->SetShadowCascade(CascadeParameters(splits.x_, splits.y_, splits.z_, splits.w_, config_.cascadeFadeStart_));
+}
+
+void World::ConfigureGround(){
+    if (StaticModel* plane = registry_.Get(entities_.plane_))
+        plane->GetNode()->SetScale(Vector3(config_.groundSize_, 1.0f, config_.groundSize_));
+}
+
+void World::ConfigureFire(){
+    SoaParticleEmitter* fire = registry_.Get(entities_.fire_);
+    if (!fire)
+        return;
+    fire->GetNode()->SetPosition(config_.firePosition_);
+    fire->GetNode()->SetScale(config_.fireScale_);
+    fire->SetMaxParticles(config_.fireParticles_);
+}
+
+void World::ConfigureCamera(){
+    camera_->SetFarClip(config_.farClip_);
+    // Chunks out to the far clip distance
+    if (streamer_)
+        streamer_->SetLoadRadius(config_.farClip_ / streamer_->GetChunkSize());
+}
+
+void World::ConfigureSpotLight(){
+    Light* light = registry_.Get(entities_.spotLight_);
+    if (!light)
+        return;
+    light->SetRange(config_.spotRange_);
+    light->SetColor(config_.spotColor_);
+    light->SetBrightness(config_.spotBrightness_);
+    light->SetFov(config_.spotFov_);
+}
+
+void World::WatchConfig(){
+    // Watch the directory, editors often replace a file rather than write to it
+    String fileName = options_.worldConfig_;
+    auto* fileSystem = GetSubsystem<FileSystem>();
+    if (!IsAbsolutePath(fileName))
+        fileName = fileSystem->GetCurrentDir() + fileName;
+
+    configWatcher_ = new FileWatcher(context_);
+    configWatcher_->SetDelay(0.25f);
+    if (!configWatcher_->StartWatching(GetPath(fileName), false))
+    {
+        URHO3D_LOGWARNINGF("Could not watch %s, the world config will not be reloaded", options_.worldConfig_.CString());
+        configWatcher_.Reset();
+    }
+}
+
+unsigned World::ApplyConfig(const WorldConfig& config){
+    TraceScope trace("World::ApplyConfig");
+    unsigned changed = config.Compare(config_);
+    config_ = config;
+
+    if (changed & CONFIG_ZONE)
+    {
+        ConfigureZone();
+        // The mushroom bands and the box draw distance follow the fog
+        if (options_.populationLod_ && !options_.stream_)
+            SetupPopulationLod();
+    }
+    if (changed & CONFIG_SUN)
+        ConfigureSun();
+    if (changed & CONFIG_FIRE)
+        ConfigureFire();
+    if (changed & CONFIG_CAMERA)
+        ConfigureCamera();
+    if (changed & CONFIG_SPOTLIGHT)
+        ConfigureSpotLight();
+    // The sections above were set to the config as it is, scale them to the governor's level again
+    if (qualityGovernor_ && (changed & (CONFIG_SUN | CONFIG_FIRE | CONFIG_CAMERA)))
+        qualityGovernor_->SetConfig(config_);
+
+    // A streamed world has no fixed field, its chunks scatter themselves with the field's categories
+    if (options_.stream_)
+    {
+        if (streamer_ && (changed & (CONFIG_BOXES | CONFIG_MUSHROOMS)))
+            streamer_->SetCategories(config_.boxes_, config_.mushrooms_);
+        return changed;
+    }
+
+    bool rebuildGrid = false;
+    if (changed & CONFIG_GROUND)
+    {
+        ConfigureGround();
+        rebuildGrid = true;
+    }
+    if (changed & (CONFIG_FIELD | CONFIG_BOXES | CONFIG_MUSHROOMS))
+    {
+        // Boxes are placed first and mushrooms around them, so the scatter runs whole. With only the
+        // mushrooms changed the boxes usually land where they were and their populations are left alone
+        PoissonScatter scatter;
+        ScatterField(scatter, config_, options_.seed_, jobSystem_.get());
+        const PODVector<ScatterPlacement>& boxes = scatter.GetPlacements(FIELD_BOXES);
+        bool boxesMoved = boxes.Size() != fieldBoxes_.Size();
+        for (unsigned i = 0; i < boxes.Size() && !boxesMoved; ++i)
+        {
+            boxesMoved = boxes[i].position_ != fieldBoxes_[i].position_ || boxes[i].yaw_ != fieldBoxes_[i].yaw_ ||
+                         boxes[i].scale_ != fieldBoxes_[i].scale_;
+        }
+        if (boxesMoved)
+        {
+            PopulateBoxes(boxes);
+            SetupOccluders();
+            fieldBoxes_ = boxes;
+            rebuildGrid = true;
+        }
+        PopulateMushrooms(scatter.GetPlacements(FIELD_MUSHROOMS));
+    }
+    if (rebuildGrid)
+        BuildCollisionGrid();
+    return changed;
+}
+
+bool World::ReloadConfig(){
+    // Read over the defaults, values the file no longer sets go back to them as on a fresh start
+    WorldConfig config;
+    if (!config.Load(context_, options_.worldConfig_))
+        return false;
+
+    HiresTimer timer;
+    unsigned changed = ApplyConfig(config);
+    reloadMs_ = timer.GetUSec(false) / 1000.0f;
+
+    String sections;
+    for (unsigned i = 0; i < NUM_CONFIG_SECTIONS; ++i)
+    {
+        if (changed & (1u << i))
+        {
+            sections += sections.Empty() ? "" : " ";
+            sections += WorldConfig::GetSectionName(1u << i);
+        }
+    }
+    URHO3D_LOGINFOF("World config reloaded in %.2f ms, changed: %s (start took %.2f ms)", reloadMs_,
+                    sections.Empty() ? "nothing" : sections.CString(), startupMs_);
+    return true;
+}
+
+void World::CreateStreamer(){
+    streamer_ = new ChunkStreamer(context_, scene_, &missiles_->GetCollisionGrid());
+    streamer_->SetAttachBudget(options_.streamBudgetUs_);
+    streamer_->SetSeed(options_.seed_);
+    streamer_->SetCategories(config_.boxes_, config_.mushrooms_);
+    ConfigureCamera();
+}
+
+void World::CreateQualityGovernor(){
+    qualityGovernor_ = new QualityGovernor(context_, options_.targetFrameMs_);
+
+    // Registered for built and cooked scenes alike, so both are governed the same way
+    qualityGovernor_->SetLight(registry_.Get(entities_.sun_));
+    qualityGovernor_->SetParticleEmitter(registry_.Get(entities_.fire_));
+    if (InstancedPopulation* mushrooms = registry_.Get(entities_.mushrooms_))
+        qualityGovernor_->AddPopulation(mushrooms);
+    qualityGovernor_->SetCamera(camera_);
+    qualityGovernor_->SetStreamer(streamer_);
+    qualityGovernor_->SetConfig(config_);
+}
+
 void World::SetupViewport(){
 
+    if (headless_)
+        return;
+
     auto* graphics = context_->GetSubsystem<Graphics>();
     Renderer* renderer= context_->GetSubsystem<Renderer>();
 
@@ -349,15 +1039,31 @@ void World::SetupViewport(){
 
 void World::SubscribeToEvents(){
 
-    scene_->SubscribeToEvent(E_UPDATE,URHO3D_HANDLER(World,HandleUpdate));
-    scene_->SubscribeToEvent(E_MOUSEBUTTONUP,URHO3D_HANDLER(World,HandleClick));
-    scene_->SubscribeToEvent(E_KEYDOWN,URHO3D_HANDLER(World,HandleKeyDown));
-    scene_->SubscribeToEvent(E_MOUSEWHEEL, URHO3D_HANDLER(World,HandleMouseWheel));
+    // Subscribed as World, on scene_ the update handler took the place of the scene's own and the scene never updated
+    SubscribeToEvent(E_UPDATE,URHO3D_HANDLER(World,HandleUpdate));
+    SubscribeToEvent(E_MOUSEBUTTONUP,URHO3D_HANDLER(World,HandleClick));
+    SubscribeToEvent(E_KEYDOWN,URHO3D_HANDLER(World,HandleKeyDown));
+    SubscribeToEvent(E_MOUSEWHEEL, URHO3D_HANDLER(World,HandleMouseWheel));
+    SubscribeToEvent(E_ENDFRAME, URHO3D_HANDLER(World,HandleEndFrame));
+    if (Trace::IsEnabled())
+    {
+        SubscribeToEvent(E_BEGINFRAME, URHO3D_HANDLER(World,HandleBeginFrame));
+        SubscribeToEvent(E_BEGINRENDERING, URHO3D_HANDLER(World,HandleBeginRendering));
+        SubscribeToEvent(E_ENDRENDERING, URHO3D_HANDLER(World,HandleEndRendering));
+    }
+}
+
+void World::ResetInterpolation() {
+    cameraSimPosition_ = cameraPrevPosition_ = cameraRenderPosition_ = cameraNode_->GetPosition();
+    previewSimRotation_ = previewPrevRotation_ = registry_.Get(entities_.missilePreview_)->GetRotation();
 }
 
 void World::UnSubscribeFromAllEvents() {
 
-    scene_->UnsubscribeFromAllEvents();
+    UnsubscribeFromEvent(E_UPDATE);
+    UnsubscribeFromEvent(E_MOUSEBUTTONUP);
+    UnsubscribeFromEvent(E_KEYDOWN);
+    UnsubscribeFromEvent(E_MOUSEWHEEL);
 }
 
 
@@ -366,6 +1072,25 @@ void World::UnSubscribeFromAllEvents() {
 
 void World::HandleUpdate(StringHash eventType, VariantMap &eventData) {
     float timeStep=eventData[Update::P_TIMESTEP].GetFloat();
+    if (!ReadInput(timeStep))
+        return;
+    // A replay runs on the recorded timesteps
+    timeStep = input_.timeStep_;
+    TraceScope trace("World::HandleUpdate");
+    AllocationScope allocations(ALLOC_WORLD);
+    HiresTimer sectionTimer;
+    if (qualityGovernor_)
+        qualityGovernor_->Update();
+    if (configWatcher_)
+    {
+        // Any number of writes in this frame make one reload
+        String changedFile;
+        bool reload = false;
+        while (configWatcher_->GetNextChange(changedFile))
+            reload |= GetFileNameAndExtension(changedFile) == GetFileNameAndExtension(options_.worldConfig_);
+        if (reload)
+            ReloadConfig();
+    }
     framecount_++;
     time_+=timeStep;
     // Movement speed as world units per second
@@ -375,55 +1100,55 @@ void World::HandleUpdate(StringHash eventType, VariantMap &eventData) {
 
     if(time_ >=1)
     {
-        std::string str;
-        str.append("Keys: tab = toggle mouse, AWSD = move camera, Shift = fast mode, Esc = quit.\n");
-        {
-            std::ostringstream ss;
-            ss<<framecount_;
-            std::string s(ss.str());
-            str.append(s.substr(0,6));
-        }
-        str.append(" frames in ");
-        {
-            std::ostringstream ss;
-            ss<<time_;
-            std::string s(ss.str());
-            str.append(s.substr(0,6));
-        }
-        str.append(" seconds = ");
-        {
-            std::ostringstream ss;
-            ss<<(float)framecount_/time_;
-            std::string s(ss.str());
-            str.append(s.substr(0,6));
-        }
-        str.append(" fps");
-        String s(str.c_str(),str.size());
-        text_->SetText(s);
-        URHO3D_LOGINFO(s);     // this show how to put stuff into the log
+        allocations.Set(ALLOC_UI);
+        unsigned long long totalAllocations = 0;
+        for (unsigned i = 0; i < MAX_ALLOC_TAGS; ++i)
+            totalAllocations += AllocationTracker::GetCounters((AllocationTag)i).allocations_;
+
+        // Formatted into a fixed buffer and copied into a String that keeps its capacity, so this allocates nothing
+        char overlay[256];
+        snprintf(overlay, sizeof(overlay),
+                 "Keys: tab = toggle mouse, AWSD = move camera, Shift = fast mode, Esc = quit.\n"
+                 "%d frames in %.3f seconds = %.1f fps, %.2f ms, %.1f allocations per frame\n"
+                 "camera %.2f  missiles %.2f  alerts %.2f  preview %.2f  streaming %.2f ms",
+                 framecount_, time_, framecount_ / time_, time_ * 1000.0f / framecount_,
+                 (double)(totalAllocations - overlayAllocations_) / framecount_,
+                 timings_.cameraUs_ / 1000.0f, timings_.missilesUs_ / 1000.0f, timings_.alertsUs_ / 1000.0f,
+                 timings_.previewUs_ / 1000.0f, timings_.streamingUs_ / 1000.0f);
+        overlayText_ = overlay;
+        text_->SetText(overlayText_);
+        overlayAllocations_ = totalAllocations;
+        allocations.Set(ALLOC_WORLD);
         framecount_=0;
         time_=0;
     }
 
 
-    if(!context_->GetSubsystem<Input>()->IsMouseVisible())
+    // Each section is traced under the name of the timing it adds to
+    TraceScope section("World::Camera");
+
+    // Moved from outside, e.g. by a benchmark script, jump there rather than interpolate
+    if (cameraNode_->GetPosition() != cameraRenderPosition_)
+        cameraSimPosition_ = cameraPrevPosition_ = cameraNode_->GetPosition();
+
+    Vector3 moveVelocity;
+    if(!input_.mouseVisible_)
     {
-        Input* input= context_->GetSubsystem<Input>();
-        if(input->GetKeyDown(KEY_SHIFT))
+        if(input_.keys_ & INPUT_KEY_SHIFT)
             MOVE_SPEED*=10;
-        if(input->GetKeyDown(KEY_W))
-            cameraNode_->Translate(Vector3(0,0, 1)*MOVE_SPEED*timeStep);
-        if(input->GetKeyDown(KEY_S))
-            cameraNode_->Translate(Vector3(0,0,-1)*MOVE_SPEED*timeStep);
-        if(input->GetKeyDown(KEY_A))
-            cameraNode_->Translate(Vector3(-1,0,0)*MOVE_SPEED*timeStep);
-        if(input->GetKeyDown(KEY_D))
-            cameraNode_->Translate(Vector3( 1,0,0)*MOVE_SPEED*timeStep);
+        if(input_.keys_ & INPUT_KEY_W)
+            moveVelocity+=Vector3(0,0, 1)*MOVE_SPEED;
+        if(input_.keys_ & INPUT_KEY_S)
+            moveVelocity+=Vector3(0,0,-1)*MOVE_SPEED;
+        if(input_.keys_ & INPUT_KEY_A)
+            moveVelocity+=Vector3(-1,0,0)*MOVE_SPEED;
+        if(input_.keys_ & INPUT_KEY_D)
+            moveVelocity+=Vector3( 1,0,0)*MOVE_SPEED;
 
 
 
         // Use this frame's mouse motion to adjust camera node yaw and pitch. Clamp the pitch between -90 and 90 degrees
-        IntVector2 mouseMove=input->GetMouseMove();
+        IntVector2 mouseMove=input_.mouseMove_;
         static float yaw_=0;
         static float pitch_=0;
         yaw_+=MOUSE_SENSITIVITY*mouseMove.x_;
@@ -434,18 +1159,119 @@ void World::HandleUpdate(StringHash eventType, VariantMap &eventData) {
         cameraNode_->Yaw(yaw_);
         cameraNode_->Pitch(pitch_);
     }
+    // Keys move the camera along its own axes, like Node::Translate did
+    moveVelocity = cameraNode_->GetRotation() * moveVelocity;
+    bool rotatePreview = previewScheduler_->GetMode() != PREVIEW_SPRITESHEET;
+
+    // Run the gameplay at fixed ticks, however long the frame was
+    unsigned steps = fixedStep_.Advance(timeStep);
+    float step = fixedStep_.GetStep();
+
+    // A few adds per tick, not worth a job, and kept here so they count as camera time
+    for (unsigned i = 0; i < steps; ++i)
+    {
+        cameraPrevPosition_ = cameraSimPosition_;
+        cameraSimPosition_ += moveVelocity * step;
+        if (rotatePreview)
+        {
+            previewPrevRotation_ = previewSimRotation_;
+            previewSimRotation_ = previewSimRotation_ * Quaternion(8*step,16*step,0);
+        }
+    }
+    timings_.cameraUs_ = sectionTimer.GetUSec(true);
+    section.Next("World::Alerts");
+    allocations.Set(ALLOC_ALERTS);
+
+    // Alerts show and hide UI elements, which only works on the main thread, so every alert tick of the
+    // frame runs before the missile ticks rather than interleaved with them. Neither reads the other's
+    // state, and alerts are only shown from outside the ticks, so the result is the same.
+    for (unsigned i = 0; i < steps; ++i)
+        alertBoard_->Update(step);
+    timings_.alertsUs_ = sectionTimer.GetUSec(true);
+    section.Next("World::Missiles");
+    allocations.Set(ALLOC_MISSILES);
+
+    // A single sync for every tick of the frame, before rendering
+    missiles_->RunTicks(*jobSystem_, steps, step);
+    timings_.missilesUs_ = sectionTimer.GetUSec(true);
+    section.Next("World::Camera");
+    allocations.Set(ALLOC_WORLD);
+
+    // Place the camera between the last two ticks
+    float alpha = fixedStep_.GetAlpha();
+    cameraRenderPosition_ = cameraPrevPosition_.Lerp(cameraSimPosition_, alpha);
+    cameraNode_->SetPosition(cameraRenderPosition_);
+    timings_.cameraUs_ += sectionTimer.GetUSec(true);
+    section.Next("World::Streaming");
+    allocations.Set(ALLOC_STREAMING);
+
+    if (streamer_)
+        streamer_->Update(cameraNode_->GetWorldPosition(), frameArena_);
+    timings_.streamingUs_ = sectionTimer.GetUSec(true);
+    section.Next("World::Missiles");
+    allocations.Set(ALLOC_MISSILES);
 
     //Update Controllers
-    missileController_->MoveMissiles(timeStep);
+    MissilePool& missilePool = missiles_->GetPool();
+    missilePool.BindNodes(camera_->GetFrustum(), fixedStep_.GetLag());
+    // One event for all of this frame's hits
+    missiles_->SendHitEvent(this);
+    const unsigned PARTICLES_PER_HIT = 64;
+    for (const MissileHit& hit : missiles_->GetHits())
+        explosions_->Burst(hit.position_, PARTICLES_PER_HIT);
+    if (trails_)
+    {
+        // A puff per missile every interval, where the missile is drawn. Once the pool is full the
+        // remaining missiles go without until older puffs have died.
+        const float TRAIL_INTERVAL = 0.05f;
+        trailTimer_ += timeStep;
+        if (trailTimer_ >= TRAIL_INTERVAL)
+        {
+            trailTimer_ = Min(trailTimer_ - TRAIL_INTERVAL, TRAIL_INTERVAL);
+            float lag = fixedStep_.GetLag();
+            for (unsigned i = 0; i < missilePool.GetNumMissiles(); ++i)
+            {
+                Vector3 position = missilePool.GetPosition(i) - missilePool.GetVelocity(i) * lag;
+                if (!trails_->Burst(position, 1))
+                    break;
+            }
+        }
+    }
+    timings_.missilesUs_ += sectionTimer.GetUSec(true);
+    section.Next("World::Alerts");
+    allocations.Set(ALLOC_ALERTS);
     alertController_->CheckAlerts();
+    timings_.alertsUs_ += sectionTimer.GetUSec(true);
+    section.Next("World::Preview");
+    allocations.Set(ALLOC_UI);
+
 
 
+    // Rotate the overlayScenes preview object, a baked sprite sheet animates itself
+    if (rotatePreview)
+    {
+        Node* missilePreviewNode = registry_.Get(entities_.missilePreview_);
+        missilePreviewNode->SetRotation(previewPrevRotation_.Slerp(previewSimRotation_, alpha));
+        previewScheduler_->MarkDirty();
+    }
+    previewScheduler_->Update(timeStep);
+    timings_.previewUs_ = sectionTimer.GetUSec(true);
+}
+
 
-    // Rotate the overlayScenes preview object
-    Node* missilePreviewNode = overlayScene_->GetChild("missilePreview");
-    missilePreviewNode->Rotate(Quaternion(8*timeStep,16*timeStep,0));
+void World::HandlePreloadProgress(StringHash eventType, VariantMap& eventData)
+{
+    using namespace PreloadProgress;
+    URHO3D_LOGINFOF("Loading resources %u/%u", eventData[P_FINISHED].GetUInt(), eventData[P_TOTAL].GetUInt());
 }
 
+void World::HandlePreloadFinished(StringHash eventType, VariantMap& eventData)
+{
+    UnsubscribeFromEvent(preloader_, E_PRELOADPROGRESS);
+    UnsubscribeFromEvent(preloader_, E_PRELOADFINISHED);
+    preloader_.Reset();
+    BuildScene();
+}
 
 void World::HandleClosePressed(StringHash eventType,VariantMap& eventData)
 {
@@ -454,8 +1280,13 @@ void World::HandleClosePressed(StringHash eventType,VariantMap& eventData)
 
 void World::HandleClick(StringHash eventType, VariantMap &eventData)
 {
+    // A replay only sees the clicks that were recorded
+    if (replay_)
+        return;
     if (!context_->GetSubsystem<Input>()->IsMouseVisible()){
-        missileController_->CreateMissile(cameraNode_->GetPosition() ,cameraNode_->GetDirection());
+        InputEvent event = {INPUT_CLICK, 0};
+        input_.events_.Push(event);
+        ApplyInputEvent(event);
     }
 
 }
@@ -464,23 +1295,134 @@ void World::HandleClick(StringHash eventType, VariantMap &eventData)
 void World::HandleMouseWheel(StringHash eventType,VariantMap& eventData)
 {
     using namespace MouseWheel;
-    int roll = eventData[P_WHEEL].GetInt();
-    camera_zoom_ += roll*0.1;
-    camera_->SetZoom(camera_zoom_);
+    if (replay_)
+        return;
+    InputEvent event = {INPUT_WHEEL, eventData[P_WHEEL].GetInt()};
+    input_.events_.Push(event);
+    ApplyInputEvent(event);
 }
 
 void World::HandleKeyDown(StringHash eventType,VariantMap& eventData)
 {
     using namespace KeyDown;
-    int key=eventData[P_KEY].GetInt();
-    if(key==KEY_ESC)
-        context_->GetSubsystem<Engine>()->Exit();
+    if (replay_)
+        return;
+    InputEvent event = {INPUT_KEYDOWN, eventData[P_KEY].GetInt()};
+    input_.events_.Push(event);
+    ApplyInputEvent(event);
+}
+
+bool World::ReadInput(float timeStep) {
+    scene_->SetUpdateEnabled(true);
 
-    if(key==KEY_TAB)    // toggle mouse cursor when pressing tab
+    if (replay_)
     {
-        context_->GetSubsystem<Input>()->SetMouseVisible(!context_->GetSubsystem<Input>()->IsMouseVisible());
+        if (replayFrame_ >= replay_->GetNumFrames())
+        {
+            if (!replayFinished_)
+                FinishReplay();
+            return false;
+        }
+
+        // Events were handled before the update they were recorded with
+        input_ = replay_->GetFrame(replayFrame_++);
+        for (const InputEvent& event : input_.events_)
+            ApplyInputEvent(event);
+        return true;
+    }
+
+    Input* input = context_->GetSubsystem<Input>();
+    input_.timeStep_ = timeStep;
+    input_.mouseVisible_ = input->IsMouseVisible();
+    input_.keys_ = 0;
+    if (input->GetKeyDown(KEY_SHIFT))
+        input_.keys_ |= INPUT_KEY_SHIFT;
+    if (input->GetKeyDown(KEY_W))
+        input_.keys_ |= INPUT_KEY_W;
+    if (input->GetKeyDown(KEY_S))
+        input_.keys_ |= INPUT_KEY_S;
+    if (input->GetKeyDown(KEY_A))
+        input_.keys_ |= INPUT_KEY_A;
+    if (input->GetKeyDown(KEY_D))
+        input_.keys_ |= INPUT_KEY_D;
+    input_.mouseMove_ = input->GetMouseMove();
+    if (recorder_)
+        recorder_->Write(input_);
+    // The events pushed by the handlers belong to this update, the next one starts empty
+    input_.events_.Clear();
+    return true;
+}
+
+void World::HandleBeginFrame(StringHash eventType, VariantMap& eventData)
+{
+    frameStartNs_ = Trace::Now();
+}
+
+void World::HandleEndFrame(StringHash eventType, VariantMap& eventData)
+{
+    frameArena_.Reset();
+
+    if (frameStartNs_)
+    {
+        Trace::Record("Frame", frameStartNs_, Trace::Now());
+        frameStartNs_ = 0;
     }
-    if(key==KEY_G){
-        CreateAlert("G was pressed!", 3.0);
+
+    // After the frame limiter has measured the frame, so the recorded step is what the next frame gets
+    if (replay_ && replayFrame_ < replay_->GetNumFrames())
+        GetSubsystem<Engine>()->SetNextTimeStep(replay_->GetFrame(replayFrame_).timeStep_);
+}
+
+void World::HandleBeginRendering(StringHash eventType, VariantMap& eventData)
+{
+    renderStartNs_ = Trace::Now();
+}
+
+void World::HandleEndRendering(StringHash eventType, VariantMap& eventData)
+{
+    Trace::Record("Renderer::Render", renderStartNs_, Trace::Now());
+}
+
+void World::ApplyInputEvent(const InputEvent& event) {
+    switch (event.type_)
+    {
+    case INPUT_KEYDOWN:
+        if(event.value_==KEY_ESC)
+            context_->GetSubsystem<Engine>()->Exit();
+
+        if(event.value_==KEY_TAB)    // toggle mouse cursor when pressing tab
+        {
+            context_->GetSubsystem<Input>()->SetMouseVisible(!context_->GetSubsystem<Input>()->IsMouseVisible());
+        }
+        if(event.value_==KEY_G){
+            CreateAlert("G was pressed!", 3.0);
+        }
+        break;
+
+    case INPUT_CLICK:
+        FireMissile();
+        break;
+
+    case INPUT_WHEEL:
+        camera_zoom_ += event.value_*0.1;
+        camera_->SetZoom(camera_zoom_);
+        break;
     }
 }
+
+void World::FinishReplay() {
+    replayFinished_ = true;
+    unsigned hash = GetStateHash();
+    replayMatch_ = replay_->HasStateHash() && hash == replay_->GetStateHash();
+    if (!replay_->HasStateHash())
+        URHO3D_LOGWARNINGF("Replay of %u frames finished, state %08x, the log has no final state to compare with",
+                           replay_->GetNumFrames(), hash);
+    else if (replayMatch_)
+        URHO3D_LOGINFOF("Replay of %u frames finished in the recorded state %08x", replay_->GetNumFrames(), hash);
+    else
+        URHO3D_LOGERRORF("Replay of %u frames finished in state %08x, the recording ended in %08x",
+                         replay_->GetNumFrames(), hash, replay_->GetStateHash());
+
+    if (exitAfterReplay_)
+        context_->GetSubsystem<Engine>()->Exit();
+}
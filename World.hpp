@@ -10,6 +10,7 @@
 #include <sstream>
 
 #include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Core/Timer.h>
 #include <Urho3D/Engine/Application.h>
 #include <Urho3D/Engine/Engine.h>
 #include <Urho3D/Input/Input.h>
@@ -18,6 +19,7 @@
 #include <Urho3D/Resource/XMLFile.h>
 
 #include <Urho3D/IO/Log.h>
+#include <Urho3D/IO/FileWatcher.h>
 
 
 #include <Urho3D/UI/CheckBox.h>
@@ -37,6 +39,7 @@
 #include <Urho3D/Scene/SceneEvents.h>
 
 #include <Urho3D/Graphics/Graphics.h>
+#include <Urho3D/Graphics/GraphicsEvents.h>
 #include <Urho3D/Graphics/Camera.h>
 #include <Urho3D/Graphics/Geometry.h>
 #include <Urho3D/Graphics/Renderer.h>
@@ -57,22 +60,205 @@
 #include <Urho3D/Graphics/RenderPath.h>
 
 
-#include "../../ObjectHandlers/MissileController.hpp"
 #include "../../ObjectHandlers/AlertController.hpp"
 #include "../../UI/AlertMaker.hpp"
+#include "MissileSimulation.hpp"
+#include "InstancedPopulation.hpp"
+#include "GameEvents.hpp"
+#include "ResourcePreloader.hpp"
+#include "PreviewRenderScheduler.hpp"
+#include "ChunkStreamer.hpp"
+#include "PoissonScatter.hpp"
+#include "CookedScene.hpp"
+#include "SoaParticleEmitter.hpp"
+#include "InputLog.hpp"
+#include "Trace.hpp"
+#include "AllocationTracker.hpp"
+#include "FrameArena.hpp"
+#include "AlertBoard.hpp"
+#include "FixedTimestep.hpp"
+#include "JobSystem.hpp"
+#include "QualityGovernor.hpp"
+#include "WorldConfig.hpp"
+#include "EntityRegistry.hpp"
 
 using namespace Urho3D;
 
+/// Time spent in each section of World::HandleUpdate during the last frame, in microseconds.
+struct WorldFrameTimings {
+    long long cameraUs_ = 0;
+    long long missilesUs_ = 0;
+    long long alertsUs_ = 0;
+    long long previewUs_ = 0;
+    long long streamingUs_ = 0;
+};
+
+/// Handles of the objects World changes after its scene is built, see EntityRegistry. Null where the scene has none.
+struct WorldEntities {
+    Handle<Node> missilePreview_;
+    Handle<Zone> zone_;
+    Handle<Light> sun_;
+    Handle<Light> spotLight_;
+    Handle<StaticModel> plane_;
+    Handle<SoaParticleEmitter> fire_;
+    Handle<InstancedPopulation> mushrooms_;
+    /// Boxes, then OccluderBoxes.
+    Handle<InstancedPopulation> boxes_[2];
+};
+
+/// Categories of the fixed field, in the order World::ScatterField adds them.
+enum FieldCategory {
+    FIELD_BOXES = 0,
+    FIELD_MUSHROOMS
+};
+
+/// Runtime options for World, parsed from the command line.
+struct WorldOptions {
+
+    static WorldOptions Parse(const Vector<String>& arguments);
+
+    /// Load resources on worker threads before building the scene, -syncload turns this off.
+    bool preload_ = true;
+    /// -preview always|capped|onchange|spritesheet
+    PreviewUpdateMode previewMode_ = PREVIEW_CAPPED;
+    /// -previewrate HZ, the render cap of the capped preview mode.
+    float previewRate_ = 15.0f;
+    /// -stream, stream chunks of ground around the camera instead of building the fixed field.
+    bool stream_ = false;
+    /// -streambudget US, time per frame spent attaching streamed chunks.
+    unsigned streamBudgetUs_ = 2000;
+    /// -cook PATH, write the built scenes to a cooked file.
+    String cookScene_;
+    /// -cooked PATH, instantiate the scenes from a cooked file instead of building them.
+    String cookedScene_;
+    /// -tickrate HZ, rate of the fixed simulation tick.
+    float tickRate_ = 60.0f;
+    /// -maxsteps N, most simulation ticks run in one frame before time is dropped.
+    unsigned maxCatchUpSteps_ = 5;
+    /// -threads N, threads running the simulation jobs including the main thread, 0 for one per core.
+    unsigned threads_ = 0;
+    /// -nolod turns off the distance bands of the mushrooms and the box draw distance.
+    bool populationLod_ = true;
+    /// -occluders adaptive|fixed: pick occluder boxes by screen coverage each frame, or every box of size 3 and up.
+    bool adaptiveOccluders_ = true;
+    /// -occluderbudget TRIS, triangles per frame the adaptive occluders of all box populations may draw together.
+    unsigned occluderBudget_ = 1200;
+    /// -adaptive, let a QualityGovernor trade quality for frame time.
+    bool adaptiveQuality_ = false;
+    /// -targetms MS, frame time the governor aims for.
+    float targetFrameMs_ = 16.7f;
+    /// -explosionparticles N, size of the particle pool missile hits burst into.
+    unsigned explosionParticles_ = 20000;
+    /// -trailparticles N, size of the particle pool flying missiles leave trails in, 0 for no trails.
+    unsigned trailParticles_ = 20000;
+    /// -seed N, random seed the scene is built and run with. A replay uses the seed of its log.
+    unsigned seed_ = 1;
+    /// -record PATH, write the input of the session to an input log.
+    String record_;
+    /// -replay PATH, feed an input log back instead of live input and exit at its end.
+    String replay_;
+    /// -trace PATH, record scoped timings from the start and write them as Chrome trace JSON on exit.
+    String trace_;
+    /// -worldconfig PATH, read the world's content from a WorldConfig file and apply its changes while running.
+    String worldConfig_;
+};
+
 struct World : Object{
 
     URHO3D_OBJECT(World, Object);
 
     World(Context * context);
 
-    void start();
+    ~World();
+
+    /// Build the world. With preload the resources are loaded in the background first and the
+    /// scene is built on a later frame, otherwise everything is loaded and built right away.
+    void start(const WorldOptions& options = WorldOptions());
+
+    const WorldOptions& GetOptions() const { return options_; }
+
+    const WorldConfig& GetConfig() const { return config_; }
+
+    /// Bring the built world in line with config, redoing only the sections that differ. Returns their WorldConfigSection bits.
+    unsigned ApplyConfig(const WorldConfig& config);
+
+    /// Read the -worldconfig file again and apply it. False, with the world unchanged, if it could not be read.
+    bool ReloadConfig();
+
+    /// Time the last ReloadConfig spent applying the changes.
+    float GetReloadMs() const { return reloadMs_; }
+
+    void BuildScene();
+
+    /// Create every node and component of scene_ and overlayScene_ procedurally.
+    void CreateSceneContent();
+
+    bool LoadCookedScene(const String& fileName);
+
+    bool CookScene(const String& fileName);
+
+    bool IsReady() const { return ready_; }
+
+    /// Time from start() until the scene was built.
+    float GetStartupMs() const { return startupMs_; }
+
+    /// Time spent creating or instantiating the scene content alone.
+    float GetSceneBuildMs() const { return sceneBuildMs_; }
+
+    Scene* GetScene() const { return scene_; }
+
+    Scene* GetOverlayScene() const { return overlayScene_; }
+
+    const EntityRegistry& GetRegistry() const { return registry_; }
+
+    const WorldEntities& GetEntities() const { return entities_; }
+
+    /// Find the scene's objects by name and register them, after the scene is built or loaded.
+    void RegisterEntities();
+
+    /// Transient memory for the main thread, reset at the end of every frame.
+    FrameArena& GetFrameArena() { return frameArena_; }
 
     void CreateAlert(const std::string & text, const float lifeTime);
 
+    void FireMissile();
+
+    Node* GetCameraNode() const { return cameraNode_; }
+
+    unsigned GetNumMissiles() const { return missiles_->GetPool().GetNumMissiles(); }
+
+    unsigned GetNumMissileHits() const { return missiles_->GetHits().Size(); }
+
+    unsigned GetPreviewRendersThisFrame() const { return previewScheduler_->GetRendersThisFrame(); }
+
+    const WorldFrameTimings& GetFrameTimings() const { return timings_; }
+
+    AlertBoard* GetAlertBoard() const { return alertBoard_; }
+
+    const FixedTimestep& GetFixedTimestep() const { return fixedStep_; }
+
+    JobSystem* GetJobSystem() const { return jobSystem_.get(); }
+
+    /// Null unless the world was started with adaptiveQuality_.
+    QualityGovernor* GetQualityGovernor() const { return qualityGovernor_; }
+
+    /// Null unless the world was started with stream_.
+    ChunkStreamer* GetStreamer() const { return streamer_; }
+
+    bool IsReplaying() const { return replay_.get() != nullptr; }
+
+    /// Exit the engine once the replay log has run out, on by default.
+    void SetExitAfterReplay(bool enable) { exitAfterReplay_ = enable; }
+
+    /// Every frame of the replay log has been fed back.
+    bool IsReplayFinished() const { return replayFinished_; }
+
+    /// The replay ended in the state the recording did. False when the log has no state hash.
+    bool IsReplayMatch() const { return replayMatch_; }
+
+    /// Hash of the camera, missiles, alerts, tick and random state, equal at the end of a recording and its replay.
+    unsigned GetStateHash() const;
+
     void SetWorldColour(Scene* scene);
 
     void CreateOverlayCamera();
@@ -87,26 +273,82 @@ struct World : Object{
 
     void CreateAmbientLigthing();
 
-    void CreateMushrooms(ResourceCache* cache);
+    Material* SetupMushroomMaterial(ResourceCache* cache);
+
+    /// Place the field's boxes and then the mushrooms around them. The dedicated server scatters the same field.
+    static void ScatterField(PoissonScatter& scatter, const WorldConfig& config, unsigned seed, JobSystem* jobSystem);
+
+    /// The unit box a scattered box placement becomes, scaled and stood on the ground.
+    static BoundingBox GetFieldBoxBounds(const ScatterPlacement& placement);
+
+    /// The top of the ground plane the config describes.
+    static BoundingBox GetGroundBounds(const WorldConfig& config);
+
+    void CreateMushrooms(ResourceCache* cache, const PODVector<ScatterPlacement>& placements);
+
+    void CreateBoxes(ResourceCache* cache, const PODVector<ScatterPlacement>& placements);
+
+    /// Replace the instances of the existing mushroom population.
+    void PopulateMushrooms(const PODVector<ScatterPlacement>& placements);
+
+    /// Replace the instances of the existing box populations.
+    void PopulateBoxes(const PODVector<ScatterPlacement>& placements);
+
+    void BuildCollisionGrid();
 
-    void CreateBoxes(ResourceCache* cache);
+    /// Split the mushrooms into full, simplified and impostor bands and stop drawing boxes at the fog end.
+    /// Called again after the fog changes, the existing bands only get their new ranges.
+    void SetupPopulationLod();
+
+    /// Apply the occluder mode to the box populations.
+    void SetupOccluders();
 
     void CreateDirectionLight();
 
     void CreateParticleEmmitter(ResourceCache* cache);
 
+    /// Put the fire on the job system and create the pool missile hits burst into.
+    void SetupParticles();
+
     void CreateCamera();
 
     void CreateSpotLight();
 
+    // Set the config's values on the registered objects, which cooked scenes have as well
+    void ConfigureZone();
+
+    void ConfigureSun();
+
+    void ConfigureGround();
+
+    void ConfigureFire();
+
+    void ConfigureCamera();
+
+    void ConfigureSpotLight();
+
+    /// Watch the -worldconfig file for changes, see HandleUpdate.
+    void WatchConfig();
+
+    void CreateStreamer();
+
+    void CreateQualityGovernor();
+
     void SetupViewport();
 
     void SubscribeToEvents();
 
+    /// Take the current camera and preview transforms as both the previous and the current tick.
+    void ResetInterpolation();
+
     void UnSubscribeFromAllEvents();
 
 
 
+    void HandlePreloadProgress(StringHash eventType,VariantMap& eventData);
+
+    void HandlePreloadFinished(StringHash eventType,VariantMap& eventData);
+
     void HandleClosePressed(StringHash eventType,VariantMap& eventData);
 
     void HandleClick(StringHash eventType,VariantMap& eventData);
@@ -118,19 +360,72 @@ struct World : Object{
 
     void HandleKeyDown(StringHash eventType,VariantMap& eventData);
 
+    /// Fill input_ for this update from the devices, recording it, or from the replay log. False once the log has run out.
+    bool ReadInput(float timeStep);
+
+    /// What a key press, missile click or wheel roll does, live or replayed.
+    void ApplyInputEvent(const InputEvent& event);
+
+    void FinishReplay();
+
     void HandleUpdate(StringHash eventType,VariantMap& eventData);
 
+    /// Reset the frame arena, trace the whole frame and, while replaying, feed the engine the next recorded timestep.
+    void HandleEndFrame(StringHash eventType,VariantMap& eventData);
+
+    // Only subscribed while tracing
+    void HandleBeginFrame(StringHash eventType,VariantMap& eventData);
+
+    void HandleBeginRendering(StringHash eventType,VariantMap& eventData);
+
+    void HandleEndRendering(StringHash eventType,VariantMap& eventData);
+
 
 
 private:
     int framecount_;
     float time_;
 
+    // No Graphics/Renderer subsystems, so no viewports or render targets can be created
+    bool headless_;
+
+    WorldFrameTimings timings_;
+
+    // Gameplay runs at fixed ticks, nodes are placed between the last two ticks for rendering
+    FixedTimestep fixedStep_;
+    Vector3 cameraPrevPosition_;
+    Vector3 cameraSimPosition_;
+    /// Where the camera was last placed, anything else means it was moved from outside.
+    Vector3 cameraRenderPosition_;
+    Quaternion previewPrevRotation_;
+    Quaternion previewSimRotation_;
+
+    // The ticks of a frame run as one job graph on these threads
+    std::unique_ptr<JobSystem> jobSystem_;
+
+    WorldOptions options_;
+
+    // What the world is built from, and the file it is reloaded from when it changes
+    WorldConfig config_;
+    SharedPtr<FileWatcher> configWatcher_;
+    /// Box placements the field was last built from, so a change to the mushrooms alone can tell whether the boxes moved.
+    PODVector<ScatterPlacement> fieldBoxes_;
+    float reloadMs_ = 0;
+
+    SharedPtr<ResourcePreloader> preloader_;
+    HiresTimer startupTimer_;
+    float startupMs_ = 0;
+    float sceneBuildMs_ = 0;
+    bool ready_ = false;
+
     SharedPtr<Context> context_;
 
     SharedPtr<Scene> scene_;
     SharedPtr<Scene> overlayScene_;
 
+    EntityRegistry registry_;
+    WorldEntities entities_;
+
     SharedPtr<Node> cameraNode_;
     SharedPtr<Node> overlayCameraNode_;
 
@@ -140,10 +435,43 @@ private:
     SharedPtr<ResourceCache> cache_;
 
     SharedPtr<UIElement> uiRoot_;
+    /// Elements added to uiRoot_, removed again when the world is destroyed.
+    Vector<SharedPtr<UIElement> > uiElements_;
 
     SharedPtr<Text> text_;
-
-    std::unique_ptr<MissileController> missileController_;
+    /// Reused for the once a second overlay text.
+    String overlayText_;
+    /// Allocations of every subsystem when the overlay was last updated.
+    unsigned long long overlayAllocations_ = 0;
+    /// Reused for alert text handed over as std::string.
+    String alertText_;
+
+    FrameArena frameArena_;
+
+    SharedPtr<PreviewRenderScheduler> previewScheduler_;
+
+    std::unique_ptr<MissileSimulation> missiles_;
+
+    // Input of the current update, from the devices or a replay log
+    InputFrame input_;
+    std::unique_ptr<InputRecorder> recorder_;
+    std::unique_ptr<InputReplay> replay_;
+    unsigned replayFrame_ = 0;
+    bool replayFinished_ = false;
+    bool replayMatch_ = false;
+    bool exitAfterReplay_ = true;
+
+    long long frameStartNs_ = 0;
+    long long renderStartNs_ = 0;
+    SharedPtr<SoaParticleEmitter> explosions_;
+    /// Null when trails are turned off.
+    SharedPtr<SoaParticleEmitter> trails_;
+    /// Time since the last trail puffs were emitted.
+    float trailTimer_ = 0.0f;
+    SharedPtr<ChunkStreamer> streamer_;
+    SharedPtr<QualityGovernor> qualityGovernor_;
+    // Alerts raised through CreateAlert, pooled and expired by a timer wheel
+    SharedPtr<AlertBoard> alertBoard_;
     std::unique_ptr<AlertController> alertController_;
     std::unique_ptr<AlertMaker> alertMaker_;
 
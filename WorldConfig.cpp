@@ -0,0 +1,186 @@
+#include "WorldConfig.hpp"
+
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Resource/XMLFile.h>
+
+namespace {
+
+const char* SECTION_NAMES[NUM_CONFIG_SECTIONS] = {
+    "zone", "sun", "ground", "field", "boxes", "mushrooms", "fire", "camera", "spotlight"
+};
+
+bool operator ==(const ScatterCategory& lhs, const ScatterCategory& rhs) {
+    return lhs.radius_ == rhs.radius_ && lhs.candidatesPerUnit2_ == rhs.candidatesPerUnit2_ &&
+           lhs.minScale_ == rhs.minScale_ && lhs.maxScale_ == rhs.maxScale_ && lhs.density_ == rhs.density_;
+}
+
+// Each reader leaves the value alone when the attribute is missing
+void ReadFloat(const XMLElement& element, const char* name, float& value) {
+    if (element.HasAttribute(name))
+        value = element.GetFloat(name);
+}
+
+void ReadUInt(const XMLElement& element, const char* name, unsigned& value) {
+    if (element.HasAttribute(name))
+        value = element.GetUInt(name);
+}
+
+void ReadVector3(const XMLElement& element, const char* name, Vector3& value) {
+    if (element.HasAttribute(name))
+        value = element.GetVector3(name);
+}
+
+void ReadVector4(const XMLElement& element, const char* name, Vector4& value) {
+    if (element.HasAttribute(name))
+        value = element.GetVector4(name);
+}
+
+void ReadColor(const XMLElement& element, const char* name, Color& value) {
+    if (element.HasAttribute(name))
+        value = element.GetColor(name);
+}
+
+// Candidates are counted over the file's field, the category keeps them as a density
+void ReadCategory(const XMLElement& element, float fieldArea, ScatterCategory& category) {
+    if (!element)
+        return;
+    ReadFloat(element, "radius", category.radius_);
+    if (element.HasAttribute("candidates"))
+        category.candidatesPerUnit2_ = element.GetFloat("candidates") / fieldArea;
+    ReadFloat(element, "minScale", category.minScale_);
+    ReadFloat(element, "maxScale", category.maxScale_);
+}
+
+}
+
+WorldConfig::WorldConfig()
+                :ambientColor_(0.15f, 0.15f, 0.15f),
+                fogColor_(0.5f, 0.5f, 0.7f),
+                fogStart_(100.0f),
+                fogEnd_(300.0f),
+                sunDirection_(0.6f, -1.0f, 0.8f),
+                shadowConstantBias_(0.00025f),
+                shadowSlopeBias_(0.5f),
+                cascadeSplits_(10.0f, 50.0f, 200.0f, 0.0f),
+                cascadeFadeStart_(0.8f),
+                groundSize_(100.0f),
+                fieldSize_(90.0f),
+                firePosition_(0.0f, 10.0f, 10.0f),
+                fireScale_(5.0f, 6.0f, 6.0f),
+                fireParticles_(100),
+                farClip_(300.0f),
+                spotRange_(20.0f),
+                spotColor_(0.6f, 1.0f, 0.6f, 1.0f),
+                spotBrightness_(2.8f),
+                spotFov_(25.0f)
+                {
+    // Footprints are the unit box's half diagonal and about the mushroom cap
+    boxes_.radius_ = 0.71f;
+    boxes_.candidatesPerUnit2_ = 20.0f / (80.0f * 80.0f);
+    boxes_.minScale_ = 1.0f;
+    boxes_.maxScale_ = 11.0f;
+
+    mushrooms_.radius_ = 0.5f;
+    mushrooms_.candidatesPerUnit2_ = 240.0f / (90.0f * 90.0f);
+    mushrooms_.minScale_ = 0.5f;
+    mushrooms_.maxScale_ = 2.5f;
+}
+
+bool WorldConfig::Load(Context* context, const String& fileName) {
+    File file(context, fileName);
+    SharedPtr<XMLFile> xml(new XMLFile(context));
+    if (!file.IsOpen() || !xml->Load(file))
+    {
+        URHO3D_LOGERRORF("Could not read world config %s", fileName.CString());
+        return false;
+    }
+    XMLElement root = xml->GetRoot("world");
+    if (!root)
+    {
+        URHO3D_LOGERRORF("World config %s has no world element", fileName.CString());
+        return false;
+    }
+
+    // Filled in on a copy, so a file that fails halfway through leaves nothing half applied
+    WorldConfig config = *this;
+    if (XMLElement zone = root.GetChild("zone"))
+    {
+        ReadColor(zone, "ambientColor", config.ambientColor_);
+        ReadColor(zone, "fogColor", config.fogColor_);
+        ReadFloat(zone, "fogStart", config.fogStart_);
+        ReadFloat(zone, "fogEnd", config.fogEnd_);
+    }
+    if (XMLElement sun = root.GetChild("sun"))
+    {
+        ReadVector3(sun, "direction", config.sunDirection_);
+        ReadFloat(sun, "constantBias", config.shadowConstantBias_);
+        ReadFloat(sun, "slopeBias", config.shadowSlopeBias_);
+        ReadVector4(sun, "cascadeSplits", config.cascadeSplits_);
+        ReadFloat(sun, "cascadeFadeStart", config.cascadeFadeStart_);
+    }
+    if (XMLElement ground = root.GetChild("ground"))
+        ReadFloat(ground, "size", config.groundSize_);
+    if (XMLElement field = root.GetChild("field"))
+    {
+        ReadFloat(field, "size", config.fieldSize_);
+        config.fieldSize_ = Max(config.fieldSize_, 1.0f);
+        float area = config.fieldSize_ * config.fieldSize_;
+        ReadCategory(field.GetChild("boxes"), area, config.boxes_);
+        ReadCategory(field.GetChild("mushrooms"), area, config.mushrooms_);
+    }
+    if (XMLElement fire = root.GetChild("fire"))
+    {
+        ReadVector3(fire, "position", config.firePosition_);
+        ReadVector3(fire, "scale", config.fireScale_);
+        ReadUInt(fire, "maxParticles", config.fireParticles_);
+    }
+    if (XMLElement camera = root.GetChild("camera"))
+        ReadFloat(camera, "farClip", config.farClip_);
+    if (XMLElement spotlight = root.GetChild("spotlight"))
+    {
+        ReadFloat(spotlight, "range", config.spotRange_);
+        ReadColor(spotlight, "color", config.spotColor_);
+        ReadFloat(spotlight, "brightness", config.spotBrightness_);
+        ReadFloat(spotlight, "fov", config.spotFov_);
+    }
+
+    *this = config;
+    return true;
+}
+
+unsigned WorldConfig::Compare(const WorldConfig& other) const {
+    unsigned changed = 0;
+    if (ambientColor_ != other.ambientColor_ || fogColor_ != other.fogColor_ || fogStart_ != other.fogStart_ ||
+        fogEnd_ != other.fogEnd_)
+        changed |= CONFIG_ZONE;
+    if (sunDirection_ != other.sunDirection_ || shadowConstantBias_ != other.shadowConstantBias_ ||
+        shadowSlopeBias_ != other.shadowSlopeBias_ || cascadeSplits_ != other.cascadeSplits_ ||
+        cascadeFadeStart_ != other.cascadeFadeStart_)
+        changed |= CONFIG_SUN;
+    if (groundSize_ != other.groundSize_)
+        changed |= CONFIG_GROUND;
+    if (fieldSize_ != other.fieldSize_)
+        changed |= CONFIG_FIELD;
+    if (!(boxes_ == other.boxes_))
+        changed |= CONFIG_BOXES;
+    if (!(mushrooms_ == other.mushrooms_))
+        changed |= CONFIG_MUSHROOMS;
+    if (firePosition_ != other.firePosition_ || fireScale_ != other.fireScale_ || fireParticles_ != other.fireParticles_)
+        changed |= CONFIG_FIRE;
+    if (farClip_ != other.farClip_)
+        changed |= CONFIG_CAMERA;
+    if (spotRange_ != other.spotRange_ || spotColor_ != other.spotColor_ || spotBrightness_ != other.spotBrightness_ ||
+        spotFov_ != other.spotFov_)
+        changed |= CONFIG_SPOTLIGHT;
+    return changed;
+}
+
+const char* WorldConfig::GetSectionName(unsigned section) {
+    for (unsigned i = 0; i < NUM_CONFIG_SECTIONS; ++i)
+    {
+        if (section == 1u << i)
+            return SECTION_NAMES[i];
+    }
+    return "";
+}
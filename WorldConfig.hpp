@@ -0,0 +1,97 @@
+#pragma once
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Math/Color.h>
+#include <Urho3D/Math/Vector3.h>
+#include <Urho3D/Math/Vector4.h>
+
+#include "PoissonScatter.hpp"
+
+using namespace Urho3D;
+
+/// Parts of a WorldConfig that can change independently, as bits.
+enum WorldConfigSection {
+    CONFIG_ZONE = 1 << 0,
+    CONFIG_SUN = 1 << 1,
+    CONFIG_GROUND = 1 << 2,
+    /// The field's size, which moves every box and mushroom.
+    CONFIG_FIELD = 1 << 3,
+    CONFIG_BOXES = 1 << 4,
+    CONFIG_MUSHROOMS = 1 << 5,
+    CONFIG_FIRE = 1 << 6,
+    CONFIG_CAMERA = 1 << 7,
+    CONFIG_SPOTLIGHT = 1 << 8,
+    NUM_CONFIG_SECTIONS = 9
+};
+
+/**
+* The tunable content of the world: fog, sun and shadows, the ground, the
+* scatter of the field, the fire, the camera's far clip and its spot light.
+* The defaults are the world World builds without a config file. A file
+* only needs the values it changes:
+*
+*   <world>
+*       <zone ambientColor="0.15 0.15 0.15" fogColor="0.5 0.5 0.7" fogStart="100" fogEnd="300" />
+*       <sun direction="0.6 -1 0.8" constantBias="0.00025" slopeBias="0.5" cascadeSplits="10 50 200 0" cascadeFadeStart="0.8" />
+*       <ground size="100" />
+*       <field size="90">
+*           <boxes radius="0.71" candidates="25.3125" minScale="1" maxScale="11" />
+*           <mushrooms radius="0.5" candidates="240" minScale="0.5" maxScale="2.5" />
+*       </field>
+*       <fire position="0 10 10" scale="5 6 6" maxParticles="100" />
+*       <camera farClip="300" />
+*       <spotlight range="20" color="0.6 1 0.6 1" brightness="2.8" fov="25" />
+*   </world>
+*
+* Categories are kept as densities. A file's candidates are the scatter's
+* candidate positions over the field size given in the same file, and are
+* turned into a density with it. A category that leaves candidates out keeps
+* its density, so a file that only makes the field larger gets
+* proportionally more boxes and mushrooms, not the same number spread out.
+* See ScatterCategory.
+*/
+struct WorldConfig {
+    WorldConfig();
+
+    /// Read a config file over the defaults. False, with the config unchanged, if it could not be read.
+    bool Load(Context* context, const String& fileName);
+
+    /// WorldConfigSection bits of the sections that differ from other.
+    unsigned Compare(const WorldConfig& other) const;
+
+    /// Lower case name of a single section bit, as used in the file.
+    static const char* GetSectionName(unsigned section);
+
+    Color ambientColor_;
+    Color fogColor_;
+    float fogStart_;
+    float fogEnd_;
+
+    Vector3 sunDirection_;
+    float shadowConstantBias_;
+    float shadowSlopeBias_;
+    /// Cascade split distances, unused cascades are zero.
+    Vector4 cascadeSplits_;
+    float cascadeFadeStart_;
+
+    /// Side of the square ground plane.
+    float groundSize_;
+
+    /// Side of the square the boxes and mushrooms are scattered over.
+    float fieldSize_;
+    /// Candidate densities per square unit, independent of fieldSize_.
+    ScatterCategory boxes_;
+    ScatterCategory mushrooms_;
+
+    Vector3 firePosition_;
+    Vector3 fireScale_;
+    unsigned fireParticles_;
+
+    float farClip_;
+
+    float spotRange_;
+    Color spotColor_;
+    float spotBrightness_;
+    float spotFov_;
+};